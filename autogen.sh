@@ -1,5 +1,6 @@
 #!/bin/sh -x
 
+libtoolize --copy
 aclocal
 autoheader
 automake --add-missing --copy
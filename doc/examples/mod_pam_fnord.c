@@ -52,13 +52,13 @@ write_config_fnord (  pam_module_t *this,
 
 
 
-DECLARE_BOOL_OPTS_1( is_enabled );
-DECLARE_STRING_OPTS_0;
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled");
+DECLARE_NO_STRING_OPTS;
+DECLARE_SCHEMA (TYPE_MASK (SESSION), NULL);
 
 pam_module_t mod_pam_fnord = { 
   "pam_fnord.so",	  /**< module name */ 
-  opt_sets,		  /**< list option_set_t's defined by DECLARE_OPT_SETS */
+  &schema,		  /**< options and types defined by DECLARE_SCHEMA */
   &parse_config_fnord,	  /**< parse function pointer */
   &def_print_module,	  /**< print function pointer */
   &write_config_fnord,	  /**< write function pointer */
@@ -0,0 +1,235 @@
+/* Copyright (C) 2020 Thorsten Kukuk
+   Author: Thorsten Kukuk <kukuk@thkukuk.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pam-config.h"
+
+/* Helpers for the binary files in cachedir. A cache file starts
+   with a magic of CACHE_MAGIC_LEN bytes, numbers are stored in
+   native byte order and strings as uint32 length including the
+   trailing NUL followed by the bytes. The files are only a speed
+   up, so failing to write one is never an error.  */
+
+static __thread char *tmp_cache_file;
+
+int
+map_cache_file (const char *name, const char *magic, cache_map_t *cm)
+{
+  struct stat st;
+  char *file;
+  int fd;
+
+  if (cachedir == NULL)
+    return FALSE;
+
+  if (asprintf (&file, "%s/%s", cachedir, name) < 0)
+    return FALSE;
+  fd = open (file, O_RDONLY | O_CLOEXEC);
+  free (file);
+  STATS_ADD (open, 1);
+  if (fd < 0)
+    return FALSE;
+
+  if (fstat (fd, &st) != 0 || st.st_size < CACHE_MAGIC_LEN)
+    {
+      close (fd);
+      return FALSE;
+    }
+
+  cm->len = st.st_size;
+  /* mapped, not necessarily read completely */
+  STATS_ADD (read_bytes, cm->len);
+  cm->map = mmap (NULL, cm->len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (cm->map == MAP_FAILED)
+    return FALSE;
+
+  if (memcmp (cm->map, magic, CACHE_MAGIC_LEN) != 0)
+    {
+      if (debug)
+	printf ("*** map_cache_file: %s/%s has wrong format\n",
+		cachedir, name);
+      munmap (cm->map, cm->len);
+      return FALSE;
+    }
+
+  cm->r.pos = (const char *) cm->map + CACHE_MAGIC_LEN;
+  cm->r.end = (const char *) cm->map + cm->len;
+
+  return TRUE;
+}
+
+void
+unmap_cache_file (cache_map_t *cm)
+{
+  munmap (cm->map, cm->len);
+}
+
+int
+read_cache_bytes (cache_reader_t *r, void *buf, size_t len)
+{
+  if ((size_t) (r->end - r->pos) < len)
+    return -1;
+  memcpy (buf, r->pos, len);
+  r->pos += len;
+  return 0;
+}
+
+int
+read_cache_u32 (cache_reader_t *r, uint32_t *val)
+{
+  return read_cache_bytes (r, val, sizeof (uint32_t));
+}
+
+int
+read_cache_string (cache_reader_t *r, const char **str)
+{
+  uint32_t len;
+
+  if (read_cache_u32 (r, &len) != 0 || len == 0 ||
+      (size_t) (r->end - r->pos) < len || r->pos[len - 1] != '\0')
+    return -1;
+  *str = r->pos;
+  r->pos += len;
+  return 0;
+}
+
+FILE *
+create_cache_file (const char *name, const char *magic)
+{
+  FILE *fp;
+  int fd;
+
+  if (cachedir == NULL)
+    return NULL;
+
+  if (mkdir (cachedir, 0755) != 0 && errno != EEXIST)
+    {
+      if (debug)
+	printf ("*** create_cache_file: cannot create %s: %m\n", cachedir);
+      return NULL;
+    }
+
+  if (asprintf (&tmp_cache_file, "%s/%s.XXXXXX", cachedir, name) < 0)
+    return NULL;
+
+  fd = mkstemp (tmp_cache_file);
+  STATS_ADD (write, 1);
+  if (fd < 0 || fchmod (fd, 0644) != 0 || (fp = fdopen (fd, "w")) == NULL)
+    {
+      if (debug)
+	printf ("*** create_cache_file: cannot create %s: %m\n",
+		tmp_cache_file);
+      if (fd >= 0)
+	{
+	  close (fd);
+	  unlink (tmp_cache_file);
+	}
+      free (tmp_cache_file);
+      return NULL;
+    }
+
+  if (write_cache_bytes (fp, magic, CACHE_MAGIC_LEN) != 0)
+    {
+      close_cache_file (fp, name, FALSE);
+      return NULL;
+    }
+
+  return fp;
+}
+
+void
+close_cache_file (FILE *fp, const char *name, int ok)
+{
+  char *file;
+
+  if (asprintf (&file, "%s/%s", cachedir, name) < 0)
+    file = NULL;
+
+  STATS_ADD (rename, 1);
+  if (fclose (fp) != 0 || !ok || file == NULL ||
+      rename (tmp_cache_file, file) != 0)
+    {
+      if (debug)
+	printf ("*** close_cache_file: cannot write %s/%s\n", cachedir, name);
+      unlink (tmp_cache_file);
+    }
+
+  free (file);
+  free (tmp_cache_file);
+}
+
+int
+write_cache_bytes (FILE *fp, const void *buf, size_t len)
+{
+  STATS_ADD (write_bytes, len);
+  return fwrite (buf, 1, len, fp) == len ? 0 : -1;
+}
+
+int
+write_cache_u32 (FILE *fp, uint32_t val)
+{
+  return write_cache_bytes (fp, &val, sizeof (uint32_t));
+}
+
+int
+write_cache_string (FILE *fp, const char *str)
+{
+  uint32_t len = strlen (str) + 1;
+
+  if (write_cache_u32 (fp, len) != 0)
+    return -1;
+  return write_cache_bytes (fp, str, len);
+}
+
+void
+cache_stat_key (const struct stat *st, uint64_t key[CACHE_STAT_KEY_LEN])
+{
+  key[0] = st->st_dev;
+  key[1] = st->st_ino;
+  key[2] = st->st_size;
+  key[3] = st->st_mtim.tv_sec;
+  key[4] = st->st_mtim.tv_nsec;
+  key[5] = st->st_ctim.tv_sec;
+  key[6] = st->st_ctim.tv_nsec;
+}
+
+/* FNV-1a, good enough to notice changed content.  */
+uint64_t
+cache_hash_bytes (uint64_t hash, const void *buf, size_t len)
+{
+  const unsigned char *cp = buf;
+
+  while (len--)
+    {
+      hash ^= *cp++;
+      hash *= 1099511628211ULL;
+    }
+
+  return hash;
+}
@@ -0,0 +1,792 @@
+/* Copyright (C) 2020 Thorsten Kukuk
+   Author: Thorsten Kukuk <kukuk@thkukuk.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "pam-config.h"
+#include "pamconfig.h"
+
+#include "supported-modules.h"
+
+/* The settings of the active context. The pam-config command sets
+   them once from the command line, libpamconfig sets them from a
+   pamconfig_ctx_t for the duration of every call.
+
+   The option values of the modules are not part of the modules,
+   every context owns an option state with the values of all modules
+   and makes it the active one while it writes or loads config files.
+   The settings, the active state, the plan and the module index are
+   per thread, so calls on different contexts run in parallel. Only
+   the module registry and the sanity check rules are shared, both
+   are built once.  */
+
+__thread int debug = 0;
+__thread char *confdir = NULL;
+__thread char *cachedir = NULL;
+__thread char *gl_service = NULL;
+
+struct pamconfig_ctx {
+  char *confdir;
+  char *cachedir;
+  char *service;          /* NULL for the common config */
+  const vfs_t *vfs;
+  int debug;
+  option_state_t *state;
+};
+
+static pam_module_t **const all_module_lists[] = {
+  common_module_list, service_module_list, module_list_account,
+  module_list_auth, module_list_password, module_list_session, NULL
+};
+
+/* The option sets of a state, SESSION + 1 for every schema in the
+   order of the slots, and the values they point into.  */
+struct option_state {
+  option_set_t *sets;
+  int *bool_values;
+  char **string_values;
+  size_t nbool, nstring;
+};
+
+#define NTYPES (SESSION + 1)
+
+/* Every schema of the modules above gets its slot once, a schema
+   shared by two modules (pam_selinux.so) has one slot. The schemas
+   are constant, the slots and the indexes of the option names are
+   kept here, found by the address of the schema.  */
+struct schema_entry {
+  const option_schema_t *schema;  /* NULL for a free entry */
+  size_t slot;
+};
+
+static const option_schema_t **schemas;
+static const opt_index_t **opt_indexes;
+static struct schema_entry *schema_table;
+static size_t nschemas, schema_mask, nbool_values, nstring_values;
+static pthread_once_t schemas_once = PTHREAD_ONCE_INIT;
+
+static __thread option_state_t *default_state;
+static __thread option_state_t *active_state;
+
+/* 1 + position of schema in schemas, 0 if it is not registered.  */
+static size_t
+schema_slot (const option_schema_t *schema)
+{
+  size_t i;
+
+  for (i = ((uintptr_t) schema >> 4) & schema_mask;
+       schema_table[i].schema != NULL; i = (i + 1) & schema_mask)
+    if (schema_table[i].schema == schema)
+      return schema_table[i].slot;
+
+  return 0;
+}
+
+static void
+register_schemas (void)
+{
+  pam_module_t **const *list;
+  size_t nmodules = 0, size = 8;
+
+  for (list = all_module_lists; *list != NULL; list++)
+    {
+      pam_module_t **modptr;
+
+      for (modptr = *list; *modptr != NULL; modptr++)
+	nmodules++;
+    }
+  while (size < 2 * nmodules)
+    size *= 2;
+
+  schemas = calloc (nmodules, sizeof (option_schema_t *));
+  opt_indexes = calloc (nmodules, sizeof (opt_index_t *));
+  schema_table = calloc (size, sizeof (struct schema_entry));
+  if (schemas == NULL || opt_indexes == NULL || schema_table == NULL)
+    {
+      free (schemas);
+      free (opt_indexes);
+      free (schema_table);
+      schemas = NULL;
+      return;
+    }
+  schema_mask = size - 1;
+
+  for (list = all_module_lists; *list != NULL; list++)
+    {
+      pam_module_t **modptr;
+
+      for (modptr = *list; *modptr != NULL; modptr++)
+	{
+	  const option_schema_t *schema = (*modptr)->schema;
+	  size_t i;
+
+	  if (schema_slot (schema) != 0)
+	    continue;
+	  for (i = ((uintptr_t) schema >> 4) & schema_mask;
+	       schema_table[i].schema != NULL; i = (i + 1) & schema_mask)
+	    ;
+	  schema_table[i].schema = schema;
+	  schema_table[i].slot = nschemas + 1;
+	  /* without index the option set scans the names */
+	  opt_indexes[nschemas] = new_opt_index (schema->bool_keys,
+						 schema->string_keys);
+	  schemas[nschemas++] = schema;
+	  nbool_values += NTYPES * count_opts (schema->bool_keys);
+	  nstring_values += NTYPES * count_opts (schema->string_keys);
+	}
+    }
+}
+
+/* Point the option sets of state into its value arrays.  */
+static void
+init_opt_sets (option_state_t *state)
+{
+  int *bool_values = state->bool_values;
+  char **string_values = state->string_values;
+  size_t i;
+
+  for (i = 0; i < nschemas; i++)
+    {
+      size_t nbool = count_opts (schemas[i]->bool_keys);
+      size_t nstring = count_opts (schemas[i]->string_keys);
+      write_type_t type;
+
+      for (type = AUTH; type <= SESSION; type++)
+	{
+	  option_set_t *opt_set = &state->sets[i * NTYPES + type];
+
+	  opt_set->bool_keys = schemas[i]->bool_keys;
+	  opt_set->string_keys = schemas[i]->string_keys;
+	  opt_set->index = opt_indexes[i];
+	  opt_set->bool_values = bool_values;
+	  opt_set->string_values = string_values;
+	  opt_set->is_enabled = &is_enabled;
+	  opt_set->enable = &enable;
+	  opt_set->get_opt = &get_opt;
+	  opt_set->set_opt = &set_opt;
+	  bool_values += nbool;
+	  string_values += nstring;
+	}
+    }
+}
+
+option_state_t *
+new_option_state (void)
+{
+  option_state_t *state;
+
+  pthread_once (&schemas_once, &register_schemas);
+  if (schemas == NULL || (state = calloc (1, sizeof (option_state_t))) == NULL)
+    return NULL;
+
+  state->nbool = nbool_values;
+  state->nstring = nstring_values;
+  state->sets = calloc (nschemas * NTYPES, sizeof (option_set_t));
+  state->bool_values = calloc (state->nbool + 1, sizeof (int));
+  state->string_values = calloc (state->nstring + 1, sizeof (char *));
+  if (state->sets == NULL || state->bool_values == NULL ||
+      state->string_values == NULL)
+    {
+      free_option_state (state);
+      return NULL;
+    }
+  init_opt_sets (state);
+
+  return state;
+}
+
+option_state_t *
+copy_option_state (const option_state_t *state)
+{
+  option_state_t *copy = new_option_state ();
+  size_t i;
+
+  if (copy == NULL)
+    return NULL;
+
+  memcpy (copy->bool_values, state->bool_values,
+	  state->nbool * sizeof (int));
+  for (i = 0; i < state->nstring; i++)
+    if (state->string_values[i] &&
+	(copy->string_values[i] = strdup (state->string_values[i])) == NULL)
+      {
+	free_option_state (copy);
+	return NULL;
+      }
+
+  return copy;
+}
+
+void
+clear_option_state (option_state_t *state)
+{
+  size_t i;
+
+  for (i = 0; i < state->nstring; i++)
+    {
+      free (state->string_values[i]);
+      state->string_values[i] = NULL;
+    }
+  memset (state->bool_values, 0, state->nbool * sizeof (int));
+}
+
+void
+free_option_state (option_state_t *state)
+{
+  if (state == NULL)
+    return;
+
+  if (state->string_values)
+    clear_option_state (state);
+  free (state->string_values);
+  free (state->bool_values);
+  free (state->sets);
+  free (state);
+}
+
+option_state_t *
+use_option_state (option_state_t *state)
+{
+  option_state_t *prev = active_state;
+
+  active_state = state;
+  return prev;
+}
+
+/* The option set of schema in state, NULL if the schema is not
+   registered.  */
+static option_set_t *
+slot_opt_set (option_state_t *state, const option_schema_t *schema,
+	      write_type_t type)
+{
+  size_t slot = schema_slot (schema);
+
+  return slot ? &state->sets[(slot - 1) * NTYPES + type] : NULL;
+}
+
+/* Only the pam-config command and the test programs get here
+   without state, the calls of libpamconfig always have the state of
+   their context active and use slot_opt_set() for the modules the
+   caller names, so they never exit or abort here.  */
+option_set_t *
+state_opt_set (option_state_t *state, const option_schema_t *schema,
+	       write_type_t type)
+{
+  option_set_t *opt_set;
+
+  if (state == NULL)
+    state = active_state;
+  if (state == NULL)
+    {
+      if (default_state == NULL &&
+	  (default_state = new_option_state ()) == NULL)
+	{
+	  fprintf (stderr, _("Out of memory\n"));
+	  exit (1);
+	}
+      state = default_state;
+    }
+
+  /* XXX for debugging */
+  if ((opt_set = slot_opt_set (state, schema, type)) == NULL)
+    {
+      fprintf (stderr, "ERROR: get_opt_set: module not registered!\n");
+      abort ();
+    }
+
+  return opt_set;
+}
+
+/* Make ctx and its option state, or a copy of it, the active ones.  */
+static void
+ctx_enter (const pamconfig_ctx_t *ctx, option_state_t *state)
+{
+  debug = ctx->debug;
+  confdir = ctx->confdir;
+  cachedir = ctx->cachedir;
+  gl_service = ctx->service;
+  vfs = ctx->vfs;
+  plan_mode = FALSE;
+  use_option_state (state);
+}
+
+static void
+ctx_leave (void)
+{
+  use_option_state (NULL);
+  plan_discard ();
+  /* the index belongs to the confdir of this context */
+  free_module_index ();
+
+  debug = 0;
+  confdir = NULL;
+  cachedir = NULL;
+  gl_service = NULL;
+  vfs = &vfs_posix;
+  plan_mode = FALSE;
+}
+
+pamconfig_ctx_t *
+pamconfig_new (const char *dir)
+{
+  pamconfig_ctx_t *ctx;
+
+  if (dir && dir[0] != '/')
+    return NULL;
+
+  if ((ctx = calloc (1, sizeof (pamconfig_ctx_t))) == NULL)
+    return NULL;
+
+  ctx->vfs = &vfs_posix;
+  ctx->state = new_option_state ();
+  ctx->confdir = strdup (dir ? dir : CONFDIR);
+  /* Like pam-config --confdir, a custom confdir has no cache.  */
+  if (dir == NULL)
+    ctx->cachedir = strdup (CACHEDIR);
+  if (ctx->state == NULL || ctx->confdir == NULL ||
+      (dir == NULL && ctx->cachedir == NULL))
+    {
+      pamconfig_free (ctx);
+      return NULL;
+    }
+
+  return ctx;
+}
+
+void
+pamconfig_free (pamconfig_ctx_t *ctx)
+{
+  if (ctx == NULL)
+    return;
+
+  free_option_state (ctx->state);
+  free (ctx->confdir);
+  free (ctx->cachedir);
+  free (ctx->service);
+  free (ctx);
+}
+
+int
+pamconfig_set_cachedir (pamconfig_ctx_t *ctx, const char *dir)
+{
+  char *copy = NULL;
+
+  if (dir && (dir[0] != '/' || (copy = strdup (dir)) == NULL))
+    return -1;
+
+  free (ctx->cachedir);
+  ctx->cachedir = copy;
+
+  return 0;
+}
+
+int
+pamconfig_use_memfs (pamconfig_ctx_t *ctx)
+{
+  /* the caches only know the real files */
+  ctx->vfs = &vfs_memory;
+  return pamconfig_set_cachedir (ctx, NULL);
+}
+
+void
+pamconfig_set_debug (pamconfig_ctx_t *ctx, int value)
+{
+  ctx->debug = value;
+}
+
+int
+pamconfig_load (pamconfig_ctx_t *ctx, const char *service)
+{
+  char *copy = NULL;
+  int retval;
+
+  if (service && (copy = strdup (service)) == NULL)
+    return -1;
+
+  free (ctx->service);
+  ctx->service = copy;
+  clear_option_state (ctx->state);
+
+  ctx_enter (ctx, ctx->state);
+  retval = load_all_types (confdir, service,
+			   service ? service_module_list : common_module_list);
+  if (retval != 0)
+    {
+      if (service)
+	fprintf (stderr,
+		 _("\nCouldn't load config file '%s/pam.d/%s', aborted!\n"),
+		 confdir, service);
+      else
+	fprintf (stderr, _("\nCouldn't load config file, aborted!\n"));
+      clear_option_state (ctx->state);
+    }
+  ctx_leave ();
+
+  return retval ? -1 : 0;
+}
+
+/* NULL if the module does not exist or never writes type.  */
+static option_set_t *
+find_opt_set (const pamconfig_ctx_t *ctx, const char *module,
+	      const char *type)
+{
+  pam_module_t **modptr = ctx->service ? service_module_list :
+    common_module_list;
+  write_type_t wt;
+
+  for (wt = AUTH; wt <= SESSION; wt++)
+    if (strcmp (type, type2string (wt)) == 0)
+      break;
+  if (wt > SESSION)
+    return NULL;
+
+  for (; *modptr != NULL; modptr++)
+    if (strcmp ((*modptr)->name, module) == 0)
+      return ((*modptr)->schema->types & TYPE_MASK (wt)) ?
+	slot_opt_set (ctx->state, (*modptr)->schema, wt) : NULL;
+
+  return NULL;
+}
+
+int
+pamconfig_is_enabled (pamconfig_ctx_t *ctx, const char *module,
+		      const char *type, const char *option)
+{
+  option_set_t *opt_set;
+  int *opt;
+  int retval = -1;
+
+  if ((opt_set = find_opt_set (ctx, module, type)) != NULL &&
+      (opt = bool_opt (opt_set, option ? option : "is_enabled")))
+    retval = *opt ? 1 : 0;
+
+  return retval;
+}
+
+char *
+pamconfig_get_string (pamconfig_ctx_t *ctx, const char *module,
+		      const char *type, const char *option)
+{
+  option_set_t *opt_set;
+  char **opt;
+  char *value = NULL;
+
+  if ((opt_set = find_opt_set (ctx, module, type)) != NULL &&
+      option != NULL && (opt = string_opt (opt_set, option)) != NULL &&
+      *opt)
+    value = strdup (*opt);
+
+  return value;
+}
+
+int
+pamconfig_enable (pamconfig_ctx_t *ctx, const char *module,
+		  const char *type, const char *option, int value)
+{
+  option_set_t *opt_set;
+  int *opt = NULL;
+
+  if ((opt_set = find_opt_set (ctx, module, type)) != NULL &&
+      (opt = bool_opt (opt_set, option ? option : "is_enabled")))
+    *opt = value ? TRUE : FALSE;
+
+  return opt ? 0 : -1;
+}
+
+int
+pamconfig_set_string (pamconfig_ctx_t *ctx, const char *module,
+		      const char *type, const char *option,
+		      const char *value)
+{
+  option_set_t *opt_set;
+  char **opt = NULL;
+  char *copy = NULL;
+
+  if (value && (copy = strdup (value)) == NULL)
+    return -1;
+
+  if ((opt_set = find_opt_set (ctx, module, type)) != NULL &&
+      option != NULL && (opt = string_opt (opt_set, option)) != NULL)
+    {
+      free (*opt);
+      *opt = copy;
+      return 0;
+    }
+  free (copy);
+
+  return -1;
+}
+
+/* The sanity checks fix the options they complain about, calls
+   which must not keep these changes work on a copy of the state.  */
+static option_state_t *
+scratch_state (const pamconfig_ctx_t *ctx)
+{
+  option_state_t *state = copy_option_state (ctx->state);
+
+  if (state == NULL)
+    fprintf (stderr, _("Out of memory\n"));
+
+  return state;
+}
+
+int
+pamconfig_verify (pamconfig_ctx_t *ctx)
+{
+  option_state_t *state;
+  pam_module_t **modptr;
+  int retval = 0;
+
+  if ((state = scratch_state (ctx)) == NULL)
+    return 1;
+  ctx_enter (ctx, state);
+
+  if (ctx->service == NULL)
+    {
+      if (sanitize_check_account (common_module_list, 1) != 0)
+	retval = 1;
+      if (sanitize_check_auth (common_module_list, 1) != 0)
+	retval = 1;
+      if (sanitize_check_password (common_module_list, 1) != 0)
+	retval = 1;
+      if (sanitize_check_session (common_module_list, 1) != 0)
+	retval = 1;
+    }
+
+  for (modptr = ctx->service ? service_module_list : common_module_list;
+       *modptr != NULL; modptr++)
+    {
+      write_type_t type;
+
+      for (type = AUTH; type <= SESSION; type++)
+	{
+	  option_set_t *opt_set = (*modptr)->get_opt_set (*modptr, type);
+
+	  if (opt_set->is_enabled (opt_set, "is_enabled"))
+	    {
+	      if (check_for_pam_module ((*modptr)->name, 0) != 0)
+		retval = 1;
+	      break;
+	    }
+	}
+    }
+
+  ctx_leave ();
+  free_option_state (state);
+
+  return retval;
+}
+
+/* Write the state of the active context into the plan.  */
+static int
+plan_state (void)
+{
+  int retval = 0;
+
+  plan_mode = TRUE;
+
+  if (gl_service == NULL)
+    {
+      if (sanitize_check_account (common_module_list, 0) != 0 ||
+	  sanitize_check_auth (common_module_list, 0) != 0 ||
+	  sanitize_check_password (common_module_list, 0) != 0 ||
+	  sanitize_check_session (common_module_list, 0) != 0 ||
+	  write_common_config () != 0)
+	retval = 1;
+    }
+  else if (write_service_config () != 0)
+    retval = 1;
+
+  return retval;
+}
+
+static int
+check_common_symlinks (void)
+{
+  int retval = 0;
+
+  retval |= check_symlink (confdir, CONF_ACCOUNT_PC, CONF_ACCOUNT);
+  retval |= check_symlink (confdir, CONF_AUTH_PC, CONF_AUTH);
+  retval |= check_symlink (confdir, CONF_PASSWORD_PC, CONF_PASSWORD);
+  retval |= check_symlink (confdir, CONF_SESSION_PC, CONF_SESSION);
+
+  return retval;
+}
+
+int
+pamconfig_plan (pamconfig_ctx_t *ctx)
+{
+  option_state_t *state;
+  int retval;
+
+  if ((state = scratch_state (ctx)) == NULL)
+    return 1;
+  ctx_enter (ctx, state);
+
+  retval = plan_state ();
+  if (retval == 0 && gl_service == NULL)
+    retval = check_common_symlinks ();
+  if (retval == 0)
+    retval = print_plan ();
+  fflush (stdout);
+
+  ctx_leave ();
+  free_option_state (state);
+
+  return retval;
+}
+
+int
+pamconfig_commit (pamconfig_ctx_t *ctx)
+{
+  option_state_t *state;
+  int retval;
+
+  if ((state = scratch_state (ctx)) == NULL)
+    return 1;
+  ctx_enter (ctx, state);
+
+  retval = plan_state ();
+  plan_mode = FALSE;
+  if (retval == 0)
+    retval = plan_commit ();
+  if (retval == 0 && gl_service == NULL)
+    retval = check_common_symlinks ();
+
+  ctx_leave ();
+
+  /* keep what the sanity checks added, it was written */
+  if (retval == 0)
+    {
+      free_option_state (ctx->state);
+      ctx->state = state;
+    }
+  else
+    free_option_state (state);
+
+  return retval;
+}
+
+int
+check_symlink (const char *sysconfdir, const char *file_pc, const char *file)
+{
+  char *config;
+
+  if (asprintf (&config, "%s/pam.d/%s", sysconfdir, file) < 0)
+    {
+      fprintf (stderr, _("Out of memory\n"));
+      return 1;
+    }
+
+  if (vfs->access (config, F_OK) == -1)
+    {
+	if (plan_mode)
+	  plan_action ("symlink\t%s\t%s", file, file_pc);
+	else if (vfs->symlink (file_pc, config) != 0)
+	{
+	  fprintf (stderr,
+		   _("Error activating %s (%m)\n"), config);
+	      fprintf (stderr,
+		       _("New config from %s/pam.d/%s is not in use!\n"),
+		       sysconfdir, file_pc);
+	      return 1;
+	}
+	return 0;
+    }
+  else
+    {
+      char buf[1024];
+
+      memset (&buf, 0, sizeof (buf));
+      if (vfs->readlink (config, buf, sizeof (buf)) <= 0 ||
+          strcmp (file_pc, basename(buf)) != 0)
+	{
+	  fprintf (stderr,
+		   _("File %s is no symlink to %s.\n"), config, file_pc);
+	  fprintf (stderr,
+		   _("New config from %s is not in use!\n"),
+		   file_pc);
+	  return 1;
+	}
+      return 0;
+    }
+}
+
+/* Write the common-*-pc files.  */
+int
+write_common_config (void)
+{
+  int phase = STATS_PHASE (STATS_RENDER);
+  int retval =
+    write_config (confdir, CONF_ACCOUNT_PC, ACCOUNT, module_list_account) != 0 ||
+    write_config (confdir, CONF_AUTH_PC, AUTH, module_list_auth) != 0 ||
+    write_config (confdir, CONF_PASSWORD_PC, PASSWORD, module_list_password) != 0 ||
+    write_config (confdir, CONF_SESSION_PC, SESSION, module_list_session) != 0;
+
+  STATS_PHASE (phase);
+  return retval;
+}
+
+/* Let every service module write its lines into gl_service.  */
+int
+write_service_config (void)
+{
+  pam_module_t **modptr = service_module_list;
+  char *conffile;
+  int retval = 0;
+  int phase;
+
+  if (debug)
+    printf ("*** write_config (%s/pam.d/%s)\n", confdir, gl_service);
+
+  /* Check if service file exists */
+  if (asprintf (&conffile, "%s/pam.d/%s", confdir, gl_service) < 0)
+    return 1;
+
+  if (!(plan_mode && plan_has_file (gl_service)) &&
+      vfs->access (conffile, R_OK) != 0)
+    {
+      fprintf (stderr, _("Cannot access '%s': %m\n"), conffile);
+      free (conffile);
+      return 1;
+    }
+  free (conffile);
+
+  phase = STATS_PHASE (STATS_RENDER);
+  while (*modptr != NULL)
+    {
+      struct timespec start;
+
+      STATS_MODULE_BEGIN (start);
+      TRACE_BEGIN (start);
+      retval |= (*modptr)->write_config (*modptr, -1, NULL);
+      TRACE_END (start, "write_config", (*modptr)->name, -1, gl_service);
+      STATS_MODULE_END ((*modptr)->name, start);
+      ++modptr;
+    }
+  STATS_PHASE (phase);
+
+  return retval;
+}
@@ -0,0 +1,436 @@
+/* Copyright (C) 2020 Thorsten Kukuk
+   Author: Thorsten Kukuk <kukuk@thkukuk.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pam-config.h"
+
+/* Resolve "include", "substack" and "@include" directives of the
+   files in pam.d into the stack of modules PAM really runs for a
+   service. Every file is parsed only once, the expanded stack of
+   every file and type is memoized, so resolving the whole tree
+   costs one parse per file and not one per include edge.  */
+
+#define NUM_TYPES (SESSION + 1)
+
+enum line_kind {
+  LINE_MODULE,
+  LINE_INCLUDE,
+  LINE_SUBSTACK,
+  LINE_INCLUDE_ALL   /* "@include": all types of the file */
+};
+
+enum expand_state {
+  STATE_NEW = 0,
+  STATE_EXPANDING,
+  STATE_DONE
+};
+
+struct stack_line {
+  int type;           /* write_type_t or -1 for "@include" */
+  enum line_kind kind;
+  unsigned int lineno;
+  int reported;       /* problem with this include already printed */
+  char *control;
+  char *module;
+  char *arguments;
+};
+
+struct stack_file {
+  char *name;
+  int found;
+  struct stack_line *lines;
+  size_t nlines;
+  enum expand_state state[NUM_TYPES];
+  int incomplete[NUM_TYPES];
+  struct stack_entry *expanded[NUM_TYPES];
+  struct stack_file *next;
+};
+
+struct stack_entry {
+  const struct stack_file *file;
+  const struct stack_line *line;
+  int in_substack;
+  struct stack_entry *next;
+};
+
+static struct stack_file *stack_files;
+
+static int
+string2type (const char *type)
+{
+  write_type_t wt;
+
+  /* "-session ..." means: ignore if the module is missing.  */
+  if (type[0] == '-')
+    type++;
+
+  for (wt = AUTH; wt <= SESSION; wt++)
+    if (strcasecmp (type, type2string (wt)) == 0)
+      return wt;
+
+  return -1;
+}
+
+static int
+add_stack_line (struct stack_file *sf, int type, enum line_kind kind,
+		unsigned int lineno, const char *control,
+		const char *module, const char *arguments)
+{
+  struct stack_line *lines, *sl;
+
+  lines = realloc (sf->lines, (sf->nlines + 1) * sizeof (struct stack_line));
+  if (lines == NULL)
+    return -1;
+  sf->lines = lines;
+
+  sl = &sf->lines[sf->nlines];
+  sl->type = type;
+  sl->kind = kind;
+  sl->lineno = lineno;
+  sl->reported = FALSE;
+  sl->control = control ? strdup (control) : NULL;
+  sl->module = strdup (module);
+  sl->arguments = arguments ? strdup (arguments) : NULL;
+  if ((control && sl->control == NULL) || sl->module == NULL ||
+      (arguments && sl->arguments == NULL))
+    return -1;
+  sf->nlines++;
+
+  return 0;
+}
+
+static int
+parse_stack_file (struct stack_file *sf)
+{
+  char *path, *buf = NULL;
+  size_t buflen = 0;
+  unsigned int lineno = 0;
+  FILE *fp;
+  int retval = 0;
+
+  path = find_config_file (confdir, sf->name);
+  if (path == NULL)
+    return errno == ENOMEM ? -1 : 0;
+
+  if (debug)
+    printf ("*** parse_stack_file (%s)\n", path);
+
+  fp = vfs->open_read (path);
+  free (path);
+  if (fp == NULL)
+    return 0;
+  sf->found = TRUE;
+
+  while (retval == 0)
+    {
+      char *type, *control, *module, *arguments;
+      ssize_t n = getline (&buf, &buflen, fp);
+      int wt;
+
+      if (n < 1)
+	break;
+      lineno++;
+
+      switch (split_config_line (buf, &type, &control, &module, &arguments))
+	{
+	case 0:
+	  continue;
+	case -1:
+	  fprintf (stderr, _("%s:%u: broken line, ignored\n"),
+		   sf->name, lineno);
+	  continue;
+	}
+
+      if (type[0] == '@')
+	{
+	  if (strcasecmp (type, "@include") == 0)
+	    retval = add_stack_line (sf, -1, LINE_INCLUDE_ALL, lineno,
+				     NULL, module, NULL);
+	  continue;
+	}
+
+      if ((wt = string2type (type)) < 0)
+	continue;
+
+      if (strcasecmp (control, "include") == 0)
+	retval = add_stack_line (sf, wt, LINE_INCLUDE, lineno,
+				 NULL, module, NULL);
+      else if (strcasecmp (control, "substack") == 0)
+	retval = add_stack_line (sf, wt, LINE_SUBSTACK, lineno,
+				 NULL, module, NULL);
+      else
+	retval = add_stack_line (sf, wt, LINE_MODULE, lineno,
+				 control, module, arguments);
+    }
+
+  fclose (fp);
+  free (buf);
+
+  return retval;
+}
+
+/* Returns the parsed file, every file is only read once.  */
+static struct stack_file *
+get_stack_file (const char *name)
+{
+  struct stack_file *sf;
+
+  for (sf = stack_files; sf != NULL; sf = sf->next)
+    if (strcmp (sf->name, name) == 0)
+      return sf;
+
+  sf = calloc (1, sizeof (struct stack_file));
+  if (sf == NULL || (sf->name = strdup (name)) == NULL)
+    {
+      free (sf);
+      fprintf (stderr, _("Out of memory\n"));
+      return NULL;
+    }
+  sf->next = stack_files;
+  stack_files = sf;
+
+  if (parse_stack_file (sf) != 0)
+    {
+      fprintf (stderr, _("Out of memory\n"));
+      return NULL;
+    }
+
+  return sf;
+}
+
+static struct stack_entry **
+append_entry (struct stack_entry **tail, const struct stack_file *file,
+	      const struct stack_line *line, int in_substack)
+{
+  struct stack_entry *entry = malloc (sizeof (struct stack_entry));
+
+  if (entry == NULL)
+    return NULL;
+
+  entry->file = file;
+  entry->line = line;
+  entry->in_substack = in_substack;
+  entry->next = NULL;
+  *tail = entry;
+
+  return &entry->next;
+}
+
+/* Expand the stack of type wt for file sf. The result is memoized
+   in sf->expanded[wt]. Returns 0 on success, 1 if the stack is
+   incomplete (missing file or loop) and -1 if out of memory.  */
+static int
+expand_stack (struct stack_file *sf, write_type_t wt)
+{
+  struct stack_entry **tail = &sf->expanded[wt];
+  int retval = 0;
+  size_t i;
+
+  if (sf->state[wt] == STATE_DONE)
+    return sf->incomplete[wt];
+  sf->state[wt] = STATE_EXPANDING;
+
+  for (i = 0; i < sf->nlines; i++)
+    {
+      struct stack_line *sl = &sf->lines[i];
+      const struct stack_entry *entry;
+      struct stack_file *included;
+      int r;
+
+      if (sl->type != (int)wt && sl->kind != LINE_INCLUDE_ALL)
+	continue;
+
+      if (sl->kind == LINE_MODULE)
+	{
+	  if ((tail = append_entry (tail, sf, sl, FALSE)) == NULL)
+	    return -1;
+	  continue;
+	}
+
+      if ((included = get_stack_file (sl->module)) == NULL)
+	return -1;
+
+      if (!included->found)
+	{
+	  if (!sl->reported)
+	    fprintf (stderr, _("WARNING: %s:%u: included file '%s' not found.\n"),
+		     sf->name, sl->lineno, sl->module);
+	  sl->reported = TRUE;
+	  retval = 1;
+	  continue;
+	}
+
+      if (included->state[wt] == STATE_EXPANDING)
+	{
+	  if (!sl->reported)
+	    fprintf (stderr, _("ERROR: %s:%u: include loop with '%s'.\n"),
+		     sf->name, sl->lineno, sl->module);
+	  sl->reported = TRUE;
+	  retval = 1;
+	  continue;
+	}
+
+      r = expand_stack (included, wt);
+      if (r < 0)
+	return r;
+      retval |= r;
+
+      for (entry = included->expanded[wt]; entry != NULL; entry = entry->next)
+	if ((tail = append_entry (tail, entry->file, entry->line,
+				  entry->in_substack ||
+				  sl->kind == LINE_SUBSTACK)) == NULL)
+	  return -1;
+    }
+
+  sf->state[wt] = STATE_DONE;
+  sf->incomplete[wt] = retval;
+  return retval;
+}
+
+static int
+print_service_stack (const char *service, int with_prefix)
+{
+  struct stack_file *sf = get_stack_file (service);
+  write_type_t wt;
+  int retval = 0;
+
+  if (sf == NULL)
+    return 1;
+
+  if (!sf->found)
+    {
+      fprintf (stderr, _("Cannot access '%s/pam.d/%s': %s\n"),
+	       confdir, service, strerror (ENOENT));
+      return 1;
+    }
+
+  for (wt = AUTH; wt <= SESSION; wt++)
+    {
+      const struct stack_entry *entry;
+      int r = expand_stack (sf, wt);
+
+      if (r < 0)
+	return 1;
+      retval |= r;
+
+      for (entry = sf->expanded[wt]; entry != NULL; entry = entry->next)
+	{
+	  const struct stack_line *sl = entry->line;
+
+	  if (with_prefix)
+	    printf ("%s: ", service);
+	  printf ("%s\t%s\t%s\t%s%s# %s:%u%s\n", type2string (wt),
+		  sl->control, sl->module,
+		  sl->arguments ? sl->arguments : "",
+		  sl->arguments ? " " : "",
+		  entry->file->name, sl->lineno,
+		  entry->in_substack ? " (substack)" : "");
+	}
+    }
+
+  return retval;
+}
+
+static int
+add_service_names (const char *dir, char ***names, size_t *count)
+{
+  struct dirent **namelist;
+  char *dname;
+  int n, i, retval = 0;
+
+  if (asprintf (&dname, "%s/pam.d", dir) < 0)
+    return -1;
+
+  n = vfs->scandir (dname, &namelist, &service_filter);
+  free (dname);
+  if (n < 0)
+    return 0;
+
+  for (i = 0; i < n; i++)
+    {
+      size_t j;
+
+      for (j = 0; j < *count; j++)
+	if (strcmp ((*names)[j], namelist[i]->d_name) == 0)
+	  break;
+
+      if (retval == 0 && j == *count)
+	{
+	  char **tmp = realloc (*names, (*count + 1) * sizeof (char *));
+
+	  if (tmp == NULL ||
+	      (tmp[*count] = strdup (namelist[i]->d_name)) == NULL)
+	    retval = -1;
+	  else
+	    (*count)++;
+	  if (tmp)
+	    *names = tmp;
+	}
+      free (namelist[i]);
+    }
+  free (namelist);
+
+  return retval;
+}
+
+static int
+compare_names (const void *a, const void *b)
+{
+  return strcmp (*(char * const *)a, *(char * const *)b);
+}
+
+int
+print_effective_stack (const char *service)
+{
+  const char *dirs[] = {confdir, CONF_FALLBACK_DIR1, CONF_FALLBACK_DIR2};
+  char **names = NULL;
+  size_t count = 0, i;
+  int retval = 0;
+
+  if (service)
+    return print_service_stack (service, FALSE);
+
+  /* Whole tree: every service in confdir and the vendor directories.  */
+  for (i = 0; i < sizeof (dirs)/sizeof (dirs[0]); i++)
+    if (add_service_names (dirs[i], &names, &count) != 0)
+      {
+	fprintf (stderr, _("Out of memory\n"));
+	retval = 1;
+	break;
+      }
+
+  if (retval == 0)
+    {
+      qsort (names, count, sizeof (char *), compare_names);
+      for (i = 0; i < count; i++)
+	retval |= print_service_stack (names[i], TRUE);
+    }
+
+  for (i = 0; i < count; i++)
+    free (names[i]);
+  free (names);
+
+  return retval;
+}
@@ -0,0 +1,834 @@
+/* Copyright (C) 2020 Thorsten Kukuk
+   Author: Thorsten Kukuk <kukuk@thkukuk.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <dirent.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "pam-config.h"
+
+/* Check every file in pam.d with the rules in lint_rules[]. The
+   findings of a file are cached in cachedir/lint together with a
+   hash of its content, so only changed files are checked again.
+   The rules look at nothing but the file itself and the existence
+   of included files and modules, so the cache is only valid as
+   long as the list of files in the pam.d directories and the
+   module directory did not change. This is covered by tree_key.
+
+   Cache format (see cache_file.c):
+     magic, uint64 tree key
+     per file, sorted like alphasort:
+       string name, uint64 content hash, uint32 number of findings,
+       per finding: uint32 lineno, uint32 severity, string rule,
+       string message.  */
+
+#define LINT_CACHE_FILE "lint"
+#define LINT_CACHE_MAGIC "PCLINT01"
+
+
+enum lint_severity {
+  LINT_WARNING,
+  LINT_ERROR
+};
+
+struct lint_line {
+  unsigned int lineno;
+  int broken;
+  char *type;          /* NULL for empty lines */
+  char *control;       /* NULL for "@include" */
+  char *module;
+  char *arguments;
+};
+
+struct lint_file {
+  const char *name;
+  struct lint_line *lines;
+  size_t nlines;
+};
+
+struct lint_finding {
+  unsigned int lineno;
+  enum lint_severity severity;
+  char *rule;
+  char *message;
+};
+
+struct lint_result {
+  char *name;
+  uint64_t hash;
+  struct lint_finding *findings;
+  size_t nfindings;
+};
+
+struct lint_rule {
+  const char *id;
+  enum lint_severity severity;
+  int (*check) (const struct lint_rule *rule, const struct lint_file *lf,
+		struct lint_result *res);
+};
+
+struct module_state {
+  char *name;
+  int installed;
+  struct module_state *next;
+};
+
+static __thread struct module_state *module_states;
+
+static int add_finding (struct lint_result *res, const struct lint_rule *rule,
+			unsigned int lineno, const char *fmt, ...)
+  __attribute__ ((format (printf, 4, 5)));
+
+static int
+add_finding (struct lint_result *res, const struct lint_rule *rule,
+	     unsigned int lineno, const char *fmt, ...)
+{
+  struct lint_finding *findings, *f;
+  va_list ap;
+  int n;
+
+  findings = realloc (res->findings, (res->nfindings + 1) *
+		      sizeof (struct lint_finding));
+  if (findings == NULL)
+    return -1;
+  res->findings = findings;
+
+  f = &res->findings[res->nfindings];
+  f->lineno = lineno;
+  f->severity = rule->severity;
+  f->rule = strdup (rule->id);
+  va_start (ap, fmt);
+  n = vasprintf (&f->message, fmt, ap);
+  va_end (ap);
+  if (n < 0 || f->rule == NULL)
+    {
+      if (n >= 0)
+	free (f->message);
+      free (f->rule);
+      return -1;
+    }
+  res->nfindings++;
+
+  return 0;
+}
+
+static const char *
+module_basename (const char *module)
+{
+  const char *cp = strrchr (module, '/');
+
+  return cp ? cp + 1 : module;
+}
+
+static int
+is_include (const struct lint_line *ll)
+{
+  return ll->control == NULL ||
+    strcasecmp (ll->control, "include") == 0 ||
+    strcasecmp (ll->control, "substack") == 0;
+}
+
+static int
+check_syntax (const struct lint_rule *rule, const struct lint_file *lf,
+	      struct lint_result *res)
+{
+  size_t i;
+
+  for (i = 0; i < lf->nlines; i++)
+    {
+      const struct lint_line *ll = &lf->lines[i];
+      const char *type = ll->type;
+
+      if (ll->broken)
+	{
+	  if (add_finding (res, rule, ll->lineno, _("broken line")) != 0)
+	    return -1;
+	  continue;
+	}
+      if (type == NULL)
+	continue;
+
+      if (type[0] == '@')
+	{
+	  if (strcasecmp (type, "@include") != 0 &&
+	      add_finding (res, rule, ll->lineno,
+			   _("unknown directive '%s'"), type) != 0)
+	    return -1;
+	  continue;
+	}
+
+      if (type[0] == '-')
+	type++;
+      if (strcasecmp (type, "auth") != 0 && strcasecmp (type, "account") != 0 &&
+	  strcasecmp (type, "password") != 0 &&
+	  strcasecmp (type, "session") != 0 &&
+	  add_finding (res, rule, ll->lineno,
+		       _("unknown type '%s'"), ll->type) != 0)
+	return -1;
+    }
+
+  return 0;
+}
+
+static int
+check_includes (const struct lint_rule *rule, const struct lint_file *lf,
+		struct lint_result *res)
+{
+  size_t i;
+
+  for (i = 0; i < lf->nlines; i++)
+    {
+      const struct lint_line *ll = &lf->lines[i];
+      char *path;
+
+      if (ll->type == NULL || ll->broken || !is_include (ll))
+	continue;
+
+      if (ll->module[0] == '/')
+	{
+	  if (vfs->access (ll->module, R_OK) == 0)
+	    continue;
+	}
+      else if ((path = find_config_file (confdir, ll->module)) != NULL)
+	{
+	  free (path);
+	  continue;
+	}
+      else if (errno == ENOMEM)
+	return -1;
+
+      if (add_finding (res, rule, ll->lineno,
+		       _("included file '%s' not found"), ll->module) != 0)
+	return -1;
+    }
+
+  return 0;
+}
+
+/* Every module is checked only once per run.  */
+static int
+is_module_installed (const char *module)
+{
+  struct module_state *ms;
+
+  for (ms = module_states; ms != NULL; ms = ms->next)
+    if (strcmp (ms->name, module) == 0)
+      return ms->installed;
+
+  ms = malloc (sizeof (struct module_state));
+  if (ms == NULL || (ms->name = strdup (module)) == NULL)
+    {
+      free (ms);
+      return -1;
+    }
+  if (module[0] == '/')
+    ms->installed = vfs_have_module (module);
+  else
+    ms->installed = is_pam_module_installed (module);
+  ms->next = module_states;
+  module_states = ms;
+
+  return ms->installed;
+}
+
+static void
+free_module_states (void)
+{
+  while (module_states != NULL)
+    {
+      struct module_state *ms = module_states;
+
+      module_states = ms->next;
+      free (ms->name);
+      free (ms);
+    }
+}
+
+static int
+check_modules (const struct lint_rule *rule, const struct lint_file *lf,
+	       struct lint_result *res)
+{
+  size_t i;
+
+  for (i = 0; i < lf->nlines; i++)
+    {
+      const struct lint_line *ll = &lf->lines[i];
+      int installed;
+
+      /* "-type" means PAM ignores a missing module.  */
+      if (ll->type == NULL || ll->broken || is_include (ll) ||
+	  ll->type[0] == '-')
+	continue;
+
+      installed = is_module_installed (ll->module);
+      if (installed < 0)
+	return -1;
+      if (!installed &&
+	  add_finding (res, rule, ll->lineno,
+		       _("module %s is not installed"), ll->module) != 0)
+	return -1;
+    }
+
+  return 0;
+}
+
+static int
+check_duplicates (const struct lint_rule *rule, const struct lint_file *lf,
+		  struct lint_result *res)
+{
+  size_t i, j;
+
+  for (i = 0; i < lf->nlines; i++)
+    {
+      const struct lint_line *ll = &lf->lines[i];
+
+      if (ll->type == NULL || ll->broken || is_include (ll))
+	continue;
+
+      for (j = 0; j < i; j++)
+	{
+	  const struct lint_line *prev = &lf->lines[j];
+
+	  if (prev->type == NULL || prev->broken || is_include (prev))
+	    continue;
+
+	  if (strcasecmp (ll->type, prev->type) == 0 &&
+	      strcmp (module_basename (ll->module),
+		      module_basename (prev->module)) == 0 &&
+	      strcmp (ll->arguments ? ll->arguments : "",
+		      prev->arguments ? prev->arguments : "") == 0)
+	    {
+	      if (add_finding (res, rule, ll->lineno,
+			       _("%s is already used in line %u"),
+			       ll->module, prev->lineno) != 0)
+		return -1;
+	      break;
+	    }
+	}
+    }
+
+  return 0;
+}
+
+static int
+check_cryptpass (const struct lint_rule *rule, const struct lint_file *lf,
+		 struct lint_result *res)
+{
+  unsigned int cryptpass = 0;
+  int with_mount = FALSE;
+  size_t i;
+
+  for (i = 0; i < lf->nlines; i++)
+    {
+      const struct lint_line *ll = &lf->lines[i];
+      const char *module;
+
+      if (ll->type == NULL || ll->broken || is_include (ll))
+	continue;
+
+      module = module_basename (ll->module);
+      if (cryptpass == 0 && strcmp (module, "pam_cryptpass.so") == 0)
+	cryptpass = ll->lineno;
+      else if (strcmp (module, "pam_mount.so") == 0)
+	with_mount = TRUE;
+    }
+
+  if (cryptpass && !with_mount)
+    return add_finding (res, rule, cryptpass,
+			_("pam_cryptpass.so is used without pam_mount.so"));
+
+  return 0;
+}
+
+/* New checks need to be added here.  */
+static const struct lint_rule lint_rules[] = {
+  {"syntax", LINT_ERROR, check_syntax},
+  {"missing-include", LINT_ERROR, check_includes},
+  {"missing-module", LINT_ERROR, check_modules},
+  {"duplicate-module", LINT_WARNING, check_duplicates},
+  {"cryptpass-without-mount", LINT_ERROR, check_cryptpass},
+};
+
+/* Split the content into lines, buf is modified.  */
+static int
+parse_lint_file (struct lint_file *lf, char *buf)
+{
+  unsigned int lineno = 0;
+  char *cp = buf;
+
+  while (*cp)
+    {
+      char *next = strchr (cp, '\n');
+      struct lint_line *lines, *ll;
+      int r;
+
+      if (next)
+	*next++ = '\0';
+      else
+	next = cp + strlen (cp);
+      lineno++;
+
+      lines = realloc (lf->lines, (lf->nlines + 1) * sizeof (struct lint_line));
+      if (lines == NULL)
+	return -1;
+      lf->lines = lines;
+      ll = &lf->lines[lf->nlines++];
+
+      r = split_config_line (cp, &ll->type, &ll->control, &ll->module,
+			     &ll->arguments);
+      ll->lineno = lineno;
+      ll->broken = r < 0;
+      if (r == 0)
+	ll->type = NULL;
+
+      cp = next;
+    }
+
+  return 0;
+}
+
+static int
+lint_file (struct lint_result *res, char *buf)
+{
+  struct lint_file lf = {res->name, NULL, 0};
+  size_t i;
+  int retval = 0;
+
+  if (debug)
+    printf ("*** lint_file (%s)\n", res->name);
+
+  if (parse_lint_file (&lf, buf) != 0)
+    retval = -1;
+
+  for (i = 0; retval == 0 && i < sizeof (lint_rules)/sizeof (lint_rules[0]); i++)
+    retval = lint_rules[i].check (&lint_rules[i], &lf, res);
+
+  /* Sort by line, findings for the same line stay in rule order.  */
+  for (i = 1; i < res->nfindings; i++)
+    {
+      struct lint_finding f = res->findings[i];
+      size_t j = i;
+
+      while (j > 0 && res->findings[j - 1].lineno > f.lineno)
+	{
+	  res->findings[j] = res->findings[j - 1];
+	  j--;
+	}
+      res->findings[j] = f;
+    }
+
+  free (lf.lines);
+
+  return retval;
+}
+
+static char *
+read_lint_file (const char *file, size_t *len)
+{
+  char *buf = NULL;
+  size_t size = 0;
+  FILE *fp;
+
+  fp = vfs->open_read (file);
+  if (fp == NULL)
+    return NULL;
+
+  *len = 0;
+  while (1)
+    {
+      size_t n;
+
+      if (*len + 1 >= size)
+	{
+	  char *tmp;
+
+	  size = size ? size * 2 : 4096;
+	  if ((tmp = realloc (buf, size)) == NULL)
+	    {
+	      free (buf);
+	      fclose (fp);
+	      return NULL;
+	    }
+	  buf = tmp;
+	}
+      n = fread (buf + *len, 1, size - *len - 1, fp);
+      *len += n;
+      if (n == 0)
+	break;
+    }
+  buf[*len] = '\0';
+
+  if (ferror (fp))
+    {
+      free (buf);
+      buf = NULL;
+    }
+  fclose (fp);
+
+  return buf;
+}
+
+static int
+lint_filter (const struct dirent *dentry)
+{
+  /* skip '.', '..', backups and temporary files */
+  return dentry->d_name[0] != '.' && strchr (dentry->d_name, '.') == NULL;
+}
+
+static int
+hidden_filter (const struct dirent *dentry)
+{
+  return dentry->d_name[0] != '.';
+}
+
+/* Findings about includes and modules only change if files in the
+   pam.d directories or the module directory come or go.  */
+static uint64_t
+tree_key (void)
+{
+  const char *dirs[] = {confdir, CONF_FALLBACK_DIR1, CONF_FALLBACK_DIR2};
+  uint64_t hash = CACHE_HASH_INIT;
+  struct stat st;
+  char *dname;
+  size_t i;
+
+  for (i = 0; i < sizeof (dirs)/sizeof (dirs[0]); i++)
+    {
+      struct dirent **namelist;
+      int n, j;
+
+      if (asprintf (&dname, "%s/pam.d", dirs[i]) < 0)
+	return 0;
+      hash = cache_hash_bytes (hash, dname, strlen (dname) + 1);
+      n = vfs->scandir (dname, &namelist, &hidden_filter);
+      free (dname);
+      for (j = 0; j < n; j++)
+	{
+	  hash = cache_hash_bytes (hash, namelist[j]->d_name,
+				   strlen (namelist[j]->d_name) + 1);
+	  free (namelist[j]);
+	}
+      if (n >= 0)
+	free (namelist);
+    }
+
+  if (asprintf (&dname, "%s%s", vfs_module_root (), PAM_MODULE_DIR) < 0)
+    return 0;
+  if (vfs->stat (dname, &st) == 0)
+    {
+      hash = cache_hash_bytes (hash, &st.st_ino, sizeof (st.st_ino));
+      hash = cache_hash_bytes (hash, &st.st_mtim, sizeof (st.st_mtim));
+    }
+  free (dname);
+
+  return hash;
+}
+
+static int
+read_cached_result (cache_reader_t *r, const char **name, uint64_t *hash,
+		    struct lint_result *res)
+{
+  uint32_t i, nfindings;
+
+  if (read_cache_string (r, name) != 0 ||
+      read_cache_bytes (r, hash, sizeof (uint64_t)) != 0 ||
+      read_cache_u32 (r, &nfindings) != 0)
+    return -1;
+
+  for (i = 0; i < nfindings; i++)
+    {
+      struct lint_rule rule;
+      const char *message;
+      uint32_t lineno, severity;
+
+      if (read_cache_u32 (r, &lineno) != 0 ||
+	  read_cache_u32 (r, &severity) != 0 ||
+	  read_cache_string (r, &rule.id) != 0 ||
+	  read_cache_string (r, &message) != 0)
+	return -1;
+      rule.severity = severity == LINT_ERROR ? LINT_ERROR : LINT_WARNING;
+      if (res && add_finding (res, &rule, lineno, "%s", message) != 0)
+	return -1;
+    }
+
+  return 0;
+}
+
+static int
+map_lint_cache (uint64_t key, cache_map_t *cm)
+{
+  cache_reader_t check;
+  uint64_t cached_key;
+
+  if (!map_cache_file (LINT_CACHE_FILE, LINT_CACHE_MAGIC, cm))
+    return FALSE;
+
+  if (read_cache_bytes (&cm->r, &cached_key, sizeof (cached_key)) != 0 ||
+      cached_key != key)
+    goto invalid;
+
+  check = cm->r;
+  while (check.pos < check.end)
+    {
+      const char *name;
+      uint64_t hash;
+
+      if (read_cached_result (&check, &name, &hash, NULL) != 0)
+	goto invalid;
+    }
+
+  return TRUE;
+
+ invalid:
+  if (debug)
+    printf ("*** map_lint_cache: ignoring outdated cache in %s\n", cachedir);
+  unmap_cache_file (cm);
+  return FALSE;
+}
+
+/* Take the findings from the cache if the content did not change.  */
+static int
+lookup_cached_result (cache_reader_t *r, struct lint_result *res, int *stale)
+{
+  while (r && r->pos < r->end)
+    {
+      cache_reader_t record = *r;
+      const char *name;
+      uint64_t hash;
+      int cmp;
+
+      read_cached_result (&record, &name, &hash, NULL);
+      cmp = strcmp (name, res->name);
+      if (cmp > 0)
+	break;
+
+      if (cmp == 0 && hash == res->hash)
+	{
+	  if (read_cached_result (r, &name, &hash, res) != 0)
+	    return -1;
+	  return TRUE;
+	}
+      *r = record;
+      if (cmp == 0)
+	break;
+      *stale = TRUE;
+    }
+
+  *stale = TRUE;
+  return FALSE;
+}
+
+static void
+write_lint_cache (uint64_t key, const struct lint_result *results, int n)
+{
+  FILE *fp = create_cache_file (LINT_CACHE_FILE, LINT_CACHE_MAGIC);
+  int i, retval;
+
+  if (fp == NULL)
+    return;
+
+  retval = write_cache_bytes (fp, &key, sizeof (key));
+  for (i = 0; retval == 0 && i < n; i++)
+    {
+      const struct lint_result *res = &results[i];
+      size_t j;
+
+      if (res->name == NULL)
+	continue;
+
+      if (write_cache_string (fp, res->name) != 0 ||
+	  write_cache_bytes (fp, &res->hash, sizeof (res->hash)) != 0 ||
+	  write_cache_u32 (fp, res->nfindings) != 0)
+	retval = -1;
+      for (j = 0; retval == 0 && j < res->nfindings; j++)
+	if (write_cache_u32 (fp, res->findings[j].lineno) != 0 ||
+	    write_cache_u32 (fp, res->findings[j].severity) != 0 ||
+	    write_cache_string (fp, res->findings[j].rule) != 0 ||
+	    write_cache_string (fp, res->findings[j].message) != 0)
+	  retval = -1;
+    }
+
+  close_cache_file (fp, LINT_CACHE_FILE, retval == 0);
+}
+
+/* Symlinks to other files in pam.d, like common-auth, are checked
+   with their target.  */
+static int
+is_local_symlink (const char *file)
+{
+  char target[256];
+  struct stat st;
+  ssize_t n;
+
+  if (vfs->lstat (file, &st) != 0 || !S_ISLNK (st.st_mode))
+    return FALSE;
+
+  n = vfs->readlink (file, target, sizeof (target) - 1);
+  if (n < 0)
+    return FALSE;
+  target[n] = '\0';
+
+  return strchr (target, '/') == NULL;
+}
+
+static int
+lint_service (const char *conf_dname, const char *name,
+	      struct lint_result *res, cache_reader_t *r, int *stale)
+{
+  char *file, *buf;
+  size_t len;
+  int retval;
+
+  if (asprintf (&file, "%s/%s", conf_dname, name) < 0)
+    return -1;
+
+  if (is_local_symlink (file))
+    {
+      free (file);
+      return 0;
+    }
+
+  buf = read_lint_file (file, &len);
+  if (buf == NULL)
+    {
+      fprintf (stderr, _("Cannot read '%s': %m\n"), file);
+      free (file);
+      return 1;
+    }
+  free (file);
+
+  if ((res->name = strdup (name)) == NULL)
+    {
+      free (buf);
+      return -1;
+    }
+  res->hash = cache_hash_bytes (CACHE_HASH_INIT, buf, len);
+
+  retval = lookup_cached_result (r, res, stale);
+  if (retval == FALSE)
+    retval = lint_file (res, buf);
+  else if (retval == TRUE)
+    retval = 0;
+  free (buf);
+
+  return retval;
+}
+
+int
+lint_service_files (void)
+{
+  struct lint_result *results = NULL;
+  struct dirent **namelist;
+  cache_reader_t *r = NULL;
+  cache_map_t cache;
+  char *conf_dname;
+  uint64_t key = 0;
+  int n, i, retval = 0, stale = FALSE, errors = 0;
+
+  if (asprintf (&conf_dname, "%s/pam.d", confdir) < 0)
+    {
+      fprintf (stderr, _("Out of memory\n"));
+      return 1;
+    }
+
+  n = vfs->scandir (conf_dname, &namelist, &lint_filter);
+  if (n < 0)
+    {
+      fprintf (stderr, _("Cannot access '%s': %m\n"), conf_dname);
+      free (conf_dname);
+      return 1;
+    }
+
+  if (cachedir)
+    {
+      key = tree_key ();
+      if (map_lint_cache (key, &cache))
+	r = &cache.r;
+      else
+	stale = TRUE;
+    }
+
+  if (n > 0 && (results = calloc (n, sizeof (struct lint_result))) == NULL)
+    retval = -1;
+
+  for (i = 0; i < n; i++)
+    {
+      if (retval >= 0)
+	{
+	  int r2 = lint_service (conf_dname, namelist[i]->d_name,
+				 &results[i], r, &stale);
+	  if (r2 != 0)
+	    retval = r2;
+	}
+      free (namelist[i]);
+    }
+  free (namelist);
+  free (conf_dname);
+
+  if (r && r->pos < r->end)
+    stale = TRUE;
+  if (r)
+    unmap_cache_file (&cache);
+
+  if (retval < 0)
+    fprintf (stderr, _("Out of memory\n"));
+  else
+    {
+      for (i = 0; i < n; i++)
+	{
+	  size_t j;
+
+	  for (j = 0; j < results[i].nfindings; j++)
+	    {
+	      const struct lint_finding *f = &results[i].findings[j];
+
+	      printf ("%s:%u: %s: %s [%s]\n", results[i].name, f->lineno,
+		      f->severity == LINT_ERROR ? "error" : "warning",
+		      f->message, f->rule);
+	      if (f->severity == LINT_ERROR)
+		errors++;
+	    }
+	}
+      if (cachedir && stale)
+	write_lint_cache (key, results, n);
+    }
+
+  for (i = 0; results && i < n; i++)
+    {
+      size_t j;
+
+      for (j = 0; j < results[i].nfindings; j++)
+	{
+	  free (results[i].findings[j].rule);
+	  free (results[i].findings[j].message);
+	}
+      free (results[i].findings);
+      free (results[i].name);
+    }
+  free (results);
+  free_module_states ();
+
+  return (retval != 0 || errors) ? 1 : 0;
+}
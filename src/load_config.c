@@ -30,11 +30,39 @@
 #include "pam-config.h"
 #include "pam-module.h"
 
-/* Load a configuration file. Try sysconfdir/pam.d/..., if that is not found, try
-   path2/pam.d/..., if not found, try path3/pam.d/... */
-int
-load_config (const char *sysconfdir, const char *file, write_type_t wtype,
-	     pam_module_t **module_list, int warn_unknown_mod)
+__thread unsigned int config_warnings = 0;
+
+/* Find a configuration file. Try sysconfdir/pam.d/..., if that is not
+   found, try path2/pam.d/..., if not found, try path3/pam.d/...
+   Returns the malloc'ed path or NULL, errno is ENOMEM if we run out
+   of memory.  */
+char *
+find_config_file (const char *sysconfdir, const char *file)
+{
+  const char *dirs[] = {sysconfdir, CONF_FALLBACK_DIR1, CONF_FALLBACK_DIR2};
+  char *configpath;
+  size_t i;
+
+  for (i = 0; i < sizeof (dirs)/sizeof (dirs[0]); i++)
+    {
+      if (asprintf (&configpath, "%s/pam.d/%s", dirs[i], file) < 0)
+	{
+	  errno = ENOMEM;
+	  return NULL;
+	}
+      if (vfs->access (configpath, R_OK) == 0)
+	return configpath;
+      free (configpath);
+    }
+
+  errno = ENOENT;
+  return NULL;
+}
+
+static int
+parse_config_file (const char *sysconfdir, const char *file,
+		   write_type_t wtype, pam_module_t **module_list,
+		   int warn_unknown_mod)
 {
   FILE *fp;
   char *buf = NULL;
@@ -45,49 +73,39 @@ load_config (const char *sysconfdir, const char *file, write_type_t wtype,
   if (debug)
     printf ("*** load_config (%s, %s, ...)\n", file, wanted);
 
-  if (asprintf (&configpath, "%s/pam.d/%s", sysconfdir, file) < 0)
+  if (plan_mode)
     {
-      fprintf (stderr, "Running out of memory\n");
-      return -1;
-    }
-
-  if (access (configpath, R_OK) < 0) {
-    free (configpath);
-    configpath = NULL;
+      int planned;
 
-    if (asprintf (&configpath, "%s/pam.d/%s", CONF_FALLBACK_DIR1, file) < 0)
-      {
-	fprintf (stderr, "Running out of memory\n");
-	return -1;
-      }
-
-    if (access (configpath, R_OK) < 0) {
-      free (configpath);
-      configpath = NULL;
+      /* a planned file replaces the one on disk */
+      fp = plan_open_file (file, &planned);
+      if (planned && fp == NULL)
+	return 0;
+      if (fp)
+	goto read_config;
+    }
 
-      if (asprintf (&configpath, "%s/pam.d/%s", CONF_FALLBACK_DIR2, file) < 0)
+  configpath = find_config_file (sysconfdir, file);
+  if (configpath == NULL)
+    {
+      if (errno == ENOMEM)
 	{
 	  fprintf (stderr, "Running out of memory\n");
 	  return -1;
 	}
 
-      if (access (configpath, R_OK) < 0) {
-	free (configpath);
-	configpath = NULL;
-
-	if (debug)
-	  printf ("*** Config file %s not found\n", file);
+      if (debug)
+	printf ("*** Config file %s not found\n", file);
 
-	return 0;
-      }
+      return 0;
     }
-  }
 
   if (debug)
     printf ("*** Using config file %s\n", configpath);
 
 
-  fp = fopen(configpath, "r");
+  fp = vfs->open_read (configpath);
+  free (configpath);
   if (fp == NULL)
     {
       if (errno == ENOENT)
@@ -96,6 +114,7 @@ load_config (const char *sysconfdir, const char *file, write_type_t wtype,
 	return -1;
     }
 
+ read_config:
   while (!feof (fp))
     {
       char *cp, *tmp, *type, *control, *module, *arguments;
@@ -135,7 +154,11 @@ load_config (const char *sysconfdir, const char *file, write_type_t wtype,
 	  if (cp)
 	    {
 	      cp++;
-	      *cp++ = '\0';
+	      /* "[...]" at the end of the line has no module */
+	      if (*cp == '\0')
+		cp = NULL;
+	      else
+		*cp++ = '\0';
 	    }
 	}
       else
@@ -172,14 +195,26 @@ load_config (const char *sysconfdir, const char *file, write_type_t wtype,
 
 	  if (NULL != mod)
 	    {
-	      if (!mod->parse_config (mod, arguments, wtype))
-		fprintf (stderr,
-			 _("%s (%s): Arguments will be ignored\n"),
-			 file, module);
+	      struct timespec start;
+	      int ok;
+
+	      TRACE_BEGIN (start);
+	      ok = mod->parse_config (mod, arguments, wtype);
+	      TRACE_END (start, "parse_config", mod->name, wtype, file);
+	      if (!ok)
+		{
+		  fprintf (stderr,
+			   _("%s (%s): Arguments will be ignored\n"),
+			   file, module);
+		  config_warnings++;
+		}
 	    }
 	  else if (warn_unknown_mod || debug)
-	    fprintf (stderr, _("%s: Unknown module %s, ignored!\n"),
-		     file, module);
+	    {
+	      fprintf (stderr, _("%s: Unknown module %s, ignored!\n"),
+		       file, module);
+	      config_warnings++;
+	    }
 	}
     }
 
@@ -190,3 +225,37 @@ load_config (const char *sysconfdir, const char *file, write_type_t wtype,
 
   return 0;
 }
+
+/* Load a configuration file, see find_config_file for the search
+   path.  */
+int
+load_config (const char *sysconfdir, const char *file, write_type_t wtype,
+	     pam_module_t **module_list, int warn_unknown_mod)
+{
+  int phase = STATS_PHASE (STATS_LOAD);
+  struct timespec start;
+  int retval;
+
+  TRACE_BEGIN (start);
+  retval = parse_config_file (sysconfdir, file, wtype, module_list,
+			      warn_unknown_mod);
+  TRACE_END (start, "load_config", NULL, wtype, file);
+  STATS_PHASE (phase);
+  return retval;
+}
+
+/* Load all four types of the common-*-pc files or of a service
+   file. The common files are taken from the state cache if it is
+   up to date.  */
+int
+load_all_types (const char *sysconfdir, const char *service,
+		pam_module_t **module_list)
+{
+  if (service == NULL)
+    return load_common_state (sysconfdir, module_list);
+
+  return load_config (sysconfdir, service, ACCOUNT, module_list, 0) ||
+    load_config (sysconfdir, service, AUTH, module_list, 0) ||
+    load_config (sysconfdir, service, PASSWORD, module_list, 0) ||
+    load_config (sysconfdir, service, SESSION, module_list, 0);
+}
@@ -376,7 +376,7 @@ parse_file (const char *file, pam_module_t *mod,
   if (debug)
     printf ("**** parse_file (%s, ...)\n", file);
 
-  fp = fopen (file, "r");
+  fp = vfs->open_read (file);
   if (fp == NULL)
     {
       if (errno != ENOENT)
@@ -449,7 +449,7 @@ load_obsolete_conf (pam_module_t **module_list)
   if (debug)
     printf ("*** load_obsolete_conf (...)\n");
 
-  if (access ("/etc/security/pam_unix2.conf", R_OK) == 0)
+  if (vfs->access ("/etc/security/pam_unix2.conf", R_OK) == 0)
     {
       pam_module_t *mod = lookup (module_list, "pam_unix2.so");
 
@@ -457,7 +457,7 @@ load_obsolete_conf (pam_module_t **module_list)
 		      parse_option_unix2) == -1)
 	return -1;
     }
-  else if (access ("/etc/security/pam_unix2.conf.rpmsave", R_OK) == 0)
+  else if (vfs->access ("/etc/security/pam_unix2.conf.rpmsave", R_OK) == 0)
     {
       pam_module_t *mod = lookup (module_list, "pam_unix2.so");
 
@@ -472,7 +472,7 @@ load_obsolete_conf (pam_module_t **module_list)
     }
 
 
-  if (access ("/etc/security/pam_pwcheck.conf", R_OK) == 0)
+  if (vfs->access ("/etc/security/pam_pwcheck.conf", R_OK) == 0)
     {
       pam_module_t *mod = lookup (module_list, "pam_pwcheck.so");
 
@@ -480,7 +480,7 @@ load_obsolete_conf (pam_module_t **module_list)
 		      parse_option_pwcheck) == -1)
 	return -1;
     }
-  else if (access ("/etc/security/pam_pwcheck.conf.rpmsave", R_OK) == 0)
+  else if (vfs->access ("/etc/security/pam_pwcheck.conf.rpmsave", R_OK) == 0)
     {
       pam_module_t *mod = lookup (module_list, "pam_pwcheck.so");
 
@@ -0,0 +1,143 @@
+/* Copyright (C) 2020 Thorsten Kukuk
+   Author: Thorsten Kukuk <kukuk@thkukuk.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pam-config.h"
+
+/* --verify --metrics-textfile: the metrics are taken from the
+   option sets loaded for --verify and the results of its checks,
+   the config files are not read again. The file is written with
+   vfs->replace(), so the textfile collector never sees a partial
+   file, and the temporary file does not end in ".prom".  */
+
+static const char *symlinks[][2] = {
+  {CONF_ACCOUNT, CONF_ACCOUNT_PC},
+  {CONF_AUTH, CONF_AUTH_PC},
+  {CONF_PASSWORD, CONF_PASSWORD_PC},
+  {CONF_SESSION, CONF_SESSION_PC}
+};
+
+static const char *symlink_states[] = {"active", "inactive", "missing"};
+
+static void
+print_header (FILE *fp, const char *name, const char *help)
+{
+  fprintf (fp, "# HELP pam_config_%s %s\n", name, help);
+  fprintf (fp, "# TYPE pam_config_%s gauge\n", name);
+}
+
+static unsigned int
+count_enabled (pam_module_t **module_list, write_type_t type)
+{
+  unsigned int count = 0;
+  size_t i;
+
+  for (i = 0; module_list[i] != NULL; i++)
+    {
+      option_set_t *opt_set = module_list[i]->get_opt_set (module_list[i],
+							   type);
+
+      if (opt_set->is_enabled (opt_set, "is_enabled"))
+	count++;
+    }
+
+  return count;
+}
+
+int
+write_verify_metrics (const char *path, const verify_result_t *result)
+{
+  unsigned int violations = 0;
+  struct timespec end;
+  write_type_t type;
+  char *buf = NULL;
+  size_t len = 0, i, j;
+  FILE *fp;
+  int retval;
+
+  clock_gettime (CLOCK_MONOTONIC, &end);
+
+  fp = open_memstream (&buf, &len);
+  if (fp == NULL)
+    {
+      fprintf (stderr, _("Running out of memory\n"));
+      return 1;
+    }
+
+  for (type = AUTH; type <= SESSION; type++)
+    violations += result->violations[type];
+
+  print_header (fp, "verify_success",
+		"1 if pam-config --verify found no problem.");
+  fprintf (fp, "pam_config_verify_success %d\n",
+	   violations == 0 && result->missing_modules == 0);
+
+  print_header (fp, "enabled_modules",
+		"Modules enabled in the common config per management group.");
+  for (type = AUTH; type <= SESSION; type++)
+    fprintf (fp, "pam_config_enabled_modules{group=\"%s\"} %u\n",
+	     type2string (type), count_enabled (common_module_list, type));
+
+  print_header (fp, "missing_modules",
+		"Enabled modules which are not installed.");
+  fprintf (fp, "pam_config_missing_modules %u\n", result->missing_modules);
+
+  print_header (fp, "common_file",
+		"State of the common files, active if it is a symlink "
+		"to the common-*-pc file.");
+  for (i = 0; i < sizeof (symlinks) / sizeof (symlinks[0]); i++)
+    {
+      const char *status = symlink_status (symlinks[i][0], symlinks[i][1]);
+
+      for (j = 0; j < sizeof (symlink_states) / sizeof (symlink_states[0]);
+	   j++)
+	fprintf (fp, "pam_config_common_file{file=\"%s\",state=\"%s\"} %d\n",
+		 symlinks[i][0], symlink_states[j],
+		 strcmp (status, symlink_states[j]) == 0);
+    }
+
+  print_header (fp, "sanity_violations",
+		"Failed sanity checks per management group.");
+  for (type = AUTH; type <= SESSION; type++)
+    fprintf (fp, "pam_config_sanity_violations{group=\"%s\"} %u\n",
+	     type2string (type), result->violations[type]);
+
+  print_header (fp, "verify_duration_seconds",
+		"Wall time of the verify, loading the config included.");
+  fprintf (fp, "pam_config_verify_duration_seconds %.6f\n",
+	   (end.tv_sec - result->start.tv_sec) +
+	   (end.tv_nsec - result->start.tv_nsec) / 1e9);
+
+  if (fclose (fp) != 0)
+    {
+      fprintf (stderr, _("Running out of memory\n"));
+      free (buf);
+      return 1;
+    }
+
+  retval = vfs->replace (path, buf, len) != 0;
+  free (buf);
+
+  return retval;
+}
@@ -56,15 +56,16 @@ PRINT_ARGS("access")
 PRINT_XMLHELP("access")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_4 (is_enabled, debug, nodefgroup, noaudit);
-DECLARE_STRING_OPTS_3 (accessfile, fieldsep, listsep);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug", "nodefgroup", "noaudit");
+DECLARE_STRING_OPTS ("accessfile", "fieldsep", "listsep");
 
-static module_helptext_t helptext[] = {{"", NULL, "pam_access for account access rules"},
+static const module_helptext_t helptext[] = {{"", NULL, "pam_access for account access rules"},
 				       {NULL, NULL, NULL}};
 
+DECLARE_SCHEMA (TYPE_MASK (ACCOUNT), helptext);
+
 /* at last construct the complete module object */
-pam_module_t mod_pam_access = { "pam_access.so", opt_sets, helptext,
+pam_module_t mod_pam_access = { "pam_access.so", &schema,
 			      &def_parse_config,
 			      &def_print_module,
 			      &write_config_access,
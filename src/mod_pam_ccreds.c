@@ -39,6 +39,22 @@ write_config_ccreds (pam_module_t *this, enum write_type op,
   return 0;
 }
 
+/* The lines are written by pam_krb5 and pam_ldap, their arguments
+   are no options of pam-config.  */
+static int
+parse_config_ccreds (pam_module_t *this, char *args, write_type_t type)
+{
+  option_set_t *opt_set = this->get_opt_set (this, type);
+
+  if (debug)
+    printf ("**** parse_config_%s (%s): '%s'\n", this->name,
+	    type2string (type), args ? args : "");
+
+  opt_set->enable (opt_set, "is_enabled", TRUE);
+
+  return 1;
+}
+
 GETOPT_START_1(AUTH)
 GETOPT_END_1(AUTH)
 
@@ -46,16 +62,16 @@ PRINT_ARGS("ccreds")
 PRINT_XMLHELP("ccreds")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_1( is_enabled );
-DECLARE_STRING_OPTS_0;
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled");
+DECLARE_NO_STRING_OPTS;
+
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+DECLARE_SCHEMA (TYPE_MASK (AUTH), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_ccreds = { "pam_ccreds.so", opt_sets,
-				helptext,
-				&def_parse_config,
+pam_module_t mod_pam_ccreds = { "pam_ccreds.so", &schema,
+				&parse_config_ccreds,
 				&def_print_module,
 				&write_config_ccreds,
 				&get_opt_set,
@@ -104,15 +104,15 @@ PRINT_ARGS("ck_connector")
 PRINT_XMLHELP("ck_connector")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_2( is_enabled, debug );
-DECLARE_STRING_OPTS_0;
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug");
+DECLARE_NO_STRING_OPTS;
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (SESSION), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_ck_connector = { "pam_ck_connector.so", opt_sets,
-				      helptext,
+pam_module_t mod_pam_ck_connector = { "pam_ck_connector.so", &schema,
 				      &def_parse_config,
 				      &def_print_module,
 				      &write_config_ck_connector,
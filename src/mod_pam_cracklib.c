@@ -56,14 +56,15 @@ PRINT_ARGS("cracklib")
 PRINT_XMLHELP("cracklib")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_5(is_enabled, debug, reject_username, gecoscheck, enforce_for_root);
-DECLARE_STRING_OPTS_14(authtok_type, retry, difok, difignore, minlen, dcredit, ucredit, lcredit, ocredit, minclass, dictpath, maxrepeat, maxsequence, maxclassrepeat);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug", "reject_username", "gecoscheck", "enforce_for_root");
+DECLARE_STRING_OPTS ("authtok_type", "retry", "difok", "difignore", "minlen", "dcredit", "ucredit", "lcredit", "ocredit", "minclass", "dictpath", "maxrepeat", "maxsequence", "maxclassrepeat");
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (PASSWORD), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_cracklib = { "pam_cracklib.so", opt_sets, helptext,
+pam_module_t mod_pam_cracklib = { "pam_cracklib.so", &schema,
 				  &def_parse_config,
 				  &def_print_module,
 				  &write_config_cracklib,
@@ -44,10 +44,10 @@ password_pred_cryptpass (config_content_t *cfg_content)
   do_insert = strcasestr (cfg_content->line, "pam_cryptpass.so") == NULL;
   /* and this line starts with 'password' */
   do_insert &= strcasestr (cfg_content->line, "password") != NULL;
-  /* and there is a next line */
-  do_insert &= cfg_content->next != NULL;
-  /* and that next line does not start with 'password' */
-  do_insert &= strcasestr (cfg_content->next->line, "password") == NULL;
+  /* and there is no next line, or the next line does not start
+   * with 'password' */
+  do_insert &= (  cfg_content->next == NULL ||
+		  strcasestr (cfg_content->next->line, "password") == NULL);
   return do_insert;
 }
 
@@ -124,14 +124,15 @@ PRINT_ARGS("cryptpass")
 PRINT_XMLHELP("cryptpass")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_1( is_enabled );
-DECLARE_STRING_OPTS_0;
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled");
+DECLARE_NO_STRING_OPTS;
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (PASSWORD) | TYPE_MASK (SESSION), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_cryptpass = { "pam_cryptpass.so", opt_sets, helptext,
+pam_module_t mod_pam_cryptpass = { "pam_cryptpass.so", &schema,
 				   &def_parse_config,
 				   &def_print_module,
 				   &write_config_cryptpass,
@@ -112,15 +112,15 @@ PRINT_ARGS("csync")
 PRINT_XMLHELP("csync")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_7 (is_enabled, use_first_pass, try_first_pass, soft_try_pass,
-		     nullok, debug, silent);
-DECLARE_STRING_OPTS_0;
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "use_first_pass", "try_first_pass", "soft_try_pass", "nullok", "debug", "silent");
+DECLARE_NO_STRING_OPTS;
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (AUTH) | TYPE_MASK (SESSION), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_csync = { "pam_csync.so", opt_sets, helptext,
+pam_module_t mod_pam_csync = { "pam_csync.so", &schema,
 			       &def_parse_config,
 			       &def_print_module,
 			       &write_config_csync,
@@ -48,13 +48,14 @@ write_config_deny (pam_module_t *this, enum write_type op,
 }
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_1 (is_enabled);
-DECLARE_STRING_OPTS_0;
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled");
+DECLARE_NO_STRING_OPTS;
+
+DECLARE_SCHEMA (ALL_TYPES, NULL);
 
 /* at last construct the complete module object */
 pam_module_t mod_pam_deny = {"pam_deny.so",
-			     opt_sets, NULL,
+			     &schema,
 			     &parse_config_deny,
 			     &def_print_module,
 			     &write_config_deny,
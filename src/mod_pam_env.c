@@ -84,14 +84,15 @@ PRINT_ARGS("env")
 PRINT_XMLHELP("env")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_2 (is_enabled, debug);
-DECLARE_STRING_OPTS_3 (conffile, envfile, readenv);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug");
+DECLARE_STRING_OPTS ("conffile", "envfile", "readenv");
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (AUTH) | TYPE_MASK (SESSION), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_env = {"pam_env.so", opt_sets, helptext,
+pam_module_t mod_pam_env = {"pam_env.so", &schema,
 			    &def_parse_config,
 			    &def_print_module,
 			    &write_config_env,
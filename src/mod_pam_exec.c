@@ -67,14 +67,11 @@ parse_config_exec (pam_module_t *this, char *args, write_type_t type)
 		  if (asprintf (&cp, "%s %s", oldval, key) < 0)
 		    {
 		      fprintf (stderr, _("ERROR: Out of memory.\n"));
-		      exit (1);
+		      return 0;
 		    }
 
 		  if (opt_set->set_opt (opt_set, "option", cp) == FALSE)
-		    {
-		      print_unknown_option_error (this->name, key);
-		      free (cp);
-		    }
+		    print_unknown_option_error (this->name, key);
 		}
 	      else
 		{
@@ -115,29 +112,22 @@ write_config_exec (pam_module_t *this, enum write_type op, FILE *fp)
       break;
   }
 
-  bool_option_t **cur_bool_opt = opt_set->bool_opts;
-  string_option_t **cur_str_opt = opt_set->string_opts;
+  size_t i;
 
-  while (*cur_bool_opt != NULL)
-    {
-      if ((strcmp ((*cur_bool_opt)->key, "is_enabled") != 0)
-	  && ((*cur_bool_opt)->value == TRUE))
-	fprintf (fp, "%s ", (*cur_bool_opt)->key);
-      cur_bool_opt++;
-    }
+  for (i = 0; opt_set->bool_keys[i] != NULL; i++)
+    if ((strcmp (opt_set->bool_keys[i], "is_enabled") != 0)
+	&& (opt_set->bool_values[i] == TRUE))
+      fprintf (fp, "%s ", opt_set->bool_keys[i]);
 
-  while (*cur_str_opt != NULL)
-    {
-      if ((strcmp ((*cur_str_opt)->key, "empty") != 0)
-	  && ((*cur_str_opt)->value))
-	{
-	  if (strcmp ((*cur_str_opt)->key, "option") == 0)
-	    fprintf (fp, "%s", (*cur_str_opt)->value);
-	  else
-	    fprintf (fp, "%s=%s ", (*cur_str_opt)->key, (*cur_str_opt)->value);
-	}
-      cur_str_opt++;
-    }
+  for (i = 0; opt_set->string_keys[i] != NULL; i++)
+    if (opt_set->string_values[i])
+      {
+	if (strcmp (opt_set->string_keys[i], "option") == 0)
+	  fprintf (fp, "%s", opt_set->string_values[i]);
+	else
+	  fprintf (fp, "%s=%s ", opt_set->string_keys[i],
+		   opt_set->string_values[i]);
+      }
 
   fprintf (fp, "\n");
 
@@ -151,15 +141,16 @@ PRINT_ARGS("exec")
 PRINT_XMLHELP("exec")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_5 (is_enabled, debug, expose_authtok, seteuid, quiet);
-DECLARE_STRING_OPTS_2 (log, option);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug", "expose_authtok", "seteuid", "quiet");
+DECLARE_STRING_OPTS ("log", "option");
 
-static module_helptext_t helptext[] = {{"", NULL, "pam_exec for password management"},
+static const module_helptext_t helptext[] = {{"", NULL, "pam_exec for password management"},
 				       {NULL, NULL, NULL}};
 
+DECLARE_SCHEMA (TYPE_MASK (PASSWORD) | TYPE_MASK (SESSION), helptext);
+
 /* at last construct the complete module object */
-pam_module_t mod_pam_exec = { "pam_exec.so", opt_sets, helptext,
+pam_module_t mod_pam_exec = { "pam_exec.so", &schema,
 			      &parse_config_exec,
 			      &def_print_module,
 			      &write_config_exec,
@@ -71,16 +71,17 @@ PRINT_ARGS("gnome_keyring");
 PRINT_XMLHELP("gnome_keyring");
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_2(is_enabled, auto_start);
-DECLARE_STRING_OPTS_1(only_if);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "auto_start");
+DECLARE_STRING_OPTS ("only_if");
 
-static module_helptext_t gnome_keyring_helptext[] = {{"", NULL, "Enable/Disable pam_gnome_keyring.so"},
+static const module_helptext_t gnome_keyring_helptext[] = {{"", NULL, "Enable/Disable pam_gnome_keyring.so"},
                                                      {NULL, NULL, NULL}};
 
 
-pam_module_t mod_pam_gnome_keyring = { "pam_gnome_keyring.so", opt_sets,
-				       gnome_keyring_helptext,
+DECLARE_SCHEMA (TYPE_MASK (AUTH) | TYPE_MASK (PASSWORD) | TYPE_MASK (SESSION),
+		gnome_keyring_helptext);
+
+pam_module_t mod_pam_gnome_keyring = { "pam_gnome_keyring.so", &schema,
 				       &def_parse_config,
 				       &def_print_module,
 				       &write_config_gnome_keyring,
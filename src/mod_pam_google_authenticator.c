@@ -93,14 +93,15 @@ PRINT_ARGS("google_authenticator")
 PRINT_XMLHELP("google_authenticator")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_3 (is_enabled, noskewadj, nullok);
-DECLARE_STRING_OPTS_1 (secret);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "noskewadj", "nullok");
+DECLARE_STRING_OPTS ("secret");
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (AUTH), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_google_authenticator = { "pam_google_authenticator.so", opt_sets, helptext,
+pam_module_t mod_pam_google_authenticator = { "pam_google_authenticator.so", &schema,
 			     &def_parse_config,
 			     &def_print_module,
 			     &write_config_google_authenticator,
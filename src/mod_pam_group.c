@@ -53,14 +53,15 @@ PRINT_ARGS("group")
 PRINT_XMLHELP("group")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_1 (is_enabled);
-DECLARE_STRING_OPTS_0;
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled");
+DECLARE_NO_STRING_OPTS;
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (AUTH), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_group = { "pam_group.so", opt_sets, helptext,
+pam_module_t mod_pam_group = { "pam_group.so", &schema,
 			       &def_parse_config,
 			       &def_print_module,
 			       &write_config_group,
@@ -121,14 +121,15 @@ PRINT_ARGS("keyinit")
 PRINT_XMLHELP("keyinit")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_3 (is_enabled, debug, force);
-DECLARE_STRING_OPTS_0;
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug", "force");
+DECLARE_NO_STRING_OPTS;
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (SESSION), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_keyinit = { "pam_keyinit.so", opt_sets, helptext,
+pam_module_t mod_pam_keyinit = { "pam_keyinit.so", &schema,
 			      &def_parse_config,
 			      &def_print_module,
 			      &write_config_keyinit,
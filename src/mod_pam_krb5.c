@@ -135,14 +135,15 @@ PRINT_ARGS("krb5")
 PRINT_XMLHELP("krb5")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_3 (is_enabled, debug, ignore_unknown_principals);
-DECLARE_STRING_OPTS_1 (minimum_uid);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug", "ignore_unknown_principals");
+DECLARE_STRING_OPTS ("minimum_uid");
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (ALL_TYPES, helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_krb5 = { "pam_krb5.so", opt_sets, helptext,
+pam_module_t mod_pam_krb5 = { "pam_krb5.so", &schema,
 			      &def_parse_config,
 			      &def_print_module,
 			      &write_config_krb5,
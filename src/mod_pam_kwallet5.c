@@ -69,16 +69,17 @@ PRINT_ARGS("kwallet5");
 PRINT_XMLHELP("kwallet5");
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_1(is_enabled);
-DECLARE_STRING_OPTS_0;
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled");
+DECLARE_NO_STRING_OPTS;
 
-static module_helptext_t kwallet5_helptext[] = {{"", NULL, "Enable/Disable pam_kwallet5.so"},
+static const module_helptext_t kwallet5_helptext[] = {{"", NULL, "Enable/Disable pam_kwallet5.so"},
                                                      {NULL, NULL, NULL}};
 
 
-pam_module_t mod_pam_kwallet5 = { "pam_kwallet5.so", opt_sets,
-				       kwallet5_helptext,
+DECLARE_SCHEMA (TYPE_MASK (AUTH) | TYPE_MASK (PASSWORD) | TYPE_MASK (SESSION),
+		kwallet5_helptext);
+
+pam_module_t mod_pam_kwallet5 = { "pam_kwallet5.so", &schema,
 				       &def_parse_config,
 				       &def_print_module,
 				       &write_config_kwallet5,
@@ -95,14 +95,15 @@ PRINT_ARGS("lastlog")
 PRINT_XMLHELP("lastlog")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_10 (is_enabled, debug, silent, never, nodate, nohost, noterm, nowtmp, noupdate, showfailed);
-DECLARE_STRING_OPTS_0;
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug", "silent", "never", "nodate", "nohost", "noterm", "nowtmp", "noupdate", "showfailed");
+DECLARE_NO_STRING_OPTS;
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (SESSION), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_lastlog = { "pam_lastlog.so", opt_sets, helptext,
+pam_module_t mod_pam_lastlog = { "pam_lastlog.so", &schema,
 				 &def_parse_config,
 				 &def_print_module,
 				 &write_config_lastlog,
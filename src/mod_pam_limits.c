@@ -57,14 +57,15 @@ PRINT_ARGS("limits")
 PRINT_XMLHELP("limits")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_4 (is_enabled, debug, change_uid, utmp_early);
-DECLARE_STRING_OPTS_1 (conf);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug", "change_uid", "utmp_early");
+DECLARE_STRING_OPTS ("conf");
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (SESSION), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_limits = {"pam_limits.so", opt_sets, helptext,
+pam_module_t mod_pam_limits = {"pam_limits.so", &schema,
 			       &def_parse_config,
 			       &def_print_module,
 			       &write_config_limits,
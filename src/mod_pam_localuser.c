@@ -68,14 +68,15 @@ PRINT_ARGS("localuser")
 PRINT_XMLHELP("localuser")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_2 (is_enabled, debug);
-DECLARE_STRING_OPTS_1 (file);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug");
+DECLARE_STRING_OPTS ("file");
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (ACCOUNT), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_localuser = { "pam_localuser.so", opt_sets, helptext,
+pam_module_t mod_pam_localuser = { "pam_localuser.so", &schema,
 				   &def_parse_config,
 				   &def_print_module,
 				   &write_config_localuser,
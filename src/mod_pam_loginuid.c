@@ -85,14 +85,15 @@ PRINT_ARGS("loginuid")
 PRINT_XMLHELP("loginuid")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_2 (is_enabled, require_auditd);
-DECLARE_STRING_OPTS_0;
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "require_auditd");
+DECLARE_NO_STRING_OPTS;
 
-static module_helptext_t helptext[] = {{"", NULL, NULL}};
+static const module_helptext_t helptext[] = {{"", NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (SESSION), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_loginuid = { "pam_loginuid.so", opt_sets, helptext,
+pam_module_t mod_pam_loginuid = { "pam_loginuid.so", &schema,
 				  &def_parse_config,
 				  &def_print_module,
 				  &write_config_loginuid,
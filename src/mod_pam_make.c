@@ -82,44 +82,42 @@ write_config_make (pam_module_t *this, enum write_type op, FILE *fp)
 
   fprintf (fp, "password\toptional\tpam_exec.so\t");
 
-  bool_option_t **cur_bool_opt = opt_set->bool_opts;
-  string_option_t **cur_str_opt = opt_set->string_opts;
+  size_t i;
 
-  while (*cur_bool_opt != NULL)
+  for (i = 0; opt_set->bool_keys[i] != NULL; i++)
     {
-      if (strcmp ((*cur_bool_opt)->key, "is_enabled") != 0)
+      const char *key = opt_set->bool_keys[i];
+
+      if (strcmp (key, "is_enabled") == 0)
+	continue;
+      if (strcmp (key, "nosetuid") == 0)
 	{
-	  if (strcmp ((*cur_bool_opt)->key, "nosetuid") == 0)
-	    {
-	      if ((*cur_bool_opt)->value == FALSE)
-		fprintf (fp, "seteuid ");
-	    }
-	  else if ((*cur_bool_opt)->value == TRUE)
-	    fprintf (fp, "%s ", (*cur_bool_opt)->key);
+	  if (opt_set->bool_values[i] == FALSE)
+	    fprintf (fp, "seteuid ");
 	}
-      cur_bool_opt++;
+      else if (opt_set->bool_values[i] == TRUE)
+	fprintf (fp, "%s ", key);
     }
 
-  while (*cur_str_opt != NULL)
+  for (i = 0; opt_set->string_keys[i] != NULL; i++)
     {
-      if (strcmp ((*cur_str_opt)->key, "empty") != 0)
+      const char *key = opt_set->string_keys[i];
+      const char *value = opt_set->string_values[i];
+
+      if (strcmp (key, "option") == 0)
 	{
-	  if (strcmp ((*cur_str_opt)->key, "option") == 0)
-	    {
-	      if ((*cur_str_opt)->value)
-		fprintf (fp, "%s", (*cur_str_opt)->value);
-	    }
-	  else if (strcmp ((*cur_str_opt)->key, "make") == 0)
-	    {
-	      if ((*cur_str_opt)->value)
-		fprintf (fp, "%s ", (*cur_str_opt)->value);
-	      else
-		fprintf (fp, "/usr/bin/make -C ");
-	    }
-	  else if ((*cur_str_opt)->value)
-	    fprintf (fp, "%s=%s ", (*cur_str_opt)->key, (*cur_str_opt)->value);
+	  if (value)
+	    fprintf (fp, "%s", value);
 	}
-      cur_str_opt++;
+      else if (strcmp (key, "make") == 0)
+	{
+	  if (value)
+	    fprintf (fp, "%s ", value);
+	  else
+	    fprintf (fp, "/usr/bin/make -C ");
+	}
+      else if (value)
+	fprintf (fp, "%s=%s ", key, value);
     }
 
   fprintf (fp, "\n");
@@ -134,14 +132,15 @@ write_config_make (pam_module_t *this, enum write_type op, FILE *fp)
    PRINT_XMLHELP("make") */
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_3 (is_enabled, debug, nosetuid);
-DECLARE_STRING_OPTS_3 (log, make, option); /* order is important!!! */
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug", "nosetuid");
+DECLARE_STRING_OPTS ("log", "make", "option"); /* order is important!!! */
+
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+DECLARE_SCHEMA (TYPE_MASK (PASSWORD), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_make = { "pam_make.so", opt_sets, helptext,
+pam_module_t mod_pam_make = { "pam_make.so", &schema,
 			      &parse_config_make,
 			      &def_print_module,
 			      &write_config_make,
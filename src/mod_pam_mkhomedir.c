@@ -37,14 +37,15 @@ PRINT_ARGS("mkhomedir")
 PRINT_XMLHELP("mkhomedir")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_3( is_enabled, debug, silent );
-DECLARE_STRING_OPTS_2( umask, skel );
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug", "silent");
+DECLARE_STRING_OPTS ("umask", "skel");
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (SESSION), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_mkhomedir = { "pam_mkhomedir.so", opt_sets, helptext,
+pam_module_t mod_pam_mkhomedir = { "pam_mkhomedir.so", &schema,
 				   &def_parse_config,
 				   &def_print_module,
 				   &write_config_mkhomedir,
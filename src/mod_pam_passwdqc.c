@@ -56,14 +56,15 @@ PRINT_ARGS("passwdqc")
 PRINT_XMLHELP("passwdqc")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_5(is_enabled, ask_oldauthtok, check_oldauthtok, use_first_pass, use_authtok);
-DECLARE_STRING_OPTS_8(min, max, passphrase, match, similar, random, enforce, retry);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "ask_oldauthtok", "check_oldauthtok", "use_first_pass", "use_authtok");
+DECLARE_STRING_OPTS ("min", "max", "passphrase", "match", "similar", "random", "enforce", "retry");
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (PASSWORD), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_passwdqc = { "pam_passwdqc.so", opt_sets, helptext,
+pam_module_t mod_pam_passwdqc = { "pam_passwdqc.so", &schema,
 				  &def_parse_config,
 				  &def_print_module,
 				  &write_config_passwdqc,
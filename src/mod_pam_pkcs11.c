@@ -53,14 +53,15 @@ PRINT_ARGS("pkcs11")
 PRINT_XMLHELP("pkcs11")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_2 (is_enabled, debug);
-DECLARE_STRING_OPTS_1 (configfile);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug");
+DECLARE_STRING_OPTS ("configfile");
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (AUTH), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_pkcs11 = { "pam_pkcs11.so", opt_sets, helptext,
+pam_module_t mod_pam_pkcs11 = { "pam_pkcs11.so", &schema,
 				&def_parse_config,
 				&def_print_module,
 				&write_config_pkcs11,
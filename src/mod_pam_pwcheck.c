@@ -144,11 +144,10 @@ PRINT_ARGS("pwcheck");
 PRINT_XMLHELP("pwcheck");
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_6(is_enabled, debug, nullok, cracklib, no_obscure_checks, enforce_for_root);
-DECLARE_STRING_OPTS_5(cracklib_path, maxlen, minlen, tries, remember);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug", "nullok", "cracklib", "no_obscure_checks", "enforce_for_root");
+DECLARE_STRING_OPTS ("cracklib_path", "maxlen", "minlen", "tries", "remember");
 
-module_helptext_t pwcheck_help[] = {{"", NULL, "Enable/Disable pam_pwcheck.so module in password section."},
+static const module_helptext_t pwcheck_help[] = {{"", NULL, "Enable/Disable pam_pwcheck.so module in password section."},
 				    {"debug", NULL, "Add <option>debug</option> option to all pam_pwcheck.so invocations."},
 				    {"nullok", NULL, "Add <option>nullok</option> option to all pam_pwcheck.so invocations."},
 				    {"cracklib", NULL, "Add <option>cracklib</option> option to pam_pwcheck.so."},
@@ -162,8 +161,10 @@ module_helptext_t pwcheck_help[] = {{"", NULL, "Enable/Disable pam_pwcheck.so mo
 				    {NULL, NULL, NULL}};
 
 
+DECLARE_SCHEMA (TYPE_MASK (PASSWORD), pwcheck_help);
+
 /* at last construct the complete module object */
-pam_module_t mod_pam_pwcheck = { "pam_pwcheck.so", opt_sets, pwcheck_help,
+pam_module_t mod_pam_pwcheck = { "pam_pwcheck.so", &schema,
 				 &parse_config_pwcheck,
 				 &def_print_module,
 				 &write_config_pwcheck,
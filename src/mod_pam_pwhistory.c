@@ -56,14 +56,15 @@ PRINT_ARGS("pwhistory")
 PRINT_XMLHELP("pwhistory")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_4(is_enabled, debug, use_authtok, enforce_for_root);
-DECLARE_STRING_OPTS_3(remember, retry, authtok_type);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug", "use_authtok", "enforce_for_root");
+DECLARE_STRING_OPTS ("remember", "retry", "authtok_type");
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (PASSWORD), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_pwhistory = { "pam_pwhistory.so", opt_sets, helptext,
+pam_module_t mod_pam_pwhistory = { "pam_pwhistory.so", &schema,
 				  &def_parse_config,
 				  &def_print_module,
 				  &write_config_pwhistory,
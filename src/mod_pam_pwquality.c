@@ -56,14 +56,15 @@ PRINT_ARGS("pwquality")
 PRINT_XMLHELP("pwquality")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_7(is_enabled, debug, reject_username, gecoscheck, enforce_for_root, local_users_only, use_authtok);
-DECLARE_STRING_OPTS_17(authtok_type, retry, difok, minlen, dcredit, ucredit, lcredit, ocredit, minclass, dictpath, maxrepeat, maxsequence, maxclassrepeat, dictcheck, usercheck, enforcing, badwords);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug", "reject_username", "gecoscheck", "enforce_for_root", "local_users_only", "use_authtok");
+DECLARE_STRING_OPTS ("authtok_type", "retry", "difok", "minlen", "dcredit", "ucredit", "lcredit", "ocredit", "minclass", "dictpath", "maxrepeat", "maxsequence", "maxclassrepeat", "dictcheck", "usercheck", "enforcing", "badwords");
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (PASSWORD), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_pwquality = { "pam_pwquality.so", opt_sets, helptext,
+pam_module_t mod_pam_pwquality = { "pam_pwquality.so", &schema,
 				  &def_parse_config,
 				  &def_print_module,
 				  &write_config_pwquality,
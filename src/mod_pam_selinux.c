@@ -26,12 +26,16 @@
 #include "pam-module.h"
 
 
+/* pam_selinux has two lines in the session stack, "close" before
+   all other modules and "open" after them. module_list_session has
+   mod_pam_selinux for the first one and mod_pam_selinux_open, which
+   shares the options, for the second one.  */
 static int
-write_config_selinux (pam_module_t * this, enum write_type op, FILE * fp)
+write_selinux_line (pam_module_t *this, enum write_type op, FILE *fp,
+		    const char *action)
 {
   option_set_t *opt_set = this->get_opt_set (this, op);
-  static int called = 0;
-  
+
   if (debug)
     debug_write_call (this, op);
 
@@ -41,21 +45,25 @@ write_config_selinux (pam_module_t * this, enum write_type op, FILE * fp)
   if (op != SESSION)
     return 0;
 
-  if(called == 0)
-  {
-	  fprintf (fp, "session\trequired\tpam_selinux.so\tclose ");
-  }
-  else if(called == 1)
-  {
-	  fprintf (fp, "session\trequired\tpam_selinux.so\topen ");
-  }
-  called++;
-  
+  fprintf (fp, "session\trequired\tpam_selinux.so\t%s ", action);
+
   WRITE_CONFIG_OPTIONS
 
   return 0;
 }
 
+static int
+write_config_selinux (pam_module_t *this, enum write_type op, FILE *fp)
+{
+  return write_selinux_line (this, op, fp, "close");
+}
+
+static int
+write_config_selinux_open (pam_module_t *this, enum write_type op, FILE *fp)
+{
+  return write_selinux_line (this, op, fp, "open");
+}
+
 GETOPT_START_1(SESSION)
 GETOPT_END_1(SESSION)
 
@@ -63,9 +71,8 @@ PRINT_ARGS("selinux")
 PRINT_XMLHELP("selinux")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_2 (is_enabled, debug);
-DECLARE_STRING_OPTS_0;
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug");
+DECLARE_NO_STRING_OPTS;
 
 static int
 selinux_parse_config (pam_module_t *this, char *args, write_type_t type)
@@ -110,10 +117,12 @@ selinux_parse_config (pam_module_t *this, char *args, write_type_t type)
 }
 
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (SESSION), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_selinux = { "pam_selinux.so", opt_sets, helptext,
+pam_module_t mod_pam_selinux = { "pam_selinux.so", &schema,
 				  &selinux_parse_config,
 				  &def_print_module,
 				  &write_config_selinux,
@@ -121,3 +130,20 @@ pam_module_t mod_pam_selinux = { "pam_selinux.so", opt_sets, helptext,
 				  &getopt,
 				  &print_args,
 				  &print_xmlhelp};
+
+static option_set_t *
+get_opt_set_open (pam_module_t *this __attribute__ ((unused)),
+		  write_type_t op)
+{
+  return mod_pam_selinux.get_opt_set (&mod_pam_selinux, op);
+}
+
+/* Only for writing the "open" line, see write_selinux_line().  */
+pam_module_t mod_pam_selinux_open = { "pam_selinux.so", &schema,
+				       &selinux_parse_config,
+				       &def_print_module,
+				       &write_config_selinux_open,
+				       &get_opt_set_open,
+				       &getopt,
+				       &print_args,
+				       &print_xmlhelp};
@@ -41,7 +41,7 @@ write_config_ssh (pam_module_t *this, enum write_type op, FILE *fp)
     case ACCOUNT:
     case PASSWORD:
       /*** null functions only ***/
-      break;
+      return 0;
 
     case AUTH:
       fprintf (fp, "auth\tsufficient\tpam_ssh.so\ttry_first_pass ");
@@ -79,14 +79,15 @@ PRINT_ARGS("ssh")
 PRINT_XMLHELP("ssh")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_3 (is_enabled, debug, nullok);
-DECLARE_STRING_OPTS_1 (keyfiles);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug", "nullok");
+DECLARE_STRING_OPTS ("keyfiles");
+
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+DECLARE_SCHEMA (TYPE_MASK (AUTH) | TYPE_MASK (SESSION), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_ssh = { "pam_ssh.so", opt_sets, helptext,
+pam_module_t mod_pam_ssh = { "pam_ssh.so", &schema,
 			     &def_parse_config,
 			     &def_print_module,
 			     &write_config_ssh,
@@ -58,9 +58,9 @@ write_config_sss (pam_module_t * this, enum write_type op, FILE * fp)
       break;
     case PASSWORD:
       if (with_ldap)
-        fprintf (fp, "password\tsufficient\tpam_sss.so\tuse_authtok");
+        fprintf (fp, "password\tsufficient\tpam_sss.so\tuse_authtok ");
       else
-	fprintf (fp, "password\trequired\tpam_sss.so\tuse_authtok");
+	fprintf (fp, "password\trequired\tpam_sss.so\tuse_authtok ");
       break;
     case SESSION:
       fprintf (fp, "session\toptional\tpam_sss.so\t");
@@ -79,14 +79,15 @@ PRINT_ARGS("sss")
 PRINT_XMLHELP("sss")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_2 (is_enabled, debug);
-DECLARE_STRING_OPTS_0;
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug");
+DECLARE_NO_STRING_OPTS;
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (ALL_TYPES, helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_sss = { "pam_sss.so", opt_sets, helptext,
+pam_module_t mod_pam_sss = { "pam_sss.so", &schema,
 				 &def_parse_config,
 				 &def_print_module,
 				 &write_config_sss,
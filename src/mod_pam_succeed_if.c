@@ -48,12 +48,13 @@ write_config_succeed_if (pam_module_t *this, enum write_type op,
 }
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_1 (is_enabled);
-DECLARE_STRING_OPTS_0;
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled");
+DECLARE_NO_STRING_OPTS;
+DECLARE_SCHEMA (ALL_TYPES, NULL);
+
 /* at last construct the complete module object */
 pam_module_t mod_pam_succeed_if = {"pam_succeed_if.so",
-				   opt_sets, NULL,
+				   &schema,
 				   &parse_config_succeed_if,
 				   &def_print_module,
 				   &write_config_succeed_if,
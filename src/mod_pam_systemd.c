@@ -79,8 +79,8 @@ parse_config_systemd (pam_module_t *this, char *args, write_type_t type)
 
       if (strcmp (cp, "debug") == 0)
 	   opt_set->enable (opt_set, "debug", TRUE);
-      else if (strncmp (cp, "kill-session-processes=", 13) == 0)
-	   opt_set->set_opt (opt_set, "kill_session_processes", strdup(&cp[13]));
+      else if (strncmp (cp, "kill-session-processes=", 23) == 0)
+	   opt_set->set_opt (opt_set, "kill_session_processes", strdup (&cp[23]));
       else if (strncmp (cp, "kill-only-users=", 16) == 0)
   	   opt_set->set_opt (opt_set, "kill_only_users", strdup (&cp[16]));
       else if (strncmp (cp, "kill-exclude-users=", 19) == 0)
@@ -102,15 +102,16 @@ PRINT_ARGS("systemd")
 PRINT_XMLHELP("systemd")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_2 (is_enabled, debug);
-DECLARE_STRING_OPTS_5 (kill_session_processes, kill_only_users, kill_exclude_users, controllers, reset_controllers);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug");
+DECLARE_STRING_OPTS ("kill_session_processes", "kill_only_users", "kill_exclude_users", "controllers", "reset_controllers");
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
 
 
+DECLARE_SCHEMA (TYPE_MASK (SESSION), helptext);
+
 /* at last construct the complete module object */
-pam_module_t mod_pam_systemd = { "pam_systemd.so", opt_sets, helptext,
+pam_module_t mod_pam_systemd = { "pam_systemd.so", &schema,
 				     &parse_config_systemd,
 				     &def_print_module,
 				     &write_config_systemd,
@@ -53,14 +53,15 @@ PRINT_ARGS("time")
 PRINT_XMLHELP("time")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_1 (is_enabled);
-DECLARE_STRING_OPTS_0;
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled");
+DECLARE_NO_STRING_OPTS;
 
-static module_helptext_t helptext[] = {{"", NULL, NULL}};
+static const module_helptext_t helptext[] = {{"", NULL, NULL}};
+
+DECLARE_SCHEMA (TYPE_MASK (ACCOUNT), helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_time = { "pam_time.so", opt_sets, helptext,
+pam_module_t mod_pam_time = { "pam_time.so", &schema,
 			      &def_parse_config,
 			      &def_print_module,
 			      &write_config_time,
@@ -53,11 +53,10 @@ PRINT_ARGS("umask")
 PRINT_XMLHELP("umask")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_4 (is_enabled, debug, silent, usergroups);
-DECLARE_STRING_OPTS_1 (umask);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug", "silent", "usergroups");
+DECLARE_STRING_OPTS ("umask");
 
-module_helptext_t umask_help[] = {{"", NULL, "Add pam_umask.so as optional session module."},
+static const module_helptext_t umask_help[] = {{"", NULL, "Add pam_umask.so as optional session module."},
 				  {"debug", NULL, "Add <option>debug</option> option to all pam_umask.so invocations in session management."},
 				  {"silent", NULL, "Add <option>silent</option> option to all pam_umask.so invocations in session management."},
 				  {"usergroups", NULL, "Add <option>usergroups</option> option to all pam_umask.so invocations in session management."},
@@ -65,8 +64,10 @@ module_helptext_t umask_help[] = {{"", NULL, "Add pam_umask.so as optional sessi
 				  {NULL, NULL, NULL}};
 
 
+DECLARE_SCHEMA (TYPE_MASK (SESSION), umask_help);
+
 /* at last construct the complete module object */
-pam_module_t mod_pam_umask = { "pam_umask.so", opt_sets, umask_help,
+pam_module_t mod_pam_umask = { "pam_umask.so", &schema,
 			       &def_parse_config,
 			       &def_print_module,
 			       &write_config_umask,
@@ -104,14 +104,15 @@ PRINT_ARGS("unix")
 PRINT_XMLHELP("unix")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_15(is_enabled, debug, audit, nodelay, nullok, shadow, md5, bigcrypt, sha256, sha512, blowfish, nis, broken_shadow, use_first_pass, try_first_pass);
-DECLARE_STRING_OPTS_4(authtok_type, remember, rounds, minlen);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug", "audit", "nodelay", "nullok", "shadow", "md5", "bigcrypt", "sha256", "sha512", "blowfish", "nis", "broken_shadow", "use_first_pass", "try_first_pass");
+DECLARE_STRING_OPTS ("authtok_type", "remember", "rounds", "minlen");
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (ALL_TYPES, helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_unix = { "pam_unix.so", opt_sets, helptext,
+pam_module_t mod_pam_unix = { "pam_unix.so", &schema,
 			      &def_parse_config,
 			      &def_print_module,
 			      &write_config_unix,
@@ -100,11 +100,10 @@ PRINT_ARGS("unix2");
 PRINT_XMLHELP("unix2");
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_5( is_enabled, nullok, debug, trace, none );
-DECLARE_STRING_OPTS_2( call_modules, nisdir);
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "nullok", "debug", "trace", "none");
+DECLARE_STRING_OPTS ("call_modules", "nisdir");
 
-module_helptext_t unix2_help[] = {{"", NULL, "Use pam_unix2.so as standard UNIX PAM module."},
+static const module_helptext_t unix2_help[] = {{"", NULL, "Use pam_unix2.so as standard UNIX PAM module."},
 				  {"nullok", NULL, "Add <option>nullok</option> option to all pam_unix2.so invocations."},
 				  {"debug", NULL, "Add <option>debug</option> option to all pam_unix2.so invocations."},
 				  {"trace", NULL, "Add <option>trace</option> option to pam_unix2.so."},
@@ -114,8 +113,10 @@ module_helptext_t unix2_help[] = {{"", NULL, "Use pam_unix2.so as standard UNIX
 				  {NULL, NULL, NULL}};
 
 
+DECLARE_SCHEMA (ALL_TYPES, unix2_help);
+
 /* at last construct the complete module object */
-pam_module_t mod_pam_unix2 = { "pam_unix2.so", opt_sets, unix2_help,
+pam_module_t mod_pam_unix2 = { "pam_unix2.so", &schema,
 			       &def_parse_config,
 			       &def_print_module,
 			       &write_config_unix2,
@@ -64,14 +64,15 @@ PRINT_ARGS("winbind")
 PRINT_XMLHELP("winbind")
 
 /* ---- contruct module object ---- */
-DECLARE_BOOL_OPTS_2 (is_enabled, debug);
-DECLARE_STRING_OPTS_0;
-DECLARE_OPT_SETS;
+DECLARE_BOOL_OPTS ("is_enabled", "debug");
+DECLARE_NO_STRING_OPTS;
 
-static module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+static const module_helptext_t helptext[] = {{NULL, NULL, NULL}};
+
+DECLARE_SCHEMA (ALL_TYPES, helptext);
 
 /* at last construct the complete module object */
-pam_module_t mod_pam_winbind = { "pam_winbind.so", opt_sets, helptext,
+pam_module_t mod_pam_winbind = { "pam_winbind.so", &schema,
 				 &def_parse_config,
 				 &def_print_module,
 				 &write_config_winbind,
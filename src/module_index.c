@@ -0,0 +1,689 @@
+/* Copyright (C) 2020 Thorsten Kukuk
+   Author: Thorsten Kukuk <kukuk@thkukuk.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <ctype.h>
+#include <stdio.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "pam-config.h"
+
+/* Reverse index "PAM module -> lines of service files using it".
+   It is built with one scan of pam.d the first time somebody asks
+   for it and thrown away if pam-config rewrites a service file.
+
+   If a cache directory is configured, the index is additionally
+   stored in cachedir/module-index. The next run maps this file
+   read-only and takes the lines of every service file from it
+   whose stat data did not change, only modified files are parsed
+   again. The file is rewritten if anything was stale.
+
+   Only module lines are indexed. Include and substack lines are
+   no module usage, --effective-stack follows them itself. Whether
+   a module is installed and the state of the common-*-pc files and
+   their symlinks are not part of the index either: -q and --verify
+   read them directly, which costs a few access calls and four small
+   files, and the index would have to watch the module directories
+   to stay valid.
+
+   Format (see cache_file.c):
+     magic, string pam.d directory
+     per service file, sorted like alphasort:
+       string name, CACHE_STAT_KEY_LEN times uint64 stat data,
+       per line: uint32 lineno, string module, string line,
+       uint32 0 as end marker.  */
+
+#define MODULE_INDEX_SIZE 127
+
+#define INDEX_CACHE_FILE "module-index"
+#define INDEX_CACHE_MAGIC "PCMIDX01"
+
+struct module_index_entry {
+  char *module;
+  module_usage_t *first;
+  module_usage_t *last;
+  struct module_index_entry *next;
+};
+
+/* Lines of a service file in file order, needed to write the
+   cache.  */
+struct indexed_line {
+  const struct module_index_entry *entry;
+  const module_usage_t *usage;
+};
+
+struct indexed_service {
+  char *name;
+  uint64_t key[CACHE_STAT_KEY_LEN];
+  struct indexed_line *lines;
+  size_t nlines;
+};
+
+/* Per thread, it belongs to the confdir of the running call.  */
+static __thread struct module_index_entry *module_index[MODULE_INDEX_SIZE];
+static __thread struct indexed_service *indexed_services;
+static __thread size_t n_indexed_services;
+static __thread int module_index_valid = FALSE;
+
+/* Split a line of a PAM config file into its fields. Comments and
+   the trailing newline are removed in place. Returns 0 for empty
+   lines, 1 if the line could be split and -1 for broken lines.  */
+int
+split_config_line (char *line, char **type, char **control,
+		   char **module, char **arguments)
+{
+  char *cp = line, *tmp;
+
+  *type = *control = *module = *arguments = NULL;
+
+  tmp = strchr (cp, '#');  /* remove comments */
+  if (tmp)
+    *tmp = '\0';
+  tmp = strchr (cp, '\n');
+  if (tmp)
+    *tmp = '\0';
+  while (isspace ((int)*cp))
+    ++cp;
+  if (*cp == '\0')
+    return 0;
+
+  *type = strsep (&cp, " \t");
+  if (cp)
+    while (isspace ((int)*cp))
+      ++cp;
+  if (cp == NULL || *cp == '\0')
+    return -1;
+
+  /* "@include file" has no control field.  */
+  if ((*type)[0] == '@')
+    {
+      *module = strsep (&cp, " \t");
+      return 1;
+    }
+
+  if (*cp == '[')
+    {
+      *control = cp;
+      cp = strchr (cp, ']');
+      if (cp == NULL)
+	return -1;
+      cp++;
+      if (*cp == '\0')
+	return -1;
+      *cp++ = '\0';
+    }
+  else
+    *control = strsep (&cp, " \t");
+  if (cp)
+    while (isspace ((int)*cp))
+      ++cp;
+  if (cp == NULL || *cp == '\0')
+    return -1;
+
+  *module = strsep (&cp, " \t");
+  if (cp)
+    {
+      while (isspace ((int)*cp))
+	++cp;
+      if (*cp != '\0')
+	{
+	  *arguments = cp;
+	  tmp = cp + strlen (cp);
+	  while (isspace ((int)tmp[-1]))
+	    *--tmp = '\0';
+	}
+    }
+
+  return 1;
+}
+
+static unsigned int
+hash_module_name (const char *name)
+{
+  unsigned int hash = 5381;
+
+  while (*name)
+    hash = hash * 33 + tolower ((unsigned char)*name++);
+
+  return hash % MODULE_INDEX_SIZE;
+}
+
+static struct module_index_entry *
+find_index_entry (const char *module, int create)
+{
+  unsigned int hash = hash_module_name (module);
+  struct module_index_entry *entry;
+
+  for (entry = module_index[hash]; entry != NULL; entry = entry->next)
+    if (strcasecmp (entry->module, module) == 0)
+      return entry;
+
+  if (!create)
+    return NULL;
+
+  entry = calloc (1, sizeof (struct module_index_entry));
+  if (entry == NULL || (entry->module = strdup (module)) == NULL)
+    {
+      free (entry);
+      return NULL;
+    }
+  entry->next = module_index[hash];
+  module_index[hash] = entry;
+
+  return entry;
+}
+
+static int
+add_module_usage (const char *module, struct indexed_service *is,
+		  unsigned int lineno, const char *line)
+{
+  struct module_index_entry *entry = find_index_entry (module, TRUE);
+  struct indexed_line *lines;
+  module_usage_t *usage;
+
+  if (entry == NULL)
+    return -1;
+
+  lines = realloc (is->lines, (is->nlines + 1) * sizeof (struct indexed_line));
+  if (lines == NULL)
+    return -1;
+  is->lines = lines;
+
+  usage = calloc (1, sizeof (module_usage_t));
+  if (usage == NULL)
+    return -1;
+
+  usage->service = strdup (is->name);
+  usage->line = strdup (line);
+  usage->lineno = lineno;
+  if (usage->service == NULL || usage->line == NULL)
+    {
+      free (usage->service);
+      free (usage->line);
+      free (usage);
+      return -1;
+    }
+
+  if (entry->last)
+    entry->last->next = usage;
+  else
+    entry->first = usage;
+  entry->last = usage;
+
+  is->lines[is->nlines].entry = entry;
+  is->lines[is->nlines].usage = usage;
+  is->nlines++;
+
+  return 0;
+}
+
+/* Read the head of the record of a service file.  */
+static int
+read_cached_service (cache_reader_t *r, const char **name,
+		     uint64_t key[CACHE_STAT_KEY_LEN])
+{
+  if (read_cache_string (r, name) != 0)
+    return -1;
+  return read_cache_bytes (r, key, CACHE_STAT_KEY_LEN * sizeof (uint64_t));
+}
+
+/* Read the lines of a service record. If is is NULL, they are only
+   skipped.  */
+static int
+read_cached_lines (cache_reader_t *r, struct indexed_service *is)
+{
+  while (1)
+    {
+      const char *module, *line;
+      uint32_t lineno;
+
+      if (read_cache_u32 (r, &lineno) != 0)
+	return -1;
+      if (lineno == 0)
+	return 0;
+      if (read_cache_string (r, &module) != 0 ||
+	  read_cache_string (r, &line) != 0)
+	return -1;
+      if (is && add_module_usage (module, is, lineno, line) != 0)
+	return -1;
+    }
+}
+
+/* Map the cache file and check the whole file once, so that
+   nothing needs to be undone if a broken record is found later.
+   Returns FALSE if there is no usable cache for conf_dname.  */
+static int
+map_index_cache (const char *conf_dname, cache_map_t *cm)
+{
+  cache_reader_t check;
+  const char *dname;
+
+  if (!map_cache_file (INDEX_CACHE_FILE, INDEX_CACHE_MAGIC, cm))
+    return FALSE;
+
+  if (read_cache_string (&cm->r, &dname) != 0 ||
+      strcmp (dname, conf_dname) != 0)
+    goto invalid;
+
+  check = cm->r;
+  while (check.pos < check.end)
+    {
+      uint64_t key[CACHE_STAT_KEY_LEN];
+      const char *name;
+
+      if (read_cached_service (&check, &name, key) != 0 ||
+	  read_cached_lines (&check, NULL) != 0)
+	goto invalid;
+    }
+
+  return TRUE;
+
+ invalid:
+  if (debug)
+    printf ("*** map_index_cache: ignoring invalid cache in %s\n", cachedir);
+  unmap_cache_file (cm);
+  return FALSE;
+}
+
+static int
+write_cached_service (FILE *fp, const struct indexed_service *is)
+{
+  size_t i;
+
+  if (write_cache_string (fp, is->name) != 0 ||
+      write_cache_bytes (fp, is->key, sizeof (is->key)) != 0)
+    return -1;
+
+  for (i = 0; i < is->nlines; i++)
+    if (write_cache_u32 (fp, is->lines[i].usage->lineno) != 0 ||
+	write_cache_string (fp, is->lines[i].entry->module) != 0 ||
+	write_cache_string (fp, is->lines[i].usage->line) != 0)
+      return -1;
+
+  return write_cache_u32 (fp, 0);
+}
+
+/* Replace the cache file. Failing is not an error, the next run
+   will only be slower.  */
+static void
+write_index_cache (const char *conf_dname)
+{
+  FILE *fp = create_cache_file (INDEX_CACHE_FILE, INDEX_CACHE_MAGIC);
+  size_t i;
+  int retval;
+
+  if (fp == NULL)
+    return;
+
+  retval = write_cache_string (fp, conf_dname);
+  for (i = 0; retval == 0 && i < n_indexed_services; i++)
+    retval = write_cached_service (fp, &indexed_services[i]);
+
+  close_cache_file (fp, INDEX_CACHE_FILE, retval == 0);
+}
+
+static struct indexed_service *
+add_indexed_service (const char *service, const struct stat *st)
+{
+  struct indexed_service *services, *is;
+
+  services = realloc (indexed_services, (n_indexed_services + 1) *
+		      sizeof (struct indexed_service));
+  if (services == NULL)
+    return NULL;
+  indexed_services = services;
+
+  is = &indexed_services[n_indexed_services];
+  memset (is, 0, sizeof (struct indexed_service));
+  if ((is->name = strdup (service)) == NULL)
+    return NULL;
+  cache_stat_key (st, is->key);
+  n_indexed_services++;
+
+  return is;
+}
+
+int
+service_filter (const struct dirent *dentry)
+{
+  /* skip '.' and '..' */
+  if (dentry->d_name[0] == '.') return 0;
+  /* skip files starting with 'common' */
+  if (strncmp (dentry->d_name, "common",6) == 0) return 0;
+  /* skip all files containing dots (catches .old, .tmp, etc.)*/
+  if (strstr (dentry->d_name, ".") != NULL) return 0;
+  return 1;
+}
+
+static int
+index_service_file (const char *file, struct indexed_service *is)
+{
+  char *buf = NULL, *copy = NULL;
+  size_t buflen = 0, copylen = 0;
+  unsigned int lineno = 0;
+  FILE *fp;
+  int retval = 0;
+
+  fp = vfs->open_read (file);
+  if (fp == NULL)
+    return 0;
+
+  while (retval == 0)
+    {
+      char *type, *control, *module, *arguments, *cp;
+      ssize_t n = getline (&buf, &buflen, fp);
+
+      if (n < 1)
+	break;
+      lineno++;
+
+      if (buf[n - 1] == '\n')
+	buf[--n] = '\0';
+
+      if ((size_t) n + 1 > copylen)
+	{
+	  copylen = n + 1;
+	  free (copy);
+	  if ((copy = malloc (copylen)) == NULL)
+	    {
+	      retval = -1;
+	      break;
+	    }
+	}
+      memcpy (copy, buf, n + 1);
+
+      if (split_config_line (copy, &type, &control, &module, &arguments) != 1)
+	continue;
+
+      /* Includes are no module usage.  */
+      if (type[0] == '@' || control == NULL ||
+	  strcasecmp (control, "include") == 0 ||
+	  strcasecmp (control, "substack") == 0)
+	continue;
+
+      cp = strrchr (module, '/');
+      if (cp)
+	module = cp + 1;
+
+      cp = buf;
+      while (isspace ((int)*cp))
+	++cp;
+
+      retval = add_module_usage (module, is, lineno, cp);
+    }
+
+  fclose (fp);
+  free (buf);
+  free (copy);
+
+  return retval;
+}
+
+/* Add a service file to the index, either from the cache if it
+   did not change or by parsing it. *stale is set if the cache
+   needs to be rewritten.  */
+static int
+index_service (const char *conf_dname, const char *service,
+	       cache_reader_t *r, int *stale)
+{
+  uint64_t key[CACHE_STAT_KEY_LEN];
+  struct indexed_service *is;
+  struct stat st;
+  char *file;
+  int retval;
+
+  if (asprintf (&file, "%s/%s", conf_dname, service) < 0)
+    return -1;
+
+  if (vfs->stat (file, &st) != 0)
+    {
+      free (file);
+      return 0;
+    }
+
+  if ((is = add_indexed_service (service, &st)) == NULL)
+    {
+      free (file);
+      return -1;
+    }
+
+  /* Records are sorted like the scandir result, skip the ones of
+     removed service files.  */
+  while (r && r->pos < r->end)
+    {
+      cache_reader_t record = *r;
+      const char *name;
+      int cmp;
+
+      read_cached_service (&record, &name, key);
+      cmp = strcmp (name, service);
+      if (cmp > 0)
+	break;
+
+      *r = record;
+      if (cmp == 0 && memcmp (key, is->key, sizeof (key)) == 0)
+	{
+	  free (file);
+	  return read_cached_lines (r, is);
+	}
+      read_cached_lines (r, NULL);
+      if (cmp == 0)
+	break;
+      *stale = TRUE;
+    }
+
+  *stale = TRUE;
+  retval = index_service_file (file, is);
+  free (file);
+
+  return retval;
+}
+
+static int
+build_module_index (void)
+{
+  struct dirent **namelist;
+  cache_reader_t *r = NULL;
+  cache_map_t cache;
+  char *conf_dname;
+  int n, i, retval = 0, stale = FALSE;
+
+  if (module_index_valid)
+    return 0;
+
+  if (asprintf (&conf_dname, "%s/pam.d", confdir ? confdir : CONFDIR) < 0)
+    {
+      fprintf (stderr, _("ERROR: No memory left to construct path.\n"));
+      return -1;
+    }
+
+  if (debug)
+    printf ("*** build_module_index (%s)\n", conf_dname);
+
+  if (map_index_cache (conf_dname, &cache))
+    r = &cache.r;
+  else
+    stale = TRUE;
+
+  n = vfs->scandir (conf_dname, &namelist, &service_filter);
+  if (n < 0)
+    fprintf (stderr, _("WARNING: Found no service files in '%s'.\n"),
+	     conf_dname);
+  else
+    {
+      for (i = 0; i < n; i++)
+	{
+	  if (retval == 0 &&
+	      index_service (conf_dname, namelist[i]->d_name, r, &stale) != 0)
+	    {
+	      fprintf (stderr, _("ERROR: No memory left to index service files.\n"));
+	      retval = -1;
+	    }
+	  free (namelist[i]);
+	}
+      free (namelist);
+    }
+
+  /* Records of removed service files at the end.  */
+  if (r && r->pos < r->end)
+    stale = TRUE;
+  if (r)
+    unmap_cache_file (&cache);
+
+  if (retval != 0)
+    {
+      free (conf_dname);
+      free_module_index ();
+      return retval;
+    }
+
+  if (stale && n >= 0)
+    write_index_cache (conf_dname);
+  free (conf_dname);
+
+  module_index_valid = TRUE;
+  return 0;
+}
+
+void
+free_module_index (void)
+{
+  size_t j;
+  int i;
+
+  for (i = 0; i < MODULE_INDEX_SIZE; i++)
+    {
+      struct module_index_entry *entry = module_index[i];
+
+      while (entry != NULL)
+	{
+	  struct module_index_entry *next_entry = entry->next;
+	  module_usage_t *usage = entry->first;
+
+	  while (usage != NULL)
+	    {
+	      module_usage_t *next_usage = usage->next;
+
+	      free (usage->service);
+	      free (usage->line);
+	      free (usage);
+	      usage = next_usage;
+	    }
+	  free (entry->module);
+	  free (entry);
+	  entry = next_entry;
+	}
+      module_index[i] = NULL;
+    }
+
+  for (j = 0; j < n_indexed_services; j++)
+    {
+      free (indexed_services[j].name);
+      free (indexed_services[j].lines);
+    }
+  free (indexed_services);
+  indexed_services = NULL;
+  n_indexed_services = 0;
+
+  module_index_valid = FALSE;
+}
+
+/* Returns NULL if the module is not used or the index could not be
+   built.  */
+const module_usage_t *
+lookup_module_usage (const char *module)
+{
+  struct module_index_entry *entry;
+
+  if (build_module_index () != 0)
+    return NULL;
+
+  entry = find_index_entry (module, FALSE);
+
+  return entry ? entry->first : NULL;
+}
+
+int
+check_service_files_for_module (const char *module)
+{
+  const module_usage_t *usage;
+  const char *last_service = NULL;
+
+  if (build_module_index () != 0)
+    /* if we couldn't check assume the worst (module is enabled). */
+    return TRUE;
+
+  usage = lookup_module_usage (module);
+
+  if (debug){
+    DEBUG ("**** check_service_files_for_module ('%s'): %s\n", module,
+	   usage ? "found" : "not found");
+  }
+
+  for (; usage != NULL; usage = usage->next)
+    {
+      if (last_service && strcmp (last_service, usage->service) == 0)
+	continue;
+      fprintf (stderr, _("WARNING: Found module '%s' in file '%s'.\n"),
+	       module, usage->service);
+      last_service = usage->service;
+    }
+
+  return last_service != NULL;
+}
+
+int
+print_module_usage (const char *name)
+{
+  const module_usage_t *usage;
+  const char *prefix = "", *suffix = "";
+  char *module;
+
+  /* Accept "mount", "pam_mount" and "pam_mount.so".  */
+  if (strncmp (name, "pam_", 4) != 0)
+    prefix = "pam_";
+  if (strlen (name) < 3 || strcmp (&name[strlen (name) - 3], ".so") != 0)
+    suffix = ".so";
+
+  if (asprintf (&module, "%s%s%s", prefix, name, suffix) < 0)
+    {
+      fprintf (stderr, _("Out of memory\n"));
+      return 1;
+    }
+
+  if (build_module_index () != 0)
+    {
+      free (module);
+      return 1;
+    }
+
+  usage = lookup_module_usage (module);
+  free (module);
+
+  if (usage == NULL)
+    return 1;
+
+  for (; usage != NULL; usage = usage->next)
+    printf ("%s:%u: %s\n", usage->service, usage->lineno, usage->line);
+
+  return 0;
+}
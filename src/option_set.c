@@ -4,20 +4,124 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+struct opt_index_entry {
+  const char *key;        /* NULL for a free entry */
+  size_t pos;
+  int is_string;
+};
+
+struct opt_index {
+  size_t mask;
+  struct opt_index_entry entries[];
+};
+
+static size_t
+hash_key (const char *key)
+{
+  size_t hash = 5381;
+
+  while (*key)
+    hash = hash * 33 + (unsigned char) *key++;
+
+  return hash;
+}
+
+static void
+add_keys (opt_index_t *idx, const char *const *keys, int is_string)
+{
+  size_t i, slot;
+
+  for (i = 0; keys[i] != NULL; i++)
+    {
+      /* a duplicate name lands behind the first one, which wins,
+	 as it does for the scan */
+      slot = hash_key (keys[i]) & idx->mask;
+      while (idx->entries[slot].key != NULL)
+	slot = (slot + 1) & idx->mask;
+      idx->entries[slot].key = keys[i];
+      idx->entries[slot].pos = i;
+      idx->entries[slot].is_string = is_string;
+    }
+}
+
+opt_index_t *
+new_opt_index (const char *const *bool_keys, const char *const *string_keys)
+{
+  size_t count = count_opts (bool_keys) + count_opts (string_keys);
+  size_t size = 8;
+  opt_index_t *idx;
+
+  while (size < 2 * count)
+    size *= 2;
+
+  idx = calloc (1, sizeof (opt_index_t) +
+		size * sizeof (struct opt_index_entry));
+  if (idx == NULL)
+    return NULL;
+  idx->mask = size - 1;
+
+  add_keys (idx, bool_keys, FALSE);
+  add_keys (idx, string_keys, TRUE);
+
+  return idx;
+}
+
+/* Position of key in the boolean or string names of this.  */
+static int
+find_key (const option_set_t *this, const char *key, int is_string,
+	  size_t *pos)
+{
+  const struct opt_index_entry *entry;
+  size_t slot;
+
+  if (this->index == NULL)
+    {
+      const char *const *keys =
+	is_string ? this->string_keys : this->bool_keys;
+
+      for (*pos = 0; keys[*pos] != NULL; (*pos)++)
+	if (strcmp (keys[*pos], key) == 0)
+	  return TRUE;
+      return FALSE;
+    }
+
+  for (slot = hash_key (key) & this->index->mask;
+       (entry = &this->index->entries[slot])->key != NULL;
+       slot = (slot + 1) & this->index->mask)
+    if (entry->is_string == is_string && strcmp (entry->key, key) == 0)
+      {
+	*pos = entry->pos;
+	return TRUE;
+      }
+
+  return FALSE;
+}
+
+int *
+bool_opt (option_set_t *this, const char *key)
+{
+  size_t i;
+
+  return find_key (this, key, FALSE, &i) ? &this->bool_values[i] : NULL;
+}
+
+char **
+string_opt (option_set_t *this, const char *key)
+{
+  size_t i;
+
+  return find_key (this, key, TRUE, &i) ? &this->string_values[i] : NULL;
+}
+
 int
 is_enabled (option_set_t *this, char *key)
 {
   if (!this)
     return FALSE;
-  bool_option_t **current_opt = this->bool_opts;
-  while (NULL != *current_opt)
-    {
-      if (0 == strcmp ((*current_opt)->key, key))
-	{
-	  return (*current_opt)->value;
-	}
-      current_opt++;
-    }
+  size_t i;
+
+  if (find_key (this, key, FALSE, &i))
+    return this->bool_values[i];
   /* XXX for debugging */
   if (strcmp (key, "debug") != 0 && strcmp (key, "nullok") != 0)
     {
@@ -32,17 +136,12 @@ enable (option_set_t * this, char *key, int value)
 {
   if (!this)
     return FALSE;
-  bool_option_t **current_opt = this->bool_opts;
-  while (NULL != *current_opt)
-    {
-      if (0 == strcmp ((*current_opt)->key, key))
-	{
-	  (*current_opt)->value = value;
-	  return TRUE;
-	}
-      current_opt++;
-    }
-  return FALSE;
+  size_t i;
+
+  if (!find_key (this, key, FALSE, &i))
+    return FALSE;
+  this->bool_values[i] = value;
+  return TRUE;
 }
 
 // string opt functions
@@ -51,15 +150,10 @@ get_opt (option_set_t * this, char *key)
 {
   if (!this)
     return NULL;
-  string_option_t **current_opt = this->string_opts;
-  while (NULL != *current_opt)
-    {
-      if (0 == strcmp ((*current_opt)->key, key))
-	{
-	  return (*current_opt)->value;
-	}
-      current_opt++;
-    }
+  size_t i;
+
+  if (find_key (this, key, TRUE, &i))
+    return this->string_values[i];
   /* XXX for debugging */
   if (strcmp (key, "debug") != 0 && strcmp (key, "nullok") != 0)
     {
@@ -74,64 +168,44 @@ int
 set_opt (option_set_t * this, char *key, char *value)
 {
   if (!this)
-    return FALSE;
-  string_option_t **current_opt = this->string_opts;
-  while (NULL != *current_opt)
     {
-      if (0 == strcmp ((*current_opt)->key, key))
-	{
-	  (*current_opt)->value = value;
-	  return TRUE;
-	}
-      current_opt++;
+      free (value);
+      return FALSE;
     }
+  size_t i;
 
-  return FALSE;
+  if (!find_key (this, key, TRUE, &i))
+    {
+      free (value);
+      return FALSE;
+    }
+  /* the option set owns its values */
+  if (this->string_values[i] != value)
+    free (this->string_values[i]);
+  this->string_values[i] = value;
+  return TRUE;
 }
 
 void
-print_bool_opt (bool_option_t * opt)
+clear_opt_set (option_set_t *this)
 {
-  /* is_enabled is internal key.  */
-  if (strcmp (opt->key, "is_enabled") == 0)
-    return;
+  size_t i;
 
-  if (opt->value)
-    printf (" %s", opt->key);
-}
-
-void
-for_each_bool_opt (option_set_t * this, void (*action) (bool_option_t * opt))
-{
-  if (!this)
-    return;
-  bool_option_t **current_opt = this->bool_opts;
-  while (NULL != *current_opt)
+  for (i = 0; this->string_keys[i] != NULL; i++)
     {
-      action (*current_opt);
-      current_opt++;
+      free (this->string_values[i]);
+      this->string_values[i] = NULL;
     }
-  return;
+  memset (this->bool_values, 0, count_opts (this->bool_keys) * sizeof (int));
 }
 
-void
-print_string_opt (string_option_t * opt)
+size_t
+count_opts (const char *const *keys)
 {
-  if (opt->value)
-    printf (" %s=%s", opt->key, opt->value);
-}
+  size_t n = 0;
 
-void
-for_each_string_opt (option_set_t * this,
-		     void (*action) (string_option_t * opt))
-{
-  if (!this)
-    return;
-  string_option_t **current_opt = this->string_opts;
-  while (NULL != *current_opt)
-    {
-      action (*current_opt);
-      current_opt++;
-    }
-  return;
+  while (keys[n] != NULL)
+    n++;
+
+  return n;
 }
@@ -5,22 +5,31 @@
 #include <config.h>
 #endif
 
+#include <stddef.h>
+
 #define FALSE 0
 #define TRUE 1
 
-typedef struct {
-  char *key;
-  int value;
-} bool_option_t;
+/* An option set holds the options of a module for one PAM type.
+   The names of the options are the schema of the module, a NULL
+   terminated, constant array shared by the four option sets of the
+   module. The values live in separate arrays with one entry per
+   name, so the state of a module can be copied without knowing the
+   schema. set_opt() takes over the value, it has to be allocated
+   with malloc() and is freed when it is replaced or if the key is
+   unknown.
 
-typedef struct {
-  char *key;
-  char *value;
-} string_option_t;
+   The index, built once per schema with the module registry, maps a
+   name to its position with one hash probe instead of a strcmp()
+   with every name. Without index the names are scanned.  */
+typedef struct opt_index opt_index_t;
 
 typedef struct option_set {
-  bool_option_t **bool_opts;
-  string_option_t **string_opts;
+  const char *const *bool_keys;
+  const char *const *string_keys;
+  const opt_index_t *index;
+  int *bool_values;
+  char **string_values;
   // bool opt functions
   int (*is_enabled)( struct option_set *this,  char *key );
   int (*enable)( struct option_set *this, char *key, int value );
@@ -29,12 +38,19 @@ typedef struct option_set {
   int (*set_opt) ( struct option_set *this, char *key, char *value );
 } option_set_t;
 
+/* Number of names in a NULL terminated schema array.  */
+#define OPT_COUNT(keys) (sizeof (keys) / sizeof ((keys)[0]) - 1)
+
 int is_enabled ( option_set_t *this, char *key );
 int enable ( option_set_t *this, char *key, int value );
 char* get_opt ( struct option_set *this, char *key );
 int set_opt ( struct option_set *this, char *key, char *value );
-void for_each_bool_opt( struct option_set *this, void (*action) (bool_option_t *opt ) );
-void print_bool_opt( bool_option_t *opt );
-void for_each_string_opt( struct option_set *this, void (*action) (string_option_t *opt ) );
-void print_string_opt( string_option_t *opt );
+void clear_opt_set ( option_set_t *this );
+/* The value of key, NULL if it is unknown. Unlike is_enabled() and
+   get_opt(), these never abort.  */
+int *bool_opt ( option_set_t *this, const char *key );
+char **string_opt ( option_set_t *this, const char *key );
+size_t count_opts ( const char *const *keys );
+opt_index_t *new_opt_index ( const char *const *bool_keys,
+			     const char *const *string_keys );
 #endif
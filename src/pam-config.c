@@ -28,10 +28,21 @@
 
 #include <pam-config.h>
 
-#include "supported-modules.h"
-
-int debug = 0;
-char *confdir = NULL;
+/* The module lists are part of libpamconfig, these modules are
+   set directly by the options below.  */
+extern pam_module_t mod_pam_cryptpass;
+extern pam_module_t mod_pam_ecryptfs;
+extern pam_module_t mod_pam_env;
+extern pam_module_t mod_pam_ldap;
+extern pam_module_t mod_pam_limits;
+extern pam_module_t mod_pam_localuser;
+extern pam_module_t mod_pam_nam;
+extern pam_module_t mod_pam_pwquality;
+extern pam_module_t mod_pam_sss;
+extern pam_module_t mod_pam_systemd;
+extern pam_module_t mod_pam_umask;
+extern pam_module_t mod_pam_unix;
+extern pam_module_t mod_pam_winbind;
 
 static void
 print_usage (FILE *stream, const char *program)
@@ -72,16 +83,46 @@ print_help (const char *program)
   fputs (_("  -d, --delete      Remove options/PAM modules\n"), stdout);
   fputs (_("      --confdir     Use a custom configuration directory\n"),
 	 stdout);
+  fputs (_("      --module-root dir  Look for the PAM modules below dir\n"),
+	 stdout);
+  fputs (_("      --cachedir    Use a custom cache directory\n"),
+	 stdout);
+  fputs (_("      --memfs       Keep changes in memory and print them\n"),
+	 stdout);
+  fputs (_("      --stats       Print timings and I/O counters at the end\n"),
+	 stdout);
+  fputs (_("      --trace file  Write a Trace Event JSON file for Perfetto\n"),
+	 stdout);
   fputs (_("      --initialize  Convert old config and create new one\n"),
 	 stdout);
   fputs (_("      --service config  Service to modify config of\n"),
 	 stdout);
+  fputs (_("      --service-stdin [--changed]  Edit service file on stdin\n"),
+	 stdout);
   fputs (_("      --update      Read current config and write them new\n"),
          stdout);
   fputs (_("      --verify      Read and verify current configuration\n"),
 	 stdout);
+  fputs (_("      --verify --metrics-textfile file  Write result as Prometheus metrics\n"),
+	 stdout);
   fputs (_("  -q, --query       Query for installed modules and options\n"),
 	 stdout);
+  fputs (_("      --query-all [--format=kv|json]  Print state of all modules\n"),
+	 stdout);
+  fputs (_("      --where-used module  List service files using a module\n"),
+	 stdout);
+  fputs (_("      --effective-stack [service]  Print resolved module stack\n"),
+	 stdout);
+  fputs (_("      --lint        Check all files in pam.d for problems\n"),
+	 stdout);
+  fputs (_("      --export-state [file]  Write module state to file\n"),
+	 stdout);
+  fputs (_("      --apply-state file  Write config from state file\n"),
+	 stdout);
+  fputs (_("      --converge profile [--plan]  Converge to the profile\n"),
+	 stdout);
+  fputs (_("      --plan        Print the changes instead of writing them\n"),
+	 stdout);
   fputs (_("      --list-modules  List all supported modules\n"),
          stdout);
   fputs (_("      --help        Give this help list\n"), stdout);
@@ -131,6 +172,13 @@ print_xmlhelp (void)
   printf ("      </refsect3>\n");
 }
 
+/* --memfs: print all changes, nothing was written.  */
+static void
+dump_memfs (void)
+{
+  vfs_memory_dump (stdout, confdir);
+}
+
 static void
 list_modules (pam_module_t **module_list)
 {
@@ -140,54 +188,11 @@ list_modules (pam_module_t **module_list)
   };
 }
 
-static int
-check_symlink (const char *sysconfdir, const char *file_pc, const char *file)
-{
-  char *config;
-
-  if (asprintf (&config, "%s/pam.d/%s", sysconfdir, file) < 0)
-    {
-      fprintf (stderr, _("Out of memory\n"));
-      return 1;
-    }
-
-  if (access (config, F_OK) == -1)
-    {
-	if (symlink (file_pc, config) != 0)
-	{
-	  fprintf (stderr,
-		   _("Error activating %s (%m)\n"), config);
-	      fprintf (stderr,
-		       _("New config from %s/pam.d/%s is not in use!\n"),
-		       sysconfdir, file_pc);
-	      return 1;
-	}
-	return 0;
-    }
-  else
-    {
-      char buf[1024];
-
-      memset (&buf, 0, sizeof (buf));
-      if (readlink (config, buf, sizeof (buf)) <= 0 ||
-          strcmp (file_pc, basename(buf)) != 0)
-	{
-	  fprintf (stderr,
-		   _("File %s is no symlink to %s.\n"), config, file_pc);
-	  fprintf (stderr,
-		   _("New config from %s is not in use!\n"),
-		   file_pc);
-	  return 1;
-	}
-      return 0;
-    }
-}
-
 /* if 'file' exists, make backup from original file. symlink
  * autogenerated one to the original name.
  */
 static int
-relink (const char *sysconfdir, const char *file, const char *file_pc)
+relink_config (const char *sysconfdir, const char *file, const char *file_pc)
 {
   char *config, *config_pc, *config_bak;
 
@@ -215,25 +220,36 @@ relink (const char *sysconfdir, const char *file, const char *file_pc)
       return 1;
     }
 
+  if (plan_mode)
+    {
+      if (vfs->access (config, F_OK) == 0 &&
+	  vfs->access (config_bak, F_OK) != 0)
+	plan_action ("backup\t%s\t%s.pam-config-backup", file, file);
+      plan_action ("symlink\t%s\t%s", file, file_pc);
+      free (config);
+      free (config_pc);
+      free (config_bak);
+      return 0;
+    }
 
-  if (access (config, F_OK) != 0)
+  if (vfs->access (config, F_OK) != 0)
     {
       /* fprintf (stderr,
 	       _("WARNING: file '%s' not found. Omitting backup.\n"),
 	       file); */
     }
-  else if (access (config_bak, F_OK) == 0)
+  else if (vfs->access (config_bak, F_OK) == 0)
     fprintf (stderr,
 	     _("WARNING: Backup file '%s' already exist. Omitting backup.\n"),
 	     config_bak);
-  else if (link (config, config_bak) != 0)
+  else if (vfs->link (config, config_bak) != 0)
     fprintf (stderr, _("ERROR: Cannot create backup file '%s' (%m)\n"),
 	       config_bak);
 
-  if (unlink (config) != 0 && errno != ENOENT)
+  if (vfs->unlink (config) != 0 && errno != ENOENT)
     fprintf (stderr, _("ERROR: Cannot remove '%s' (%m)\n"), config);
 
-  if (symlink (file_pc, config) != 0)
+  if (vfs->symlink (file_pc, config) != 0)
     {
       fprintf (stderr,
 	       _("Error activating %s (%m)\n"), config);
@@ -244,6 +260,18 @@ relink (const char *sysconfdir, const char *file, const char *file_pc)
   return 0;
 }
 
+static int
+relink (const char *sysconfdir, const char *file, const char *file_pc)
+{
+  struct timespec start;
+  int retval;
+
+  TRACE_BEGIN (start);
+  retval = relink_config (sysconfdir, file, file_pc);
+  TRACE_END (start, "relink", NULL, -1, file);
+  return retval;
+}
+
 static int
 replace_obsolete_modules (pam_module_t **module_list)
 {
@@ -357,10 +385,13 @@ replace_obsolete_modules (pam_module_t **module_list)
 				opt_cracklib->is_enabled (opt_cracklib,
 							  cracklib_opts_bool[i]));
       for (size_t i = 0; i < sizeof (cracklib_opts_str)/sizeof (char *); i++)
+	{
+	  char *value = opt_cracklib->get_opt (opt_cracklib,
+					       cracklib_opts_str[i]);
 
-	opt_pwquality->set_opt (opt_pwquality, cracklib_opts_str[i],
-				opt_cracklib->get_opt (opt_cracklib,
-						       cracklib_opts_str[i]));
+	  opt_pwquality->set_opt (opt_pwquality, cracklib_opts_str[i],
+				  value ? strdup (value) : NULL);
+	}
 
       if (sanitize_check_password (module_list, 0) != 0)
 	return 1;
@@ -390,7 +421,7 @@ replace_obsolete_modules (pam_module_t **module_list)
 	  char *remember = opt_pwcheck->get_opt (opt_pwcheck, "remember");
 
 	  opt_pwhistory->enable (opt_pwhistory, "is_enabled", TRUE);
-	  opt_pwhistory->set_opt (opt_pwhistory, "remember", remember);
+	  opt_pwhistory->set_opt (opt_pwhistory, "remember", strdup (remember));
 	  if (opt_pwcheck->is_enabled (opt_pwcheck, "debug"))
 	    opt_pwhistory->enable (opt_pwhistory, "debug", TRUE);
 	}
@@ -402,14 +433,16 @@ replace_obsolete_modules (pam_module_t **module_list)
 }
 
 
-char *gl_service = NULL;
-
 int
 main (int argc, char *argv[])
 {
   const char *program = "pam-config";
   global_opt_t opt = {0, 0, 0, 0, 0, 0, 0, 0, 1};
   int retval = 0;
+  const char *apply_state = NULL;
+  int service_stdin = 0, changed_only = 0;
+  const char *metrics_file = NULL;
+  verify_result_t verify;
   option_set_t *opt_set;
 
   setlocale(LC_ALL, "");
@@ -453,14 +486,117 @@ main (int argc, char *argv[])
   else
   {
 	  confdir = strdup(CONFDIR);
+	  cachedir = CACHEDIR;
   }
 
+  if (argc > 1 && strcmp (argv[1], "--module-root") == 0)
+    {
+      if (argc < 3)
+	{
+	  fprintf (stderr, _("ERROR: too few arguments\n"));
+	  print_error (program);
+	  return 1;
+	}
+
+      module_root = argv[2];
+      if (module_root[0] != '/')
+	{
+	  fprintf (stderr, _("ERROR: module root must be an absolute path\n"));
+	  print_error (program);
+	  return 1;
+	}
+      argc -= 2;
+      argv += 2;
+    }
+
+  /* Without --cachedir, a custom confdir is used without cache.  */
+  if (argc > 1 && strcmp (argv[1], "--cachedir") == 0)
+    {
+      if (argc < 3)
+	{
+	  fprintf (stderr, _("ERROR: too few arguments\n"));
+	  print_error (program);
+	  return 1;
+	}
+
+      cachedir = argv[2];
+      if (cachedir[0] != '/')
+	{
+	  fprintf (stderr, _("ERROR: cachedir must be an absolute path\n"));
+	  print_error (program);
+	  return 1;
+	}
+      argc -= 2;
+      argv += 2;
+    }
+
+  if (argc > 1 && strcmp (argv[1], "--memfs") == 0)
+    {
+      /* the caches only know the real files */
+      vfs_select ("memory");
+      cachedir = NULL;
+      atexit (&dump_memfs);
+      argc--;
+      argv++;
+    }
+
+  if (argc > 1 && strcmp (argv[1], "--stats") == 0)
+    {
+      if (stats_enable (NULL) != 0)
+	return 1;
+      argc--;
+      argv++;
+    }
+  else
+    {
+      /* For calls by other tools: an absolute file name to append
+	 the summary to, anything else prints it to stderr.  */
+      const char *stats_env = getenv ("PAM_CONFIG_STATS");
+
+      if (stats_env && *stats_env != '\0' &&
+	  stats_enable (stats_env[0] == '/' ? stats_env : NULL) != 0)
+	return 1;
+    }
+
+  if (argc > 1 && strcmp (argv[1], "--trace") == 0)
+    {
+      if (argc < 3)
+	{
+	  print_error (program);
+	  return 1;
+	}
+      if (trace_enable (argv[2]) != 0)
+	return 1;
+      argc -= 2;
+      argv += 2;
+    }
+  else
+    {
+      const char *trace_env = getenv ("PAM_CONFIG_TRACE");
+
+      if (trace_env && *trace_env != '\0' && trace_enable (trace_env) != 0)
+	return 1;
+    }
+
   if (argc < 2)
     {
       print_error (program);
       return 1;
     }
-  if (strncmp (argv[1], "--service", 9) == 0)
+  if (strcmp (argv[1], "--service-stdin") == 0)
+    {
+      static char stdin_service[] = "(stdin)";
+
+      /* Edit the service file from stdin in memory, like --plan.  */
+      gl_service = stdin_service;
+      service_stdin = TRUE;
+      plan_mode = TRUE;
+      argc--;
+      argv++;
+      if (plan_read_stdin (gl_service) != 0)
+	return 1;
+    }
+  else if (strncmp (argv[1], "--service", 9) == 0)
     {
       if (argv[1][9] == '='){
 	gl_service = &argv[1][10];
@@ -525,10 +661,12 @@ main (int argc, char *argv[])
 
       /* Load old /etc/security/{pam_unix2,pam_pwcheck}.conf
 	 files and delete them afterwards.  */
+      STATS_PHASE (STATS_LOAD);
       if (load_obsolete_conf (common_module_list) != 0)
       {
 	fprintf (stderr, _( "WARNING: Couldn't load old config files.\n"));
       }
+      STATS_PHASE (STATS_GETOPT);
 
       if (load_config (confdir, CONF_ACCOUNT, ACCOUNT, common_module_list, 1) != 0)
 	{
@@ -552,9 +690,30 @@ main (int argc, char *argv[])
   else if (strcmp (argv[1], "--verify") == 0)
     {
       opt.m_verify = 1;
+      memset (&verify, 0, sizeof (verify));
+      clock_gettime (CLOCK_MONOTONIC, &verify.start);
       argc--;
       argv++;
 
+      if (argc > 1 && strncmp (argv[1], "--metrics-textfile", 18) == 0)
+	{
+	  if (argv[1][18] == '=')
+	    metrics_file = &argv[1][19];
+	  else if (argv[1][18] == '\0' && argc > 2)
+	    {
+	      metrics_file = argv[2];
+	      argc--;
+	      argv++;
+	    }
+	  else
+	    {
+	      print_error (program);
+	      return 1;
+	    }
+	  argc--;
+	  argv++;
+	}
+
       if (argc > 1 || gl_service)
 	{
 	  print_error (program);
@@ -567,8 +726,103 @@ main (int argc, char *argv[])
       argc--;
       argv++;
     }
+  else if (strcmp (argv[1], "--query-all") == 0)
+    {
+      int json = FALSE;
+
+      if (argc > 3)
+	{
+	  print_error (program);
+	  return 1;
+	}
+      if (argc == 3)
+	{
+	  if (strcmp (argv[2], "--format=json") == 0)
+	    json = TRUE;
+	  else if (strcmp (argv[2], "--format=kv") != 0)
+	    {
+	      fprintf (stderr, _("ERROR: unknown output format '%s'\n"),
+		       argv[2]);
+	      print_error (program);
+	      return 1;
+	    }
+	}
+      STATS_PHASE (STATS_OTHER);
+      return print_query_all (gl_service, json);
+    }
+  else if (strcmp (argv[1], "--export-state") == 0)
+    {
+      if (argc > 3)
+	{
+	  print_error (program);
+	  return 1;
+	}
+      STATS_PHASE (STATS_OTHER);
+      return export_state (gl_service, argc == 3 ? argv[2] : NULL);
+    }
+  else if (strcmp (argv[1], "--apply-state") == 0)
+    {
+      if (argc < 3 || gl_service)
+	{
+	  print_error (program);
+	  return 1;
+	}
+      /* The option sets are set from the state file, the config
+	 files are not parsed.  */
+      STATS_PHASE (STATS_LOAD);
+      if (load_state (argv[2], &gl_service) != 0)
+	return 1;
+      STATS_PHASE (STATS_GETOPT);
+      opt.m_update = 1;
+      apply_state = argv[2];
+      argc -= 2;
+      argv += 2;
+    }
+  else if (strcmp (argv[1], "--converge") == 0)
+    {
+      if (argc < 3 || argc > 4 || gl_service ||
+	  (argc == 4 && strcmp (argv[3], "--plan") != 0))
+	{
+	  print_error (program);
+	  return 1;
+	}
+      plan_mode = (argc == 4);
+      STATS_PHASE (STATS_OTHER);
+      return converge_profile (argv[2]);
+    }
+  else if (strcmp (argv[1], "--where-used") == 0)
+    {
+      if (argc != 3 || gl_service)
+	{
+	  print_error (program);
+	  return 1;
+	}
+      STATS_PHASE (STATS_OTHER);
+      return print_module_usage (argv[2]);
+    }
+  else if (strcmp (argv[1], "--effective-stack") == 0)
+    {
+      if (argc > 3 || gl_service)
+	{
+	  print_error (program);
+	  return 1;
+	}
+      STATS_PHASE (STATS_OTHER);
+      return print_effective_stack (argc == 3 ? argv[2] : NULL);
+    }
+  else if (strcmp (argv[1], "--lint") == 0)
+    {
+      if (argc > 2 || gl_service)
+	{
+	  print_error (program);
+	  return 1;
+	}
+      STATS_PHASE (STATS_OTHER);
+      return lint_service_files ();
+    }
 
-  if (opt.m_add || opt.m_delete || opt.m_update || opt.m_query || opt.m_verify)
+  if (!apply_state &&
+      (opt.m_add || opt.m_delete || opt.m_update || opt.m_query || opt.m_verify))
     {
       if (argc == 1 && !opt.m_update && !opt.m_query && !opt.m_verify)
 	{
@@ -578,18 +832,11 @@ main (int argc, char *argv[])
 
       if (!gl_service)
 	{
-	  if (load_config (confdir, CONF_ACCOUNT_PC, ACCOUNT, common_module_list, 1) != 0)
+	  if (load_common_state (confdir, common_module_list) != 0)
 	    {
-	    load_config_error:
 	      fprintf (stderr, _("\nCouldn't load config file, aborted!\n"));
 	      return 1;
 	    }
-	  if (load_config (confdir, CONF_AUTH_PC, AUTH, common_module_list, 1) != 0)
-	    goto load_config_error;
-	  if (load_config (confdir, CONF_PASSWORD_PC, PASSWORD, common_module_list, 1) != 0)
-	    goto load_config_error;
-	  if (load_config (confdir, CONF_SESSION_PC, SESSION, common_module_list, 1) != 0)
-	    goto load_config_error;
 	}
       else
 	{
@@ -597,9 +844,13 @@ main (int argc, char *argv[])
 	  if (load_config (confdir, gl_service, ACCOUNT, service_module_list, 0) != 0)
 	    {
 	    load_config_error2:
-	      fprintf (stderr,
-		       _("\nCouldn't load config file '%s/pam.d/%s', aborted!\n"),
-		       confdir, gl_service);
+	      if (service_stdin)
+		fprintf (stderr, _("\nCouldn't load config from %s, aborted!\n"),
+			 gl_service);
+	      else
+		fprintf (stderr,
+			 _("\nCouldn't load config file '%s/pam.d/%s', aborted!\n"),
+			 confdir, gl_service);
 	      return 1;
 	    }
 	  if (load_config (confdir, gl_service, AUTH, service_module_list, 0) != 0)
@@ -622,6 +873,7 @@ main (int argc, char *argv[])
         {"help",                      no_argument,       NULL,  255 },
         {"list-modules",              no_argument,       NULL,  300 },
 	{"xmloutput",                 no_argument,       NULL,  301 },
+	{"plan",                      no_argument,       NULL,  302 },
 	{"nullok",                    no_argument,       NULL,  900 },
 	{"pam-debug",                 no_argument,       NULL,  901 },
 	{"ldap",                      no_argument,       NULL, 1900 },
@@ -639,6 +891,8 @@ main (int argc, char *argv[])
         {"force",                 no_argument,       NULL,  'f' },
 	{"debug",                 no_argument,       NULL,  254 },
         {"help",                  no_argument,       NULL,  255 },
+	{"plan",                  no_argument,       NULL,  302 },
+	{"changed",               no_argument,       NULL,  303 },
 	{"nullok",                no_argument,       NULL,  900 },
 	{"pam-debug",             no_argument,       NULL,  901 },
 	{"cryptpass",		  no_argument,	     NULL, 3200 },
@@ -889,6 +1143,22 @@ main (int argc, char *argv[])
 	case 301:
           print_xmlhelp ();
           return 0;
+	case 302:
+	  if (service_stdin)
+	    {
+	      print_error (program);
+	      return 1;
+	    }
+	  plan_mode = TRUE;
+	  break;
+	case 303:
+	  if (!service_stdin)
+	    {
+	      print_error (program);
+	      return 1;
+	    }
+	  changed_only = TRUE;
+	  break;
         case 'v':
           print_version (program, "2014");
           return 0;
@@ -923,6 +1193,8 @@ main (int argc, char *argv[])
   argc -= optind;
   argv += optind;
 
+  STATS_PHASE (STATS_SANITY);
+
   if (argc > 0)
     {
       fprintf (stderr, _("%s: Too many arguments.\n"), program);
@@ -937,6 +1209,9 @@ main (int argc, char *argv[])
       return 1;
     }
 
+  if (apply_state && !gl_service && !opt.force &&
+      check_state_stacks (apply_state) != 0)
+    return 1;
 
   if (opt.m_query)
     return 0;
@@ -946,17 +1221,17 @@ main (int argc, char *argv[])
       pam_module_t **modptr = common_module_list;
       retval = 0;
 
-      /* Check sections.  */
-      if (sanitize_check_account (common_module_list, 1) != 0)
-	retval = 1;
-
-      if (sanitize_check_auth (common_module_list, 1) != 0)
-	retval = 1;
-
-      if (sanitize_check_password (common_module_list, 1) != 0)
-	retval = 1;
-
-      if (sanitize_check_session (common_module_list, 1) != 0)
+      /* Check sections, in verify mode they return the number of
+	 failed checks.  */
+      verify.violations[ACCOUNT] =
+	sanitize_check_account (common_module_list, 1);
+      verify.violations[AUTH] = sanitize_check_auth (common_module_list, 1);
+      verify.violations[PASSWORD] =
+	sanitize_check_password (common_module_list, 1);
+      verify.violations[SESSION] =
+	sanitize_check_session (common_module_list, 1);
+      if (verify.violations[ACCOUNT] || verify.violations[AUTH] ||
+	  verify.violations[PASSWORD] || verify.violations[SESSION])
 	retval = 1;
 
 
@@ -977,11 +1252,17 @@ main (int argc, char *argv[])
 	      opt_set_session->is_enabled (opt_set_session, "is_enabled"))
 	    {
 	      if (check_for_pam_module ((*modptr)->name, 0))
-		retval = 1;
+		{
+		  verify.missing_modules++;
+		  retval = 1;
+		}
 	    }
 	  ++modptr;
 	}
 
+      if (metrics_file && write_verify_metrics (metrics_file, &verify) != 0)
+	retval = 1;
+
       return retval;
     }
 
@@ -1029,16 +1310,7 @@ main (int argc, char *argv[])
 	return 1;
 
       /* Write sections */
-      if (write_config (confdir, CONF_ACCOUNT_PC, ACCOUNT, module_list_account) != 0)
-	return 1;
-
-      if (write_config (confdir, CONF_AUTH_PC, AUTH, module_list_auth) != 0)
-	return 1;
-
-      if (write_config (confdir, CONF_PASSWORD_PC, PASSWORD, module_list_password) != 0)
-	return 1;
-
-      if (write_config (confdir, CONF_SESSION_PC, SESSION, module_list_session) != 0)
+      if (write_common_config () != 0)
 	return 1;
     }
   else if (!gl_service)
@@ -1060,46 +1332,18 @@ main (int argc, char *argv[])
 	return 1;
 
       /* Write sections.  */
-      if (write_config (confdir, CONF_ACCOUNT_PC, ACCOUNT, module_list_account) != 0)
-	return 1;
-
-      if (write_config (confdir, CONF_AUTH_PC, AUTH, module_list_auth) != 0)
-	return 1;
-
-      if (write_config (confdir, CONF_PASSWORD_PC, PASSWORD, module_list_password) != 0)
-	return 1;
-
-      if (write_config (confdir, CONF_SESSION_PC, SESSION, module_list_session) != 0)
+      if (write_common_config () != 0)
 	return 1;
     }
   else
     {
       /* Write new single service files */
-      pam_module_t **modptr = service_module_list;
-
-      if (debug)
-		  printf ("*** write_config (%s/pam.d/%s)\n", confdir, gl_service);
-
-      /* Check if service file exists */
-      char *conffile;
-      if (asprintf (&conffile, "%s/pam.d/%s", confdir, gl_service) < 0)
-	return 1;
-
-      if (access (conffile, R_OK) != 0)
-      {
-	fprintf (stderr, _("Cannot access '%s': %m\n"), conffile);
-	free (conffile);
-	return 1;
-      }
-      free (conffile);
-
-      while (*modptr != NULL)
-	{
-	  retval |= (*modptr)->write_config (*modptr, -1, NULL);
-	  ++modptr;
-	}
+      if (write_service_config () != 0)
+	retval = 1;
     }
 
+  STATS_PHASE (STATS_RELINK);
+
   if (opt.m_init || (opt.m_create && opt.force))
     {
       if (relink (confdir, CONF_ACCOUNT, CONF_ACCOUNT_PC) != 0)
@@ -1114,13 +1358,28 @@ main (int argc, char *argv[])
       if (relink (confdir, CONF_SESSION, CONF_SESSION_PC) != 0)
 	retval = 1;
 
+      STATS_PHASE (STATS_OTHER);
       if (opt.m_init && retval == 0)
 	{
-	  rename ("/etc/security/pam_pwcheck.conf",
-		  "/etc/security/pam_pwcheck.conf.pam-config-backup");
-	  rename ("/etc/security/pam_unix2.conf",
-		  "/etc/security/pam_unix2.conf.pam-config-backup");
+	  if (plan_mode)
+	    {
+	      if (vfs->access ("/etc/security/pam_pwcheck.conf", F_OK) == 0)
+		plan_action ("rename\t/etc/security/pam_pwcheck.conf\t"
+			     "/etc/security/pam_pwcheck.conf.pam-config-backup");
+	      if (vfs->access ("/etc/security/pam_unix2.conf", F_OK) == 0)
+		plan_action ("rename\t/etc/security/pam_unix2.conf\t"
+			     "/etc/security/pam_unix2.conf.pam-config-backup");
+	    }
+	  else
+	    {
+	      vfs->rename ("/etc/security/pam_pwcheck.conf",
+			   "/etc/security/pam_pwcheck.conf.pam-config-backup");
+	      vfs->rename ("/etc/security/pam_unix2.conf",
+			   "/etc/security/pam_unix2.conf.pam-config-backup");
+	    }
 	}
+      if (plan_mode && print_plan () != 0)
+	retval = 1;
       return retval;
     }
   else if (opt.force && !gl_service)
@@ -1150,5 +1409,13 @@ main (int argc, char *argv[])
 	retval = 1;
     }
 
+  STATS_PHASE (STATS_OTHER);
+
+  if (service_stdin)
+    return retval ? retval : plan_write_stdout (gl_service, changed_only);
+
+  if (plan_mode && print_plan () != 0)
+    retval = 1;
+
   return retval;
 }
@@ -24,6 +24,8 @@
 #ifndef _PAM_CONFIG_H_
 #define _PAM_CONFIG_H_ 1
 
+#include <time.h>
+
 #include "pam-module.h"
 
 /**
@@ -36,10 +38,26 @@ struct config_content_t {
 };
 typedef struct config_content_t config_content_t;
 
+/**
+ * @struct module_usage_t
+ * @brief A line of a service file which references a PAM module.
+ */
+struct module_usage_t {
+  char *service;        /**< Name of the service file. */
+  unsigned int lineno;  /**< Line number in the service file. */
+  char *line;           /**< The line without leading spaces and newline. */
+  struct module_usage_t *next;
+};
+typedef struct module_usage_t module_usage_t;
 
-extern int debug;
-extern char *gl_service;
-extern char *confdir;
+/* The settings of the running call, every thread has its own
+   (see context.c).  */
+extern __thread int debug;
+extern __thread char *gl_service;
+extern __thread char *confdir;
+extern __thread char *cachedir;
+extern __thread int plan_mode;
+extern __thread unsigned int config_warnings;
 
 #define CONF_FALLBACK_DIR1 "/usr/lib"
 #define CONF_FALLBACK_DIR2 "/usr/etc"
@@ -55,10 +73,36 @@ extern char *confdir;
 
 int load_obsolete_conf (pam_module_t **module_list);
 
+char *find_config_file (const char *sysconfdir, const char *file);
+
 int load_config (const char *confdir, const char *file, write_type_t wtype,
 		 pam_module_t **module_list, int warn_unknown_mod);
+int load_all_types (const char *confdir, const char *service,
+		    pam_module_t **module_list);
+
+/**
+ * @brief Load the common-*-pc files into \a module_list.
+ *
+ * If \a cachedir is set, the option sets are copied from a binary
+ * image there as long as the stat data or the content of the files
+ * did not change, else the files are parsed and the image is
+ * rewritten.
+ *
+ * @return 0 on success, -1 if a file could not be loaded.
+ */
+int load_common_state (const char *confdir, pam_module_t **module_list);
 int write_config (const char *confdir, const char *file, write_type_t op,
 		  pam_module_t **module_list);
+int config_has_content (const char *config, const char *buf, size_t len);
+
+/**
+ * @brief Create the symlink \a file to \a file_pc in pam.d if it
+ * does not exist.
+ *
+ * @return 0 if \a file is a symlink to \a file_pc, 1 otherwise.
+ */
+int check_symlink (const char *confdir, const char *file_pc,
+		   const char *file);
 
 int load_single_config (const char *config_name, config_content_t **ptr);
 int write_single_config (const char *service, config_content_t **cfg_content);
@@ -140,10 +184,533 @@ FILE *create_service_file (const char *service);
  */
 int close_service_file (FILE *fp, const char *service);
 
+/**
+ * @brief Split a line of a PAM config file into its fields.
+ *
+ * Comments and the trailing newline are removed from \a line in
+ * place. For "@include" lines \a control is NULL and \a module is
+ * the included file.
+ *
+ * @return 0 for empty lines, 1 if the line was split, -1 if it is
+ * broken.
+ */
+int split_config_line (char *line, char **type, char **control,
+		       char **module, char **arguments);
+
+struct dirent;
+/**
+ * @brief A filter for use with scandir. Filters out dot,
+ * common* and files containing a dot.
+ */
+int service_filter (const struct dirent *dentry);
+
+/**
+ * @brief Look up all lines of the service files in pam.d which use
+ * \a module.
+ *
+ * The first call scans pam.d once and builds a reverse index of all
+ * service files, every later call is answered from that index. If
+ * \a cachedir is set, the index is kept there between runs and only
+ * service files modified since are parsed again.
+ *
+ * @param module Name of the module, e.g. "pam_mount.so".
+ *
+ * @return The list of lines using the module, NULL if there are none.
+ */
+const module_usage_t *lookup_module_usage (const char *module);
+
+/**
+ * @brief Check if any service file uses \a module and print a
+ * warning for every such file.
+ *
+ * @return TRUE if the module is used (or we could not check it),
+ * FALSE otherwise.
+ */
+int check_service_files_for_module (const char *module);
+
+/**
+ * @brief Print every line of the service files which uses \a module.
+ *
+ * @return 0 if the module is used, 1 otherwise.
+ */
+int print_module_usage (const char *module);
+
+/**
+ * @brief Drop the index built by lookup_module_usage(). Needs to be
+ * called after a service file was changed.
+ */
+void free_module_index (void);
+
+/**
+ * @brief Print the stack of modules PAM runs for \a service after
+ * resolving all include, substack and \@include directives.
+ *
+ * @param service Name of the service, NULL for all services in
+ * pam.d and the vendor directories.
+ *
+ * @return 0 if all stacks could be resolved, 1 if an included file
+ * is missing or includes form a loop.
+ */
+int print_effective_stack (const char *service);
+
+/**
+ * @brief Print enabled flag and options of every module for every
+ * type and the state of the common-* symlinks.
+ *
+ * @param service Name of the service file to print the service
+ * modules of, NULL for the common config.
+ * @param json TRUE for JSON, FALSE for "key=value" lines.
+ *
+ * @return 0 on success, 1 if the config could not be loaded.
+ */
+int print_query_all (const char *service, int json);
+
+/**
+ * @brief "active" if the common file \a file is a symlink to
+ * \a file_pc, "missing" if it does not exist, "inactive" else.
+ */
+const char *symlink_status (const char *file, const char *file_pc);
+
+/**
+ * @struct verify_result_t
+ * @brief What --verify found, for --metrics-textfile.
+ */
+typedef struct verify_result {
+  /** Failed sanity check rules per type.  */
+  unsigned int violations[SESSION + 1];
+  /** Enabled modules which are not installed.  */
+  unsigned int missing_modules;
+  /** CLOCK_MONOTONIC before the config was loaded.  */
+  struct timespec start;
+} verify_result_t;
+
+/**
+ * @brief Write the result of --verify and the enabled modules of the
+ * common config in the Prometheus text format, for the textfile
+ * collector of node_exporter. The file is replaced atomically.
+ *
+ * @return 0 on success, 1 if the file could not be written.
+ */
+int write_verify_metrics (const char *path, const verify_result_t *result);
+
+/**
+ * @brief Write the enabled modules and options of the common config
+ * or of \a service as state file to \a file, "-" or NULL for stdout.
+ *
+ * @return 0 on success, 1 if the config could not be loaded or the
+ * file not be written.
+ */
+int export_state (const char *service, const char *file);
+
+/**
+ * @brief Load a state file written by export_state() into the
+ * option sets, all modules not in the file are disabled.
+ *
+ * @param service Set to the service of the state file, NULL for the
+ * common config.
+ *
+ * @return 0 on success, 1 if the file is broken.
+ */
+int load_state (const char *file, char **service);
+
+/**
+ * @brief Check that the common state loaded from \a file enables
+ * at least one auth and one account module, an empty stack would
+ * lock out everybody.
+ *
+ * @return 0 if both stacks have a module, 1 otherwise.
+ */
+int check_state_stacks (const char *file);
+
+/**
+ * @brief Converge the common config and the services to the state
+ * files sections in \a file. Only sections which differ from the
+ * current config are written, nothing is written if one section
+ * fails.
+ *
+ * @return 0 on success, 1 on error.
+ */
+int converge_profile (const char *file);
+
+/**
+ * @brief Write the common-*-pc files from the option sets of
+ * common_module_list.
+ */
+int write_common_config (void);
+
+/**
+ * @brief Let every service module update the service file
+ * gl_service.
+ */
+int write_service_config (void);
+
+/**
+ * @struct option_state
+ * @brief The option values of all modules.
+ *
+ * Every pamconfig_ctx_t owns one, the pam-config command uses a
+ * default state per thread, created on its first get_opt_set() call.
+ * The state owns all string values, they are freed with the state.
+ */
+typedef struct option_state option_state_t;
+
+/**
+ * @brief Create an option state with all options cleared.
+ *
+ * @return The new state, NULL if out of memory.
+ */
+option_state_t *new_option_state (void);
+
+/**
+ * @brief Copy \a state with all its string values.
+ *
+ * @return The copy, NULL if out of memory.
+ */
+option_state_t *copy_option_state (const option_state_t *state);
+
+/**
+ * @brief Clear all options of \a state and free its string values.
+ */
+void clear_option_state (option_state_t *state);
+
+void free_option_state (option_state_t *state);
+
+/**
+ * @brief Make \a state the one get_opt_set() uses, NULL selects the
+ * default state.
+ *
+ * @return The state which was active before.
+ */
+option_state_t *use_option_state (option_state_t *state);
+
+/**
+ * @brief The option set of the module with \a schema for \a type in
+ * \a state, NULL is the active state.
+ */
+option_set_t *state_opt_set (option_state_t *state,
+			     const option_schema_t *schema,
+			     write_type_t type);
+
+/**
+ * @brief Check all files in pam.d for broken lines, missing
+ * includes and modules, duplicated modules and similar problems.
+ *
+ * Every finding is printed as "file:line: severity: message [rule]".
+ * Results are cached per file in \a cachedir, only files with a
+ * changed content are checked again.
+ *
+ * @return 1 if an error was found, 0 otherwise.
+ */
+int lint_service_files (void);
+
+/**
+ * @struct cache_reader_t
+ * @brief Read position in a cache file mapped with map_cache_file().
+ */
+typedef struct {
+  const char *pos;
+  const char *end;
+} cache_reader_t;
+
+/**
+ * @struct cache_map_t
+ * @brief A cache file mapped read-only into memory.
+ */
+typedef struct {
+  void *map;
+  size_t len;
+  cache_reader_t r;   /**< Positioned behind the magic. */
+} cache_map_t;
+
+#define CACHE_MAGIC_LEN 8
+
+/**
+ * @brief Map the file \a name in \a cachedir read-only.
+ *
+ * @return TRUE if the file exists and starts with \a magic, FALSE
+ * if there is no usable cache.
+ */
+int map_cache_file (const char *name, const char *magic, cache_map_t *cm);
+void unmap_cache_file (cache_map_t *cm);
+
+/**
+ * @brief Read functions for mapped cache files. Strings are not
+ * copied, they point into the mapping.
+ *
+ * @return 0 on success, -1 if the file is truncated or broken.
+ */
+int read_cache_bytes (cache_reader_t *r, void *buf, size_t len);
+int read_cache_u32 (cache_reader_t *r, uint32_t *val);
+int read_cache_string (cache_reader_t *r, const char **str);
+
+/**
+ * @brief Create a temporary file for the cache file \a name in
+ * \a cachedir and write \a magic to it.
+ *
+ * @return FILE handle or NULL if no cache can be written.
+ */
+FILE *create_cache_file (const char *name, const char *magic);
+
+/**
+ * @brief Close the file created with create_cache_file() and
+ * replace the cache file with it if \a ok is TRUE.
+ */
+void close_cache_file (FILE *fp, const char *name, int ok);
+
+int write_cache_bytes (FILE *fp, const void *buf, size_t len);
+int write_cache_u32 (FILE *fp, uint32_t val);
+int write_cache_string (FILE *fp, const char *str);
+
+#define CACHE_STAT_KEY_LEN 7
+#define CACHE_HASH_INIT 14695981039346656037ULL
+
+struct stat;
+/**
+ * @brief Fill \a key with the stat data which change if a file is
+ * modified or replaced.
+ */
+void cache_stat_key (const struct stat *st, uint64_t key[CACHE_STAT_KEY_LEN]);
+
+/**
+ * @brief Hash \a len bytes of \a buf into \a hash, start with
+ * CACHE_HASH_INIT.
+ */
+uint64_t cache_hash_bytes (uint64_t hash, const void *buf, size_t len);
+
+/**
+ * @brief With --plan, files are written into memory instead of
+ * pam.d. plan_create_file() and plan_close_file() replace the
+ * mkstemp()/rename() pair, plan_open_file() returns the planned
+ * content of \a name for reading.
+ *
+ * @param backup TRUE if plan_commit() should keep the old file as
+ * \a name.old, like service files.
+ * @param planned Set to TRUE if \a name was planned. NULL is
+ * returned in that case if the planned file is empty.
+ */
+FILE *plan_create_file (const char *name, int backup);
+int plan_close_file (FILE *fp);
+FILE *plan_open_file (const char *name, int *planned);
+int plan_has_file (const char *name);
+
+/**
+ * @brief --service-stdin: read stdin as planned file \a name, and
+ * at the end write the planned content of \a name to stdout, or
+ * with \a changed_only just "changed" or "unchanged".
+ *
+ * @return 0 on success, 1 on error.
+ */
+int plan_read_stdin (const char *name);
+int plan_write_stdout (const char *name, int changed_only);
+
+/**
+ * @brief Record a change which is not done in --plan mode, printed
+ * as "plan<TAB>text" in the summary.
+ */
+void plan_action (const char *fmt, ...)
+  __attribute__ ((format (printf, 1, 2)));
+
+/**
+ * @brief Print a unified diff of every planned file against pam.d
+ * followed by the summary of all changes.
+ *
+ * @return 0 on success, 1 if the diff could not be created.
+ */
+int print_plan (void);
+
+/**
+ * @brief Write all planned files whose content differs from the
+ * files in pam.d and drop the plan.
+ *
+ * @return 0 on success, 1 if a file could not be written.
+ */
+int plan_commit (void);
+
+/**
+ * @brief Drop all planned files and actions without writing them.
+ */
+void plan_discard (void);
+
+/**
+ * @struct vfs_t
+ * @brief Access to config files and PAM modules.
+ *
+ * The functions behave like their POSIX counterparts. open_read()
+ * opens a file for reading, replace() atomically replaces the
+ * content of a file, keeping the owner and mode of an existing one,
+ * scandir() returns the entries sorted with alphasort().
+ */
+typedef struct vfs {
+  const char *name;
+  FILE *(*open_read) (const char *path);
+  int (*replace) (const char *path, const char *buf, size_t len);
+  int (*stat) (const char *path, struct stat *st);
+  int (*lstat) (const char *path, struct stat *st);
+  ssize_t (*readlink) (const char *path, char *buf, size_t size);
+  int (*access) (const char *path, int mode);
+  int (*symlink) (const char *target, const char *path);
+  int (*link) (const char *from, const char *to);
+  int (*rename) (const char *from, const char *to);
+  int (*unlink) (const char *path);
+  int (*scandir) (const char *dir, struct dirent ***namelist,
+		  int (*filter) (const struct dirent *));
+} vfs_t;
+
+/**
+ * @brief The backend in use, vfs_posix by default. vfs_memory
+ * keeps all changes in memory and reads everything else from the
+ * real filesystem, which is never modified. Selected per thread.
+ */
+extern __thread const vfs_t *vfs;
+extern const vfs_t vfs_posix;
+extern const vfs_t vfs_memory;
+
+/**
+ * @brief Select the backend "posix" or "memory".
+ *
+ * @return 0 on success, -1 if \a name is unknown.
+ */
+int vfs_select (const char *name);
+
+/**
+ * @brief Create or replace a file of the memory backend, e.g. to
+ * build a tree which does not exist on disk.
+ */
+int vfs_memory_add_file (const char *path, const char *buf, size_t len);
+
+/**
+ * @brief Print all files, symlinks and removals of the memory
+ * backend, paths relative to \a prefix.
+ */
+void vfs_memory_dump (FILE *out, const char *prefix);
+
+/**
+ * @brief Directory the module paths are below, NULL for "/". Set
+ * by pam-config --module-root, which the testsuite passes so the
+ * same modules are installed on every host.
+ */
+extern __thread const char *module_root;
+
+/**
+ * @brief module_root, "" if it is not set.
+ */
+const char *vfs_module_root (void);
+
+/**
+ * @brief Check if a PAM module exists, \a path is absolute and
+ * taken below vfs_module_root. The memory backend answers for
+ * modules added with vfs_memory_add_file().
+ */
+int vfs_have_module (const char *path);
+
+#if defined(__LP64__)
+#define PAM_MODULE_DIR "/lib64/security"
+#else
+#define PAM_MODULE_DIR "/lib/security"
+#endif
+
+/**
+ * @brief The backend doing the work, vfs itself unless --stats
+ * or --trace count the calls.
+ */
+const vfs_t *vfs_backend (void);
+
+/**
+ * @brief Phases of a run for --stats. File writes and renames are
+ * always charged to STATS_COMMIT.
+ */
+enum stats_phase {
+  STATS_GETOPT,
+  STATS_LOAD,
+  STATS_PROBE,    /* check_for_pam_module() */
+  STATS_SANITY,
+  STATS_RENDER,
+  STATS_COMMIT,
+  STATS_RELINK,
+  STATS_OTHER,
+  STATS_NPHASES
+};
+
+typedef struct {
+  unsigned long open;
+  unsigned long read_bytes;
+  unsigned long write;
+  unsigned long write_bytes;
+  unsigned long stat;
+  unsigned long access;
+  unsigned long rename;
+  unsigned long link;
+  unsigned long unlink;
+  unsigned long scandir;
+} stats_counters_t;
+
+extern int stats_enabled;
+extern stats_counters_t stats_counters;
+
+/**
+ * @brief Enable --stats: count the vfs calls and print a summary
+ * at exit to stderr or, if \a file is not NULL, append it to
+ * \a file. Has to be called after the vfs backend is selected.
+ *
+ * @return 0 on success, -1 if \a file cannot be opened.
+ */
+int stats_enable (const char *file);
+
+/**
+ * @brief Install the counting vfs backend, which also emits the
+ * --trace spans of the file access. Does nothing if it is installed
+ * already.
+ */
+void stats_count_vfs (void);
+
+/**
+ * @brief Charge the time from now on to \a phase.
+ *
+ * @return The phase before, to be passed back to STATS_PHASE().
+ */
+int stats_phase (int phase);
+void stats_module_begin (struct timespec *start);
+void stats_module_end (const char *name, const struct timespec *start);
+
+/* Without --stats, these cost only the test of stats_enabled.  */
+#define STATS_PHASE(phase) (stats_enabled ? stats_phase (phase) : 0)
+#define STATS_ADD(counter, n) \
+  do { if (stats_enabled) stats_counters.counter += (n); } while (0)
+#define STATS_MODULE_BEGIN(start) \
+  do { if (stats_enabled) stats_module_begin (&(start)); } while (0)
+#define STATS_MODULE_END(name, start) \
+  do { if (stats_enabled) stats_module_end (name, &(start)); } while (0)
+
+extern int trace_enabled;
+
+/**
+ * @brief Enable --trace: write every span as Trace Event JSON to
+ * \a file, which can be opened with Perfetto or chrome://tracing.
+ * Has to be called after the vfs backend is selected.
+ *
+ * @return 0 on success, -1 if \a file cannot be created.
+ */
+int trace_enable (const char *file);
+void trace_begin (struct timespec *start);
+/**
+ * @brief Write the span \a name from \a start until now. \a module
+ * and \a path may be NULL, \a type is a write_type_t or -1.
+ */
+void trace_end (const struct timespec *start, const char *name,
+		const char *module, int type, const char *path);
+
+/* Without --trace, these cost only the test of trace_enabled.  */
+#define TRACE_BEGIN(start) \
+  do { if (trace_enabled) trace_begin (&(start)); } while (0)
+#define TRACE_END(start, name, module, type, path) \
+  do { if (trace_enabled) trace_end (&(start), name, module, type, path); } \
+  while (0)
+
 int sanitize_check_account (pam_module_t **module_list, int verify);
 int sanitize_check_auth (pam_module_t **module_list, int verify);
 int sanitize_check_password (pam_module_t **module_list, int verify);
 int sanitize_check_session (pam_module_t **module_list, int verify);
 int check_for_pam_module (const char *name, int force);
+int is_pam_module_installed (const char *name);
 
 #endif
@@ -33,13 +33,20 @@ static void
 def_print_module_type (pam_module_t *this, write_type_t type)
 {
   option_set_t *opt_set = this->get_opt_set (this, type);
+  size_t i;
 
   if (!opt_set->is_enabled (opt_set, "is_enabled"))
     return;
 
   printf ("%s:", type2string( type ) );
-  for_each_bool_opt( opt_set,  &print_bool_opt );
-  for_each_string_opt( opt_set, &print_string_opt );
+  /* is_enabled is internal key.  */
+  for (i = 0; opt_set->bool_keys[i] != NULL; i++)
+    if (opt_set->bool_values[i] &&
+	strcmp (opt_set->bool_keys[i], "is_enabled") != 0)
+      printf (" %s", opt_set->bool_keys[i]);
+  for (i = 0; opt_set->string_keys[i] != NULL; i++)
+    if (opt_set->string_values[i])
+      printf (" %s=%s", opt_set->string_keys[i], opt_set->string_values[i]);
   printf( "\n" );
 }
 
@@ -149,11 +156,124 @@ print_unknown_option_error (const char *module, const char *option)
   /* TRANSLATORS: first argument is name of a PAM module */
   fprintf (stderr, _("Unknown option for %s, ignored: '%s'\n"),
 	   module, option);
+  config_warnings++;
 }
 
 option_set_t*
 get_opt_set( pam_module_t *this, write_type_t op ){
-  return (this->option_sets)[op];
+  return state_opt_set (NULL, this->schema, op);
+}
+
+/* Index "unix2" -> &mod_pam_unix2 for module_getopt(), built the
+   first time a module list is used, so that every command line
+   option costs one hash probe instead of an asprintf and a scan of
+   the whole list. The getopt function of the module then finds the
+   option with the index of its schema, see option_set.h.  */
+struct getopt_index {
+  pam_module_t **module_list;
+  pam_module_t **table;
+  size_t mask;
+  struct getopt_index *next;
+};
+
+static struct getopt_index *getopt_indexes;
+
+static size_t
+hash_short_name (const char *name, size_t len)
+{
+  size_t hash = 5381;
+
+  while (len--)
+    hash = hash * 33 + (unsigned char) *name++;
+
+  return hash;
+}
+
+/* "pam_unix2.so" -> "unix2", len 5.  */
+static const char *
+short_module_name (const pam_module_t *mod, size_t *len)
+{
+  size_t namelen = strlen (mod->name);
+
+  if (namelen < 7 || strncmp (mod->name, "pam_", 4) != 0 ||
+      strcmp (&mod->name[namelen - 3], ".so") != 0)
+    return NULL;
+
+  *len = namelen - 7;
+  return &mod->name[4];
+}
+
+static struct getopt_index *
+get_getopt_index (pam_module_t **module_list)
+{
+  struct getopt_index *idx;
+  size_t count = 0, size = 8, i;
+
+  for (idx = getopt_indexes; idx != NULL; idx = idx->next)
+    if (idx->module_list == module_list)
+      return idx;
+
+  while (module_list[count] != NULL)
+    count++;
+  while (size < 2 * count)
+    size *= 2;
+
+  idx = malloc (sizeof (struct getopt_index));
+  if (idx == NULL)
+    return NULL;
+  idx->table = calloc (size, sizeof (pam_module_t *));
+  if (idx->table == NULL)
+    {
+      free (idx);
+      return NULL;
+    }
+  idx->module_list = module_list;
+  idx->mask = size - 1;
+
+  for (i = 0; i < count; i++)
+    {
+      const char *name;
+      size_t len, slot;
+
+      if (module_list[i]->getopt == NULL ||
+	  (name = short_module_name (module_list[i], &len)) == NULL)
+	continue;
+
+      slot = hash_short_name (name, len) & idx->mask;
+      while (idx->table[slot] != NULL)
+	slot = (slot + 1) & idx->mask;
+      idx->table[slot] = module_list[i];
+    }
+
+  idx->next = getopt_indexes;
+  getopt_indexes = idx;
+
+  return idx;
+}
+
+static pam_module_t *
+lookup_getopt_module (pam_module_t **module_list, const char *name)
+{
+  struct getopt_index *idx = get_getopt_index (module_list);
+  size_t namelen = strlen (name), slot;
+  pam_module_t *mod;
+
+  if (idx == NULL)
+    return NULL;
+
+  for (slot = hash_short_name (name, namelen) & idx->mask;
+       (mod = idx->table[slot]) != NULL; slot = (slot + 1) & idx->mask)
+    {
+      const char *short_name;
+      size_t len;
+
+      short_name = short_module_name (mod, &len);
+      if (short_name != NULL && len == namelen &&
+	  strncmp (short_name, name, len) == 0)
+	return mod;
+    }
+
+  return NULL;
 }
 
 /* return value: 0 for found, 1 for not found */
@@ -161,10 +281,12 @@ int
 module_getopt (pam_module_t **module_list, const char *optarg,
 	       global_opt_t *opt)
 {
+  pam_module_t *mod;
   char *work;
   char *name;
   char *arg;
   char *cp;
+  int retval;
 
   if (optarg[0] != '-' || optarg[1] != '-')
     return 1;
@@ -188,37 +310,19 @@ module_getopt (pam_module_t **module_list, const char *optarg,
   else
     work = "";
 
-  if (asprintf(&name, "pam_%s.so", name) < 0)
-    return 1;
-
   if (debug)
-    fprintf (stderr, "module=%s, option=%s, argument=%s\n", name, work, arg);
+    fprintf (stderr, "module=pam_%s.so, option=%s, argument=%s\n",
+	     name, work, arg);
 
-  while (*module_list != NULL)
-    {
-      int retval;
-
-      if (strcmp ((*module_list)->name, name) == 0 &&
-	  (*module_list)->getopt != NULL)
-        {
-	   retval = (*module_list)->getopt ((*module_list), work, arg, opt);
-           if (retval == 0)
-	     {
-	       free (name);
-	       return 0;
-	     }
-           else if (retval == 2) /* module not installed */
-             {
-               free (name);
-               return 2;
-             }
-        }
-      module_list++;
-    }
+  mod = lookup_getopt_module (module_list, name);
+  if (mod == NULL)
+    return 1;
 
-  free (name);
+  retval = mod->getopt (mod, work, arg, opt);
+  if (retval == 2) /* module not installed */
+    return 2;
 
-  return 1;
+  return retval == 0 ? 0 : 1;
 }
 
 void
@@ -57,6 +57,26 @@ typedef struct {
 } module_helptext_t;
 
 
+/**
+ * @struct option_schema
+ * @brief The options of a module.
+ *
+ * Constant, the module registry keeps the position of the values
+ * in an option state and the index of the names (see
+ * new_option_state()).
+ */
+/**
+ * @typedef option_schema_t
+ * @brief Creates a type for option_schema
+ */
+typedef struct option_schema {
+  const char *const *bool_keys;   /**< NULL terminated names of the boolean options. */
+  const char *const *string_keys; /**< NULL terminated names of the string options. */
+  unsigned int types;             /**< TYPE_MASK() of every PAM type the module writes. */
+  const module_helptext_t *helptxt; /**< Help text, may be NULL without print_xmlhelp. */
+} option_schema_t;
+
+
 /**
  * @def TRUE
  * @brief Conveniance definition of boolean value TRUE.
@@ -73,281 +93,47 @@ typedef struct {
 
 #define DEBUG(args...)  fprintf( stderr, "%s [%d]: ", __FILE__, __LINE__ );fprintf( stderr, args )
 
-#define OPT_NAME(PREFIX, NAME) PREFIX ## _opt_ ## NAME
-
-#define INIT_OPT_1(PREFIX,TYPE,DEFAULT,a)	        static TYPE ## _option_t OPT_NAME(PREFIX,a) = { #a, DEFAULT }
-#define INIT_OPT_2(PREFIX,TYPE,DEFAULT,a,b)	        INIT_OPT_1(PREFIX,TYPE,DEFAULT,a);       INIT_OPT_1(PREFIX,TYPE,DEFAULT,b)
-#define INIT_OPT_3(PREFIX,TYPE,DEFAULT,a,b,c)	        INIT_OPT_2(PREFIX,TYPE,DEFAULT,a,b);     INIT_OPT_1(PREFIX,TYPE,DEFAULT,c)
-#define INIT_OPT_4(PREFIX,TYPE,DEFAULT,a,b,c,d)         INIT_OPT_2(PREFIX,TYPE,DEFAULT,a,b);     INIT_OPT_2(PREFIX,TYPE,DEFAULT,c,d)
-#define INIT_OPT_5(PREFIX,TYPE,DEFAULT,a,b,c,d,e)       INIT_OPT_4(PREFIX,TYPE,DEFAULT,a,b,c,d); INIT_OPT_1(PREFIX,TYPE,DEFAULT,e)
-#define INIT_OPT_6(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f)     INIT_OPT_4(PREFIX,TYPE,DEFAULT,a,b,c,d); INIT_OPT_2(PREFIX,TYPE,DEFAULT,e,f)
-#define INIT_OPT_7(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g)   INIT_OPT_4(PREFIX,TYPE,DEFAULT,a,b,c,d); INIT_OPT_3(PREFIX,TYPE,DEFAULT,e,f,g)
-#define INIT_OPT_8(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h) INIT_OPT_4(PREFIX,TYPE,DEFAULT,a,b,c,d); INIT_OPT_4(PREFIX,TYPE,DEFAULT,e,f,g,h)
-#define INIT_OPT_9(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h,i)      INIT_OPT_5(PREFIX,TYPE,DEFAULT,a,b,c,d,e); INIT_OPT_4(PREFIX,TYPE,DEFAULT,f,g,h,i)
-#define INIT_OPT_10(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h,i,j)   INIT_OPT_5(PREFIX,TYPE,DEFAULT,a,b,c,d,e); INIT_OPT_5(PREFIX,TYPE,DEFAULT,f,g,h,i,j)
-#define INIT_OPT_11(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h,i,j,k) INIT_OPT_6(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f); INIT_OPT_5(PREFIX,TYPE,DEFAULT,g,h,i,j,k)
-#define INIT_OPT_14(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h,i,j,k,l,m,n) INIT_OPT_8(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h); INIT_OPT_6(PREFIX,TYPE,DEFAULT,i,j,k,l,m,n)
-#define INIT_OPT_15(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h,i,j,k,l,m,n,o) INIT_OPT_8(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h); INIT_OPT_7(PREFIX,TYPE,DEFAULT,i,j,k,l,m,n,o)
-#define INIT_OPT_16(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p) INIT_OPT_8(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h); INIT_OPT_8(PREFIX,TYPE,DEFAULT,i,j,k,l,m,n,o,p)
-#define INIT_OPT_17(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p,q) INIT_OPT_8(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h); INIT_OPT_9(PREFIX,TYPE,DEFAULT,i,j,k,l,m,n,o,p,q)
-
-#define OPT_SET_START(PREFIX, TYPE) static TYPE ## _option_t * PREFIX ## _ ## TYPE ## _opts[] = {
-#define OPT_SET_END NULL }
-
-#define OPT_SET_BODY_1(PREFIX, a)	    &OPT_NAME(PREFIX, a)
-#define OPT_SET_BODY_2(PREFIX, a,b)	    OPT_SET_BODY_1(PREFIX,a),   OPT_SET_BODY_1(PREFIX, b)
-#define OPT_SET_BODY_3(PREFIX, a,b,c)	    OPT_SET_BODY_2(PREFIX,a,b), OPT_SET_BODY_1(PREFIX, c)
-#define OPT_SET_BODY_4(PREFIX, a,b,c,d)	    OPT_SET_BODY_2(PREFIX,a,b), OPT_SET_BODY_2(PREFIX, c,d)
-#define OPT_SET_BODY_5(PREFIX, a,b,c,d,e)   OPT_SET_BODY_2(PREFIX,a,b), OPT_SET_BODY_3(PREFIX, c,d,e)
-#define OPT_SET_BODY_6(PREFIX, a,b,c,d,e,f) OPT_SET_BODY_2(PREFIX,a,b), OPT_SET_BODY_4(PREFIX, c,d,e,f)
-#define OPT_SET_BODY_7(PREFIX, a,b,c,d,e,f,g) OPT_SET_BODY_2(PREFIX,a,b), OPT_SET_BODY_5(PREFIX, c,d,e,f,g)
-#define OPT_SET_BODY_8(PREFIX, a,b,c,d,e,f,g,h) OPT_SET_BODY_2(PREFIX,a,b), OPT_SET_BODY_6(PREFIX, c,d,e,f,g,h)
-#define OPT_SET_BODY_9(PREFIX, a,b,c,d,e,f,g,h,i) OPT_SET_BODY_3(PREFIX,a,b,c), OPT_SET_BODY_6(PREFIX, d,e,f,g,h,i)
-#define OPT_SET_BODY_10(PREFIX, a,b,c,d,e,f,g,h,i,j) OPT_SET_BODY_5(PREFIX,a,b,c,d,e), OPT_SET_BODY_5(PREFIX, f,g,h,i,j)
-#define OPT_SET_BODY_11(PREFIX, a,b,c,d,e,f,g,h,i,j,k) OPT_SET_BODY_5(PREFIX,a,b,c,d,e), OPT_SET_BODY_6(PREFIX, f,g,h,i,j,k)
-#define OPT_SET_BODY_14(PREFIX, a,b,c,d,e,f,g,h,i,j,k,l,m,n) OPT_SET_BODY_8(PREFIX,a,b,c,d,e,f,g,h), OPT_SET_BODY_6(PREFIX, i,j,k,l,m,n)
-#define OPT_SET_BODY_15(PREFIX, a,b,c,d,e,f,g,h,i,j,k,l,m,n,o) OPT_SET_BODY_8(PREFIX,a,b,c,d,e,f,g,h), OPT_SET_BODY_7(PREFIX, i,j,k,l,m,n,o)
-#define OPT_SET_BODY_16(PREFIX, a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p) OPT_SET_BODY_8(PREFIX,a,b,c,d,e,f,g,h), OPT_SET_BODY_8(PREFIX, i,j,k,l,m,n,o,p)
-#define OPT_SET_BODY_17(PREFIX, a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p,q) OPT_SET_BODY_8(PREFIX,a,b,c,d,e,f,g,h), OPT_SET_BODY_9(PREFIX, i,j,k,l,m,n,o,p,q)
-
-#define GENERIC_OPT_SET_1(PREFIX,TYPE,DEFAULT,a)	      INIT_OPT_1(PREFIX, TYPE, DEFAULT, a); \
-							      OPT_SET_START(PREFIX, TYPE) \
-							      OPT_SET_BODY_1(PREFIX,a),\
-							      OPT_SET_END
-
-#define GENERIC_OPT_SET_2(PREFIX,TYPE,DEFAULT, a, b)			\
-  INIT_OPT_2(PREFIX, TYPE, DEFAULT, a, b);				\
-  OPT_SET_START(PREFIX, TYPE)						\
-       OPT_SET_BODY_2(PREFIX,a, b),					\
-    OPT_SET_END
-
-#define GENERIC_OPT_SET_3(PREFIX, TYPE, DEFAULT, a, b, c)     INIT_OPT_3(PREFIX,TYPE,DEFAULT, a, b, c );\
-							      OPT_SET_START(PREFIX, TYPE) \
-							      OPT_SET_BODY_3(PREFIX,a,b,c),\
-							      OPT_SET_END
-#define GENERIC_OPT_SET_4(PREFIX, TYPE, DEFAULT, a, b, c, d)  INIT_OPT_4(PREFIX,TYPE,DEFAULT, a, b, c, d );\
-							      OPT_SET_START(PREFIX, TYPE) \
-							      OPT_SET_BODY_4(PREFIX,a,b,c,d),\
-							      OPT_SET_END
-#define GENERIC_OPT_SET_5(PREFIX, TYPE, DEFAULT, a, b,c,d,e)  INIT_OPT_5(PREFIX,TYPE,DEFAULT, a, b, c, d, e ); \
-							      OPT_SET_START(PREFIX, TYPE) \
-							      OPT_SET_BODY_5(PREFIX,a,b,c,d,e), \
-							      OPT_SET_END
-#define GENERIC_OPT_SET_6(PREFIX, TYPE, DEFAULT,a,b,c,d,e,f)  INIT_OPT_6(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f); \
-							      OPT_SET_START(PREFIX, TYPE) \
-							      OPT_SET_BODY_6(PREFIX,a,b,c,d,e,f), \
-							      OPT_SET_END
-#define GENERIC_OPT_SET_7(PREFIX, TYPE, DEFAULT,a,b,c,d,e,f,g) INIT_OPT_7(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g); \
-                                                               OPT_SET_START(PREFIX, TYPE)		      \
-							       OPT_SET_BODY_7(PREFIX,a,b,c,d,e,f,g), \
-							       OPT_SET_END
-#define GENERIC_OPT_SET_8(PREFIX, TYPE, DEFAULT,a,b,c,d,e,f,g,h)  INIT_OPT_8(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h); \
-							          OPT_SET_START(PREFIX, TYPE) \
-								  OPT_SET_BODY_8(PREFIX,a,b,c,d,e,f,g,h), \
-								  OPT_SET_END
-#define GENERIC_OPT_SET_10(PREFIX, TYPE, DEFAULT,a,b,c,d,e,f,g,h,i,j)  INIT_OPT_10(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h,i,j); \
-							          OPT_SET_START(PREFIX, TYPE) \
-							          OPT_SET_BODY_10(PREFIX,a,b,c,d,e,f,g,h,i,j), \
-								  OPT_SET_END
-#define GENERIC_OPT_SET_11(PREFIX, TYPE, DEFAULT,a,b,c,d,e,f,g,h,i,j,k)  INIT_OPT_11(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h,i,j,k); \
-							          OPT_SET_START(PREFIX, TYPE) \
-							          OPT_SET_BODY_11(PREFIX,a,b,c,d,e,f,g,h,i,j,k), \
-								  OPT_SET_END
-#define GENERIC_OPT_SET_14(PREFIX, TYPE, DEFAULT,a,b,c,d,e,f,g,h,i,j,k,l,m,n)  INIT_OPT_14(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h,i,j,k,l,m,n); \
-							          OPT_SET_START(PREFIX, TYPE) \
-							          OPT_SET_BODY_14(PREFIX,a,b,c,d,e,f,g,h,i,j,k,l,m,n), \
-								  OPT_SET_END
-
-#define GENERIC_OPT_SET_15(PREFIX, TYPE, DEFAULT,a,b,c,d,e,f,g,h,i,j,k,l,m,n,o) \
-                                                                  INIT_OPT_15(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h,i,j,k,l,m,n,o);     \
-                                                                  OPT_SET_START(PREFIX, TYPE) \
-                                                                  OPT_SET_BODY_15(PREFIX,a,b,c,d,e,f,g,h,i,j,k,l,m,n,o), \
-                                                                  OPT_SET_END
-#define GENERIC_OPT_SET_16(PREFIX, TYPE, DEFAULT,a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p) \
-                                                                  INIT_OPT_16(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p);	\
-							          OPT_SET_START(PREFIX, TYPE) \
-								  OPT_SET_BODY_16(PREFIX,a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p), \
-								  OPT_SET_END
-#define GENERIC_OPT_SET_17(PREFIX, TYPE, DEFAULT,a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p,q) \
-                                                                  INIT_OPT_17(PREFIX,TYPE,DEFAULT,a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p,q);	\
-							          OPT_SET_START(PREFIX, TYPE) \
-								  OPT_SET_BODY_17(PREFIX,a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p,q), \
-								  OPT_SET_END
-
-#define DECLARE_BOOL_OPTS_1(OPT_1)					\
-  GENERIC_OPT_SET_1( auth,	bool, BOOL_DEFAULT, OPT_1);		\
-  GENERIC_OPT_SET_1( account,	bool, BOOL_DEFAULT, OPT_1);		\
-  GENERIC_OPT_SET_1( password,	bool, BOOL_DEFAULT, OPT_1);		\
-  GENERIC_OPT_SET_1( session,	bool, BOOL_DEFAULT, OPT_1);
-
-#define DECLARE_BOOL_OPTS_2(OPT_1, OPT_2)			   \
-  GENERIC_OPT_SET_2( auth,	bool, BOOL_DEFAULT, OPT_1, OPT_2); \
-  GENERIC_OPT_SET_2( account,	bool, BOOL_DEFAULT, OPT_1, OPT_2); \
-  GENERIC_OPT_SET_2( password,	bool, BOOL_DEFAULT, OPT_1, OPT_2); \
-  GENERIC_OPT_SET_2( session,	bool, BOOL_DEFAULT, OPT_1, OPT_2);
-
-#define DECLARE_BOOL_OPTS_3(OPT_1, OPT_2, OPT_3)			\
-  GENERIC_OPT_SET_3( auth,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3); \
-  GENERIC_OPT_SET_3( account,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3); \
-  GENERIC_OPT_SET_3( password,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3); \
-  GENERIC_OPT_SET_3( session,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3);
-
-#define DECLARE_BOOL_OPTS_4(OPT_1, OPT_2, OPT_3, OPT_4)			\
-  GENERIC_OPT_SET_4( auth,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4); \
-  GENERIC_OPT_SET_4( account,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4); \
-  GENERIC_OPT_SET_4( password,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4); \
-  GENERIC_OPT_SET_4( session,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4);
-
-#define DECLARE_BOOL_OPTS_5(OPT_1, OPT_2, OPT_3, OPT_4, OPT_5)		\
-  GENERIC_OPT_SET_5( auth,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5); \
-  GENERIC_OPT_SET_5( account,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5); \
-  GENERIC_OPT_SET_5( password,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5); \
-  GENERIC_OPT_SET_5( session,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5);
-
-#define DECLARE_BOOL_OPTS_6(OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6)		\
-  GENERIC_OPT_SET_6( auth,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6); \
-  GENERIC_OPT_SET_6( account,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6); \
-  GENERIC_OPT_SET_6( password,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6); \
-  GENERIC_OPT_SET_6( session,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6);
-#define DECLARE_BOOL_OPTS_7(OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7)	\
-  GENERIC_OPT_SET_7( auth,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7); \
-  GENERIC_OPT_SET_7( account,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7); \
-  GENERIC_OPT_SET_7( password,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7); \
-  GENERIC_OPT_SET_7( session,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7);
-#define DECLARE_BOOL_OPTS_8(OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8) \
-  GENERIC_OPT_SET_8( auth,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8); \
-  GENERIC_OPT_SET_8( account,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8); \
-  GENERIC_OPT_SET_8( password,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8); \
-  GENERIC_OPT_SET_8( session,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8);
-#define DECLARE_BOOL_OPTS_10(OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10) \
-  GENERIC_OPT_SET_10( auth,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10); \
-  GENERIC_OPT_SET_10( account,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10); \
-  GENERIC_OPT_SET_10( password,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10); \
-  GENERIC_OPT_SET_10( session,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10);
-#define DECLARE_BOOL_OPTS_11(OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10, OPT_11) \
-  GENERIC_OPT_SET_11( auth,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10, OPT_11); \
-  GENERIC_OPT_SET_11( account,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10, OPT_11); \
-  GENERIC_OPT_SET_11( password,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10, OPT_11); \
-  GENERIC_OPT_SET_11( session,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10, OPT_11);
-
-#define DECLARE_BOOL_OPTS_15(OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10, OPT_11, OPT_12, OPT_13, OPT_14, OPT_15) \
-  GENERIC_OPT_SET_15( auth,     bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10, OPT_11, OPT_12, OPT_13, OPT_14, OPT_15); \
-  GENERIC_OPT_SET_15( account,  bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10, OPT_11, OPT_12, OPT_13, OPT_14, OPT_15); \
-  GENERIC_OPT_SET_15( password, bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10, OPT_11, OPT_12, OPT_13, OPT_14, OPT_15); \
-  GENERIC_OPT_SET_15( session,  bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10, OPT_11, OPT_12, OPT_13, OPT_14, OPT_15);
-#define DECLARE_BOOL_OPTS_16(OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10, OPT_11, OPT_12, OPT_13, OPT_14, OPT_15, OPT_16) \
-  GENERIC_OPT_SET_16( auth,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10, OPT_11, OPT_12, OPT_13, OPT_14, OPT_15, OPT_16); \
-  GENERIC_OPT_SET_16( account,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10, OPT_11, OPT_12, OPT_13, OPT_14, OPT_15, OPT_16); \
-  GENERIC_OPT_SET_16( password,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10, OPT_11, OPT_12, OPT_13, OPT_14, OPT_15, OPT_16); \
-  GENERIC_OPT_SET_16( session,	bool, BOOL_DEFAULT, OPT_1, OPT_2, OPT_3, OPT_4, OPT_5, OPT_6, OPT_7, OPT_8, OPT_9, OPT_10, OPT_11, OPT_12, OPT_13, OPT_14, OPT_15, OPT_16);
-
-#define DECLARE_STRING_OPTS_0 DECLARE_STRING_OPTS_1( empty )
-#define DECLARE_STRING_OPTS_1(OPT_1)				 \
-  GENERIC_OPT_SET_1( auth,	string, STRING_DEFAULT, OPT_1 ); \
-  GENERIC_OPT_SET_1( account,	string, STRING_DEFAULT, OPT_1 ); \
-  GENERIC_OPT_SET_1( password,	string, STRING_DEFAULT, OPT_1 ); \
-  GENERIC_OPT_SET_1( session,	string, STRING_DEFAULT, OPT_1 );
-
-#define DECLARE_STRING_OPTS_2(OPT_1,OPT_2)				\
-  GENERIC_OPT_SET_2( auth,	string, STRING_DEFAULT, OPT_1, OPT_2 );	\
-  GENERIC_OPT_SET_2( account,	string, STRING_DEFAULT, OPT_1, OPT_2 );	\
-  GENERIC_OPT_SET_2( password,	string, STRING_DEFAULT, OPT_1, OPT_2 );	\
-  GENERIC_OPT_SET_2( session,	string, STRING_DEFAULT, OPT_1, OPT_2 );
-
-#define DECLARE_STRING_OPTS_3(OPT_1,OPT_2,OPT_3)			\
-  GENERIC_OPT_SET_3( auth,	string, STRING_DEFAULT,OPT_1,OPT_2,OPT_3); \
-  GENERIC_OPT_SET_3( account,	string, STRING_DEFAULT,OPT_1,OPT_2,OPT_3); \
-  GENERIC_OPT_SET_3( password,	string, STRING_DEFAULT,OPT_1,OPT_2,OPT_3); \
-  GENERIC_OPT_SET_3( session,	string, STRING_DEFAULT,OPT_1,OPT_2,OPT_3);
-
-#define DECLARE_STRING_OPTS_4(OPT_1,OPT_2,OPT_3,OPT_4)    \
-  GENERIC_OPT_SET_4( auth,      string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4);       \
-  GENERIC_OPT_SET_4( account,   string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4);       \
-  GENERIC_OPT_SET_4( password,  string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4);       \
-  GENERIC_OPT_SET_4( session,   string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4);
-
-#define DECLARE_STRING_OPTS_5(OPT_1,OPT_2,OPT_3,OPT_4,OPT_5)	\
-  GENERIC_OPT_SET_5( auth,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5);	\
-  GENERIC_OPT_SET_5( account,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5);	\
-  GENERIC_OPT_SET_5( password,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5);	\
-  GENERIC_OPT_SET_5( session,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5);
-
-#define DECLARE_STRING_OPTS_6(OPT_1,OPT_2,OPT_3,OPT_4,OPT_5,OPT_6)	\
-  GENERIC_OPT_SET_6( auth,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6 );	\
-  GENERIC_OPT_SET_6( account,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6 );	\
-  GENERIC_OPT_SET_6( password,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6 );	\
-  GENERIC_OPT_SET_6( session,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6 );
-
-#define DECLARE_STRING_OPTS_7(OPT_1,OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7)	\
-  GENERIC_OPT_SET_7( auth,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7 ); \
-  GENERIC_OPT_SET_7( account,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7 ); \
-  GENERIC_OPT_SET_7( password,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7 ); \
-  GENERIC_OPT_SET_7( session,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7 );
-
-#define DECLARE_STRING_OPTS_8(OPT_1,OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8)        \
-  GENERIC_OPT_SET_8( auth,      string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8 ); \
-  GENERIC_OPT_SET_8( account,   string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8 ); \
-  GENERIC_OPT_SET_8( password,  string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8 ); \
-  GENERIC_OPT_SET_8( session,   string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8 );
-
-#define DECLARE_STRING_OPTS_11(OPT_1,OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11) \
-  GENERIC_OPT_SET_11( auth,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11 ); \
-  GENERIC_OPT_SET_11( account,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11 ); \
-  GENERIC_OPT_SET_11( password,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11 ); \
-  GENERIC_OPT_SET_11( session,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11 );
-
-#define DECLARE_STRING_OPTS_14(OPT_1,OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14) \
-  GENERIC_OPT_SET_14( auth, string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14 ); \
-  GENERIC_OPT_SET_14( account,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14 ); \
-  GENERIC_OPT_SET_14( password,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14 ); \
-  GENERIC_OPT_SET_14( session,	string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14 );
-
-#define DECLARE_STRING_OPTS_15(OPT_1,OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14,OPT_15) \
-  GENERIC_OPT_SET_15( auth, string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14,OPT_15 ); \
-  GENERIC_OPT_SET_15( account,  string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14,OPT_15 ); \
-  GENERIC_OPT_SET_15( password, string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14,OPT_15 ); \
-  GENERIC_OPT_SET_15( session,  string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14,OPT_15 );
-
-#define DECLARE_STRING_OPTS_16(OPT_1,OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14,OPT_15,OPT_16) \
-  GENERIC_OPT_SET_16( auth, string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14,OPT_15,OPT_16 ); \
-  GENERIC_OPT_SET_16( account,  string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14,OPT_15,OPT_16 ); \
-  GENERIC_OPT_SET_16( password, string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14,OPT_15,OPT_16 ); \
-  GENERIC_OPT_SET_16( session,  string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14,OPT_15,OPT_16 );
-
-
-#define DECLARE_STRING_OPTS_17(OPT_1,OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14,OPT_15,OPT_16,OPT_17) \
-  GENERIC_OPT_SET_17( auth, string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14,OPT_15,OPT_16,OPT_17 ); \
-  GENERIC_OPT_SET_17( account,  string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14,OPT_15,OPT_16,OPT_17 ); \
-  GENERIC_OPT_SET_17( password, string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14,OPT_15,OPT_16,OPT_17 ); \
-  GENERIC_OPT_SET_17( session,  string, STRING_DEFAULT, OPT_1, OPT_2,OPT_3,OPT_4,OPT_5,OPT_6,OPT_7,OPT_8,OPT_9,OPT_10,OPT_11,OPT_12,OPT_13,OPT_14,OPT_15,OPT_16,OPT_17 );
-
-#define DECLARE_OPT_SETS						\
-  static option_set_t auth_opts	    = { auth_bool_opts,	    auth_string_opts,	  &is_enabled, &enable, &get_opt, &set_opt }; \
-  static option_set_t account_opts  = { account_bool_opts,  account_string_opts,  &is_enabled, &enable, &get_opt, &set_opt }; \
-  static option_set_t password_opts = { password_bool_opts, password_string_opts, &is_enabled, &enable, &get_opt, &set_opt }; \
-  static option_set_t session_opts  = { session_bool_opts,  session_string_opts,  &is_enabled, &enable, &get_opt, &set_opt }; \
-  static option_set_t *opt_sets[]   = { &auth_opts, &account_opts, &password_opts, &session_opts, NULL }
-
-
-#define WRITE_CONFIG_OPTIONS				\
-  bool_option_t **cur_bool_opt = opt_set->bool_opts;	\
-  string_option_t **cur_str_opt = opt_set->string_opts;	\
-							\
-  while (*cur_bool_opt != NULL)				\
-    {								\
-      if ((strcmp ((*cur_bool_opt)->key, "is_enabled") != 0)	\
-	  && ((*cur_bool_opt)->value == TRUE))			\
-	fprintf (fp, "%s ", (*cur_bool_opt)->key);		\
-      cur_bool_opt++;						\
-    }								\
-								\
-  while (*cur_str_opt != NULL)					\
-    {								\
-      if ((strcmp ((*cur_str_opt)->key, "empty") != 0)		\
-	  && ((*cur_str_opt)->value))					\
-	fprintf (fp, "%s=%s ", (*cur_str_opt)->key, (*cur_str_opt)->value); \
-      cur_str_opt++;							\
-    }									\
+/* The schema of a module: the names of its boolean and string
+   options, the PAM types it writes and its help text, e.g.
+
+     DECLARE_BOOL_OPTS ("is_enabled", "debug");
+     DECLARE_STRING_OPTS ("conffile", "envfile");
+     DECLARE_SCHEMA (TYPE_MASK (AUTH) | TYPE_MASK (SESSION), helptext);
+
+   The names are shared by the option sets of all four types. The
+   values are not part of the module, they live in an option state,
+   see get_opt_set().  */
+#define DECLARE_BOOL_OPTS(...)						\
+  static const char *const bool_keys[] = { __VA_ARGS__, NULL }
+#define DECLARE_STRING_OPTS(...)					\
+  static const char *const string_keys[] = { __VA_ARGS__, NULL }
+#define DECLARE_NO_STRING_OPTS						\
+  static const char *const string_keys[] = { NULL }
+
+#define DECLARE_SCHEMA(TYPES, HELPTXT)					\
+  static const option_schema_t schema = { bool_keys, string_keys, TYPES, HELPTXT }
+
+/**
+ * @def TYPE_MASK
+ * @brief The bit of a write_type_t in option_schema_t.types.
+ */
+#define TYPE_MASK(type) (1U << (type))
+#define ALL_TYPES (TYPE_MASK (AUTH) | TYPE_MASK (ACCOUNT) |		\
+		   TYPE_MASK (PASSWORD) | TYPE_MASK (SESSION))
+
+
+#define WRITE_CONFIG_OPTIONS						\
+  size_t cur_opt;							\
+									\
+  for (cur_opt = 0; opt_set->bool_keys[cur_opt] != NULL; cur_opt++)	\
+    if ((strcmp (opt_set->bool_keys[cur_opt], "is_enabled") != 0)	\
+	&& (opt_set->bool_values[cur_opt] == TRUE))			\
+      fprintf (fp, "%s ", opt_set->bool_keys[cur_opt]);		\
+									\
+  for (cur_opt = 0; opt_set->string_keys[cur_opt] != NULL; cur_opt++)	\
+    if (opt_set->string_values[cur_opt])				\
+      fprintf (fp, "%s=%s ", opt_set->string_keys[cur_opt],		\
+	       opt_set->string_values[cur_opt]);			\
 									\
   fprintf (fp, "\n");
 
@@ -382,31 +168,24 @@ static void			\
 print_args (pam_module_t *this)		\
 {                                        \
   option_set_t *opt_set = this->get_opt_set (this, AUTH); \
-  bool_option_t **cur_bool_opt = opt_set->bool_opts; \
-  string_option_t **cur_str_opt = opt_set->string_opts; \
+  size_t cur_opt; \
 \
   printf ("   --%s\n", modname);			\
 \
-  while (*cur_bool_opt != NULL) \
-    { \
-      if (strcmp ((*cur_bool_opt)->key, "is_enabled") != 0) \
-	printf ("   --%s-%s\n", modname, (*cur_bool_opt)->key);	\
-      cur_bool_opt++; \
-    } \
+  for (cur_opt = 0; opt_set->bool_keys[cur_opt] != NULL; cur_opt++) \
+    if (strcmp (opt_set->bool_keys[cur_opt], "is_enabled") != 0) \
+      printf ("   --%s-%s\n", modname, opt_set->bool_keys[cur_opt]); \
 \
-  while (*cur_str_opt != NULL) \
-    { \
-      if (strcmp ((*cur_str_opt)->key, "empty") != 0) \
-	printf ("   --%s-%s=<value>\n", modname, (*cur_str_opt)->key); \
-      cur_str_opt++; \
-    } \
+  for (cur_opt = 0; opt_set->string_keys[cur_opt] != NULL; cur_opt++) \
+    printf ("   --%s-%s=<value>\n", modname, opt_set->string_keys[cur_opt]); \
 }
 
 
 #define PRINT_XMLHELP(modname) \
-static module_helptext_t *search_key (pam_module_t *this, const char *key) \
+static const module_helptext_t *					\
+search_key (pam_module_t *this, const char *key)			\
 {									\
-  module_helptext_t *ptr = this->helptxt;				\
+  const module_helptext_t *ptr = this->schema->helptxt;		\
 									\
   while (ptr->option != NULL)						\
     {									\
@@ -422,9 +201,8 @@ static void								\
 print_xmlhelp (pam_module_t *this)					\
 {									\
   option_set_t *opt_set = this->get_opt_set (this, AUTH);		\
-  bool_option_t **cur_bool_opt = opt_set->bool_opts;			\
-  string_option_t **cur_str_opt = opt_set->string_opts;			\
-  module_helptext_t *helptxt;						\
+  const char *const *cur_key;						\
+  const module_helptext_t *helptxt;					\
 									\
   helptxt = search_key (this, "");					\
 									\
@@ -440,54 +218,46 @@ print_xmlhelp (pam_module_t *this)					\
   printf ("            </listitem>\n");					\
   printf ("          </varlistentry>\n");				\
 									\
-  while (*cur_bool_opt != NULL)						\
+  for (cur_key = opt_set->bool_keys; *cur_key != NULL; cur_key++)	\
     {									\
-      if (strcmp ((*cur_bool_opt)->key, "is_enabled") != 0)		\
+      if (strcmp (*cur_key, "is_enabled") != 0)				\
 	{								\
-	  helptxt = search_key (this, (*cur_bool_opt)->key);		\
+	  helptxt = search_key (this, *cur_key);		\
 									\
 	  printf ("          <varlistentry>\n");			\
 	  printf ("            <term><option>--%s-%s</option></term>\n", \
-		  modname, (*cur_bool_opt)->key);			\
+		  modname, *cur_key);			\
 	  printf ("            <listitem>\n");				\
 	  printf ("              <para>\n");				\
 	  if (helptxt && helptxt->helptxt)				\
 	    printf ("                %s\n", helptxt->helptxt);		\
 	  else								\
-	    printf ("                Add <option>%s</option> option to all %s invocations.\n", (*cur_bool_opt)->key, this->name); \
+	    printf ("                Add <option>%s</option> option to all %s invocations.\n", *cur_key, this->name); \
 	  printf ("              </para>\n");				\
 	  printf ("            </listitem>\n");				\
 	  printf ("          </varlistentry>\n");			\
 	}								\
-									\
-      cur_bool_opt++;							\
     }									\
-  while (*cur_str_opt != NULL)						\
+  for (cur_key = opt_set->string_keys; *cur_key != NULL; cur_key++)	\
     {									\
-      if ((strcmp ((*cur_str_opt)->key, "is_enabled") != 0) &&		\
-	(strcmp ((*cur_str_opt)->key, "empty") != 0))			\
-	{								\
-	  helptxt = search_key (this, (*cur_str_opt)->key);		\
-									\
-	  printf ("          <varlistentry>\n");			\
-	  if (helptxt && helptxt->arg)					\
-	    printf ("            <term><option>--%s-%s=</option><replaceable>%s</replaceable></term>\n", \
-		    modname, (*cur_str_opt)->key, helptxt->arg);	\
-	  else								\
-	    printf ("            <term><option>--%s-%s=</option><replaceable>value</replaceable></term>\n", \
-		    modname, (*cur_str_opt)->key);			\
-          printf ("            <listitem>\n");				\
-          printf ("              <para>\n");			       	\
-	  if (helptxt && helptxt->helptxt)				\
-	    printf ("                %s\n", helptxt->helptxt);		\
-	  else						\
-	    printf ("                Add <option>%s=</option><replaceable>value</replaceable> option to %s.\n", (*cur_str_opt)->key, this->name); \
-	  printf ("              </para>\n");				\
-	  printf ("            </listitem>\n");				\
-	  printf ("          </varlistentry>\n");			\
-	}								\
-									\
-      cur_str_opt++;							\
+      helptxt = search_key (this, *cur_key);		\
+								\
+      printf ("          <varlistentry>\n");			\
+      if (helptxt && helptxt->arg)					\
+        printf ("            <term><option>--%s-%s=</option><replaceable>%s</replaceable></term>\n", \
+		modname, *cur_key, helptxt->arg);	\
+      else								\
+        printf ("            <term><option>--%s-%s=</option><replaceable>value</replaceable></term>\n", \
+		modname, *cur_key);			\
+      printf ("            <listitem>\n");				\
+      printf ("              <para>\n");			       	\
+      if (helptxt && helptxt->helptxt)				\
+        printf ("                %s\n", helptxt->helptxt);		\
+      else						\
+        printf ("                Add <option>%s=</option><replaceable>value</replaceable> option to %s.\n", *cur_key, this->name); \
+      printf ("              </para>\n");				\
+      printf ("            </listitem>\n");				\
+      printf ("          </varlistentry>\n");			\
     }									\
 }
 
@@ -631,8 +401,7 @@ typedef enum write_type {
  */
 typedef struct pam_module {
 	char *name;		      /**< The name of the module. */
-	option_set_t **option_sets;   /**< Pointer to a NULL terminated list of options_set_t's. */
-        module_helptext_t *helptxt;  /**< Pointer to struct with help text. */
+	const option_schema_t *schema; /**< The options of the module. */
 	/** Pointer to parse function. */
 	int (*parse_config)(struct pam_module *this, char *arguments, write_type_t type);
 	/** Pointer to print function, used for debuging output. */
@@ -640,7 +409,7 @@ typedef struct pam_module {
 	/** Pointer to write function */
 	int (*write_config)(struct pam_module *this, enum write_type op,
 			    FILE *fp);
-	/** Accessor function for option_sets. */
+	/** Accessor function for the option sets. */
 	option_set_t* (*get_opt_set) (struct pam_module *this,
 				      write_type_t op);
 	/** Pointer to getopt function */
@@ -697,8 +466,10 @@ int def_write_config (pam_module_t *this, enum write_type op, FILE *fp);
 /**
  * @brief Accessor function.
  *
- * Used to access the \a option_set_t contained in the module instance
- * specified by \a this and \a op.
+ * Used to access the \a option_set_t of the module instance
+ * specified by \a this and \a op in the active option state: the
+ * state of the pamconfig_ctx_t of a libpamconfig call, otherwise
+ * the state of the pam-config command.
  *
  * @param this the module instance
  * @param op service type
@@ -766,11 +537,15 @@ void print_unknown_option_error (const char *module, const char *option);
  * @brief Searches through \a module_list and calls getopt()
  * on \a module if found.
  *
+ * The module is found with a hash index of \a module_list, which
+ * is built on the first call for that list.
+ *
  * @param module_list Pointer to the list of modules to search.
  * @param optarg Pointer to the option
  * @param opt Global commandline options
  *
- * @return 0 if module option is valid, 1 otherwise.
+ * @return 0 if module option is valid, 2 if the module is not
+ * installed, 1 otherwise.
  */
 int module_getopt (pam_module_t **module_list, const char *optarg,
 		   global_opt_t *opt);
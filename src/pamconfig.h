@@ -0,0 +1,179 @@
+/**
+ * @file pamconfig.h
+ * @brief The libpamconfig C API.
+ *
+ * A pamconfig_ctx_t holds the configuration directory, the service
+ * and the complete module state of one PAM configuration. Every
+ * context is independent of all others, several of them can be
+ * used by different threads at the same time. A single context
+ * must not be used by two threads at once.
+ *
+ * A typical session:
+ *
+ *   pamconfig_ctx_t *ctx = pamconfig_new ("/etc");
+ *
+ *   pamconfig_load (ctx, NULL);
+ *   pamconfig_enable (ctx, "pam_env.so", "session", NULL, 1);
+ *   if (pamconfig_verify (ctx) == 0)
+ *     pamconfig_commit (ctx);
+ *   pamconfig_free (ctx);
+ *
+ * All functions print their error messages to stderr like the
+ * pam-config command and return an error instead of exiting, also
+ * for unknown modules and options. The timings and counters of
+ * pam-config --stats and --trace are process-wide, the library
+ * does not record them.
+ */
+/* Copyright (C) 2020 Thorsten Kukuk
+   Author: Thorsten Kukuk <kukuk@thkukuk.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifndef _PAMCONFIG_H_
+#define _PAMCONFIG_H_ 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Version of this API, changed on incompatible changes.
+ */
+#define PAMCONFIG_API_VERSION 1
+
+/**
+ * @typedef pamconfig_ctx_t
+ * @brief Opaque handle of one PAM configuration.
+ */
+typedef struct pamconfig_ctx pamconfig_ctx_t;
+
+/**
+ * @brief Create a context for the configuration below \a confdir.
+ *
+ * @param confdir Absolute path of the directory containing
+ * pam.d, NULL for the system configuration.
+ *
+ * @return The new context, NULL if out of memory or \a confdir is
+ * not absolute.
+ */
+pamconfig_ctx_t *pamconfig_new (const char *confdir);
+
+/**
+ * @brief Free a context and all its state. Nothing is written.
+ */
+void pamconfig_free (pamconfig_ctx_t *ctx);
+
+/**
+ * @brief Use \a cachedir for the caches of this context, NULL
+ * disables them. Contexts for the system configuration use the
+ * default cache directory, all others none.
+ *
+ * @return 0 on success, -1 if \a cachedir is not absolute or out
+ * of memory.
+ */
+int pamconfig_set_cachedir (pamconfig_ctx_t *ctx, const char *cachedir);
+
+/**
+ * @brief Keep all files written by this context in memory, see
+ * pam-config --memfs. The memory file system is shared by all
+ * contexts using it.
+ */
+int pamconfig_use_memfs (pamconfig_ctx_t *ctx);
+
+/**
+ * @brief Print debug messages for calls on this context.
+ */
+void pamconfig_set_debug (pamconfig_ctx_t *ctx, int debug);
+
+/**
+ * @brief Load the common configuration or, if \a service is not
+ * NULL, the service file \a service into the context. The state
+ * loaded before is dropped.
+ *
+ * @return 0 on success, -1 if the files could not be loaded.
+ */
+int pamconfig_load (pamconfig_ctx_t *ctx, const char *service);
+
+/**
+ * @brief Query an option of \a module for the PAM type \a type
+ * ("account", "auth", "password" or "session").
+ *
+ * @param option Name of a boolean option, NULL for the module
+ * itself.
+ *
+ * @return 1 if enabled, 0 if not and -1 for an unknown module, type
+ * or option, or a type the module is never used for.
+ */
+int pamconfig_is_enabled (pamconfig_ctx_t *ctx, const char *module,
+			  const char *type, const char *option);
+
+/**
+ * @brief Query the value of the string option \a option.
+ *
+ * @return A copy of the value, which has to be freed by the caller,
+ * or NULL if the option is not set or unknown.
+ */
+char *pamconfig_get_string (pamconfig_ctx_t *ctx, const char *module,
+			    const char *type, const char *option);
+
+/**
+ * @brief Enable or disable a boolean option or, with \a option
+ * NULL, the module for \a type. Nothing is written before
+ * pamconfig_commit().
+ *
+ * @return 0 on success, -1 for an unknown module, type or option,
+ * or a type the module is never used for.
+ */
+int pamconfig_enable (pamconfig_ctx_t *ctx, const char *module,
+		      const char *type, const char *option, int value);
+
+/**
+ * @brief Set the string option \a option to \a value, NULL removes
+ * it.
+ *
+ * @return 0 on success, -1 for an unknown module, type or option.
+ */
+int pamconfig_set_string (pamconfig_ctx_t *ctx, const char *module,
+			  const char *type, const char *option,
+			  const char *value);
+
+/**
+ * @brief Run the sanity checks of pam-config --verify on the state
+ * of the context.
+ *
+ * @return 0 if the configuration is fine, 1 otherwise.
+ */
+int pamconfig_verify (pamconfig_ctx_t *ctx);
+
+/**
+ * @brief Print what pamconfig_commit() would change to stdout, in
+ * the format of pam-config --plan. Nothing is written.
+ *
+ * @return 0 on success, 1 on error.
+ */
+int pamconfig_plan (pamconfig_ctx_t *ctx);
+
+/**
+ * @brief Write the state of the context into the configuration
+ * files. Files whose content does not change are not written.
+ *
+ * @return 0 on success, 1 on error.
+ */
+int pamconfig_commit (pamconfig_ctx_t *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PAMCONFIG_H_ */
@@ -0,0 +1,577 @@
+/* Copyright (C) 2020 Thorsten Kukuk
+   Author: Thorsten Kukuk <kukuk@thkukuk.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pam-config.h"
+
+/* --plan: all files are written into memory instead of pam.d.
+   Later reads of a planned file see the new content, so modules
+   rewriting the same service file one after the other work as
+   usual. Symlinks, backups and renames are only recorded. At the
+   end a unified diff for every file and a summary with one
+   "plan<TAB>action<TAB>..." line per change are printed.  */
+
+#define DIFF_CONTEXT 3
+
+struct plan_file {
+  char *name;          /* relative to pam.d */
+  char *buf;
+  size_t len;
+  int backup;          /* keep the old file as name.old */
+  struct plan_file *next;
+};
+
+struct plan_action {
+  char *text;
+  struct plan_action *next;
+};
+
+__thread int plan_mode = FALSE;
+
+/* Every thread plans its own changes, a tail of NULL stands for
+   the head of the list.  */
+static __thread struct plan_file *plan_files;
+static __thread struct plan_file **plan_files_tail;
+static __thread struct plan_file *open_plan_file;
+static __thread struct plan_action *plan_actions;
+static __thread struct plan_action **plan_actions_tail;
+
+static struct plan_file *
+find_plan_file (const char *name)
+{
+  struct plan_file *pf;
+
+  for (pf = plan_files; pf != NULL; pf = pf->next)
+    if (strcmp (pf->name, name) == 0)
+      return pf;
+
+  return NULL;
+}
+
+FILE *
+plan_create_file (const char *name, int backup)
+{
+  struct plan_file *pf = find_plan_file (name);
+  FILE *fp;
+
+  if (pf == NULL)
+    {
+      pf = calloc (1, sizeof (struct plan_file));
+      if (pf == NULL || (pf->name = strdup (name)) == NULL)
+	{
+	  free (pf);
+	  fprintf (stderr, _("Out of memory\n"));
+	  return NULL;
+	}
+      *(plan_files_tail ? plan_files_tail : &plan_files) = pf;
+      plan_files_tail = &pf->next;
+    }
+
+  free (pf->buf);
+  pf->buf = NULL;
+  pf->len = 0;
+  pf->backup = backup;
+
+  fp = open_memstream (&pf->buf, &pf->len);
+  if (fp == NULL)
+    {
+      fprintf (stderr, _("Cannot create file handle: %m\n"));
+      return NULL;
+    }
+  open_plan_file = pf;
+
+  return fp;
+}
+
+int
+plan_close_file (FILE *fp)
+{
+  open_plan_file = NULL;
+
+  if (fclose (fp) != 0)
+    {
+      fprintf (stderr, _("Out of memory\n"));
+      return 1;
+    }
+
+  return 0;
+}
+
+FILE *
+plan_open_file (const char *name, int *planned)
+{
+  struct plan_file *pf = find_plan_file (name);
+
+  *planned = (pf != NULL && pf != open_plan_file);
+  if (!*planned || pf->len == 0)
+    return NULL;
+
+  return fmemopen (pf->buf, pf->len, "r");
+}
+
+int
+plan_has_file (const char *name)
+{
+  return find_plan_file (name) != NULL;
+}
+
+/* --service-stdin: the service file comes from stdin as planned
+   file, the planned content is written to stdout at the end.  */
+static __thread char *stdin_buf;
+static __thread size_t stdin_len;
+
+int
+plan_read_stdin (const char *name)
+{
+  char buf[4096];
+  FILE *in, *fp;
+  size_t n;
+
+  in = open_memstream (&stdin_buf, &stdin_len);
+  if (in == NULL)
+    {
+      fprintf (stderr, _("Cannot create file handle: %m\n"));
+      return 1;
+    }
+  while ((n = fread (buf, 1, sizeof (buf), stdin)) > 0)
+    fwrite (buf, 1, n, in);
+  if (ferror (stdin) || fclose (in) != 0)
+    {
+      fprintf (stderr, _("Cannot read stdin: %m\n"));
+      return 1;
+    }
+
+  fp = plan_create_file (name, FALSE);
+  if (fp == NULL)
+    return 1;
+  fwrite (stdin_buf, 1, stdin_len, fp);
+  return plan_close_file (fp);
+}
+
+int
+plan_write_stdout (const char *name, int changed_only)
+{
+  struct plan_file *pf = find_plan_file (name);
+  int changed;
+
+  if (pf == NULL)
+    return 1;
+
+  changed = (pf->len != stdin_len ||
+	     memcmp (pf->buf, stdin_buf, stdin_len) != 0);
+  if (changed_only)
+    puts (changed ? "changed" : "unchanged");
+  else
+    fwrite (pf->buf, 1, pf->len, stdout);
+
+  if (fflush (stdout) != 0)
+    {
+      fprintf (stderr, _("Cannot write stdout: %m\n"));
+      return 1;
+    }
+
+  return 0;
+}
+
+void
+plan_action (const char *fmt, ...)
+{
+  struct plan_action *pa, *prev;
+  va_list ap;
+  int n;
+
+  pa = malloc (sizeof (struct plan_action));
+  if (pa == NULL)
+    return;
+
+  va_start (ap, fmt);
+  n = vasprintf (&pa->text, fmt, ap);
+  va_end (ap);
+  if (n < 0)
+    {
+      free (pa);
+      return;
+    }
+
+  /* a service file is written once per module */
+  for (prev = plan_actions; prev != NULL; prev = prev->next)
+    if (strcmp (prev->text, pa->text) == 0)
+      {
+	free (pa->text);
+	free (pa);
+	return;
+      }
+
+  pa->next = NULL;
+  *(plan_actions_tail ? plan_actions_tail : &plan_actions) = pa;
+  plan_actions_tail = &pa->next;
+}
+
+/* Split buf into lines, the pointers point into buf.  */
+static size_t
+split_lines (char *buf, size_t len, char ***lines)
+{
+  size_t n = 0, i;
+  char *cp;
+
+  *lines = NULL;
+  if (len == 0)
+    return 0;
+
+  for (i = 0; i < len; i++)
+    if (buf[i] == '\n')
+      n++;
+  if (buf[len - 1] != '\n')
+    n++;
+
+  *lines = malloc (n * sizeof (char *));
+  if (*lines == NULL)
+    return 0;
+
+  for (i = 0, cp = buf; i < n; i++)
+    {
+      char *nl = memchr (cp, '\n', buf + len - cp);
+
+      (*lines)[i] = cp;
+      if (nl)
+	{
+	  *nl = '\0';
+	  cp = nl + 1;
+	}
+      else
+	buf[len] = '\0';
+    }
+
+  return n;
+}
+
+static char *
+read_disk_file (const char *name, size_t *len)
+{
+  char *file, *buf = NULL;
+  size_t size = 0;
+  FILE *fp, *out;
+
+  *len = 0;
+  if (asprintf (&file, "%s/pam.d/%s", confdir, name) < 0)
+    return NULL;
+  fp = vfs->open_read (file);
+  free (file);
+  if (fp == NULL)
+    return NULL;
+
+  out = open_memstream (&buf, &size);
+  if (out == NULL)
+    {
+      fclose (fp);
+      return NULL;
+    }
+  while (1)
+    {
+      char tmp[4096];
+      size_t n = fread (tmp, 1, sizeof (tmp), fp);
+
+      if (n == 0)
+	break;
+      fwrite (tmp, 1, n, out);
+    }
+  fclose (fp);
+  fclose (out);
+  *len = size;
+
+  return buf;
+}
+
+enum edit_op {
+  EDIT_KEEP,
+  EDIT_DEL,
+  EDIT_ADD
+};
+
+struct edit {
+  enum edit_op op;
+  size_t old_line;
+  size_t new_line;
+};
+
+/* Longest common subsequence, the files are small.  */
+static size_t
+diff_lines (char **a, size_t n, char **b, size_t m, struct edit **edits)
+{
+  size_t *lcs, i, j, k = 0;
+
+  lcs = calloc ((n + 1) * (m + 1), sizeof (size_t));
+  *edits = malloc ((n + m + 1) * sizeof (struct edit));
+  if (lcs == NULL || *edits == NULL)
+    {
+      free (lcs);
+      free (*edits);
+      *edits = NULL;
+      return 0;
+    }
+
+#define LCS(x, y) lcs[(x) * (m + 1) + (y)]
+  for (i = n; i-- > 0;)
+    for (j = m; j-- > 0;)
+      if (strcmp (a[i], b[j]) == 0)
+	LCS (i, j) = LCS (i + 1, j + 1) + 1;
+      else
+	LCS (i, j) = LCS (i + 1, j) > LCS (i, j + 1) ?
+	  LCS (i + 1, j) : LCS (i, j + 1);
+
+  i = j = 0;
+  while (i < n || j < m)
+    {
+      struct edit *e = &(*edits)[k++];
+
+      e->old_line = i;
+      e->new_line = j;
+      if (i < n && j < m && strcmp (a[i], b[j]) == 0)
+	{
+	  e->op = EDIT_KEEP;
+	  i++;
+	  j++;
+	}
+      else if (i < n && (j == m || LCS (i + 1, j) >= LCS (i, j + 1)))
+	{
+	  e->op = EDIT_DEL;
+	  i++;
+	}
+      else
+	{
+	  e->op = EDIT_ADD;
+	  j++;
+	}
+    }
+#undef LCS
+
+  free (lcs);
+  return k;
+}
+
+static void
+print_hunks (char **a, char **b, const struct edit *edits, size_t nedits)
+{
+  size_t start = 0;
+
+  while (start < nedits)
+    {
+      size_t first, last, end, i, old_count = 0, new_count = 0;
+
+      /* next change */
+      while (start < nedits && edits[start].op == EDIT_KEEP)
+	start++;
+      if (start == nedits)
+	break;
+
+      /* extend the hunk while changes are close together */
+      last = start;
+      for (i = start; i < nedits; i++)
+	{
+	  if (edits[i].op != EDIT_KEEP)
+	    last = i;
+	  else if (i - last > 2 * DIFF_CONTEXT)
+	    break;
+	}
+
+      first = start > DIFF_CONTEXT ? start - DIFF_CONTEXT : 0;
+      end = last + DIFF_CONTEXT + 1 < nedits ? last + DIFF_CONTEXT + 1 : nedits;
+
+      for (i = first; i < end; i++)
+	{
+	  if (edits[i].op != EDIT_ADD)
+	    old_count++;
+	  if (edits[i].op != EDIT_DEL)
+	    new_count++;
+	}
+
+      printf ("@@ -%zu,%zu +%zu,%zu @@\n",
+	      edits[first].old_line + (old_count ? 1 : 0), old_count,
+	      edits[first].new_line + (new_count ? 1 : 0), new_count);
+      for (i = first; i < end; i++)
+	{
+	  if (edits[i].op == EDIT_KEEP)
+	    printf (" %s\n", a[edits[i].old_line]);
+	  else if (edits[i].op == EDIT_DEL)
+	    printf ("-%s\n", a[edits[i].old_line]);
+	  else
+	    printf ("+%s\n", b[edits[i].new_line]);
+	}
+
+      start = end;
+    }
+}
+
+int
+print_plan (void)
+{
+  struct plan_file *pf;
+  struct plan_action *pa;
+  int retval = 0;
+
+  for (pf = plan_files; pf != NULL; pf = pf->next)
+    {
+      char *old, *new, **a, **b;
+      size_t old_len, n, m, nedits, i, added = 0, removed = 0;
+      struct edit *edits;
+      const char *action;
+
+      old = read_disk_file (pf->name, &old_len);
+      /* one more byte for a missing newline at the end */
+      new = malloc (pf->len + 1);
+      if (new == NULL)
+	{
+	  fprintf (stderr, _("Out of memory\n"));
+	  free (old);
+	  free (new);
+	  retval = 1;
+	  continue;
+	}
+      memcpy (new, pf->buf, pf->len);
+      if (old)
+	{
+	  char *tmp = realloc (old, old_len + 1);
+
+	  if (tmp)
+	    old = tmp;
+	}
+
+      n = split_lines (old, old_len, &a);
+      m = split_lines (new, pf->len, &b);
+      nedits = diff_lines (a, n, b, m, &edits);
+
+      for (i = 0; i < nedits; i++)
+	if (edits[i].op == EDIT_ADD)
+	  added++;
+	else if (edits[i].op == EDIT_DEL)
+	  removed++;
+
+      if (old == NULL)
+	action = "create";
+      else if (added || removed)
+	action = "modify";
+      else
+	action = "unchanged";
+
+      if (added || removed)
+	{
+	  printf ("--- %s/pam.d/%s\n", confdir, pf->name);
+	  printf ("+++ %s/pam.d/%s (planned)\n", confdir, pf->name);
+	  print_hunks (a, b, edits, nedits);
+	}
+      plan_action ("%s\t%s\t+%zu\t-%zu", action, pf->name, added, removed);
+
+      free (edits);
+      free (a);
+      free (b);
+      free (old);
+      free (new);
+    }
+
+  for (pa = plan_actions; pa != NULL; pa = pa->next)
+    printf ("plan\t%s\n", pa->text);
+
+  return retval;
+}
+
+void
+plan_discard (void)
+{
+  while (plan_files)
+    {
+      struct plan_file *pf = plan_files;
+
+      plan_files = pf->next;
+      free (pf->name);
+      free (pf->buf);
+      free (pf);
+    }
+  plan_files_tail = NULL;
+
+  while (plan_actions)
+    {
+      struct plan_action *pa = plan_actions;
+
+      plan_actions = pa->next;
+      free (pa->text);
+      free (pa);
+    }
+  plan_actions_tail = NULL;
+}
+
+int
+plan_commit (void)
+{
+  struct plan_file *pf;
+  int retval = 0, services = FALSE;
+
+  for (pf = plan_files; pf != NULL && retval == 0; pf = pf->next)
+    {
+      char *config, *oldfile = NULL;
+
+      if (asprintf (&config, "%s/pam.d/%s", confdir, pf->name) < 0)
+	{
+	  fprintf (stderr, _("Out of memory\n"));
+	  retval = 1;
+	  break;
+	}
+
+      if (config_has_content (config, pf->buf, pf->len))
+	{
+	  if (debug)
+	    printf ("*** %s unchanged, not written\n", config);
+	  free (config);
+	  continue;
+	}
+
+      if (pf->backup)
+	{
+	  if (asprintf (&oldfile, "%s.old", config) < 0)
+	    {
+	      fprintf (stderr, _("Out of memory\n"));
+	      free (config);
+	      retval = 1;
+	      break;
+	    }
+	  vfs->unlink (oldfile);
+	  vfs->link (config, oldfile);
+	  services = TRUE;
+	}
+
+      if (vfs->replace (config, pf->buf, pf->len) != 0)
+	retval = 1;
+
+      free (oldfile);
+      free (config);
+    }
+
+  /* the reverse module index does not know about the new files.  */
+  if (services)
+    free_module_index ();
+
+  plan_discard ();
+
+  return retval;
+}
@@ -0,0 +1,228 @@
+/* Copyright (C) 2020 Thorsten Kukuk
+   Author: Thorsten Kukuk <kukuk@thkukuk.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "pam-config.h"
+
+/* --query-all: print the complete state of all modules after one
+   parse of the config files. Everything is written directly from
+   the option sets, nothing is collected before.
+
+   kv format, one "key=value" per line:
+     symlink.common-auth=active
+     module.pam_unix.so.auth.enabled=1
+     module.pam_unix.so.auth.nullok=0
+     module.pam_unix.so.auth.remember=5
+
+   json format:
+     {"service":null,"symlinks":{"common-auth":"active",...},
+      "modules":{"pam_unix.so":{"auth":{"enabled":true,
+      "options":{"nullok":false,"remember":"5"}},...},...}}
+
+   Options are only printed for the types a module is enabled for,
+   string options only if they are set.  */
+
+static const char *symlinks[][2] = {
+  {CONF_ACCOUNT, CONF_ACCOUNT_PC},
+  {CONF_AUTH, CONF_AUTH_PC},
+  {CONF_PASSWORD, CONF_PASSWORD_PC},
+  {CONF_SESSION, CONF_SESSION_PC}
+};
+
+static void
+print_json_string (const char *str)
+{
+  putchar ('"');
+  for (; *str; str++)
+    {
+      unsigned char c = *str;
+
+      if (c == '"' || c == '\\')
+	printf ("\\%c", c);
+      else if (c < 0x20)
+	printf ("\\u%04x", c);
+      else
+	putchar (c);
+    }
+  putchar ('"');
+}
+
+/* "active" if file is a symlink to file_pc, "missing" if it does
+   not exist and "inactive" else.  */
+const char *
+symlink_status (const char *file, const char *file_pc)
+{
+  char *config, buf[1024];
+  const char *status;
+  struct stat st;
+  ssize_t n;
+
+  if (asprintf (&config, "%s/pam.d/%s", confdir, file) < 0)
+    return "unknown";
+
+  if (vfs->lstat (config, &st) != 0)
+    status = "missing";
+  else if (!S_ISLNK (st.st_mode) ||
+	   (n = vfs->readlink (config, buf, sizeof (buf) - 1)) <= 0)
+    status = "inactive";
+  else
+    {
+      buf[n] = '\0';
+      status = strcmp (basename (buf), file_pc) == 0 ? "active" : "inactive";
+    }
+  free (config);
+
+  return status;
+}
+
+static void
+print_module_type (pam_module_t *mod, write_type_t type, int json, int first)
+{
+  option_set_t *opt_set = mod->get_opt_set (mod, type);
+  int enabled = opt_set->is_enabled (opt_set, "is_enabled");
+  int first_opt = TRUE;
+  size_t i;
+
+  if (json)
+    printf ("%s\"%s\":{\"enabled\":%s", first ? "" : ",",
+	    type2string (type), enabled ? "true" : "false");
+  else
+    printf ("module.%s.%s.enabled=%d\n", mod->name, type2string (type),
+	    enabled ? 1 : 0);
+
+  if (!enabled)
+    {
+      if (json)
+	putchar ('}');
+      return;
+    }
+
+  if (json)
+    printf (",\"options\":{");
+
+  for (i = 0; opt_set->bool_keys[i] != NULL; i++)
+    {
+      if (strcmp (opt_set->bool_keys[i], "is_enabled") == 0)
+	continue;
+      if (json)
+	{
+	  printf ("%s", first_opt ? "" : ",");
+	  print_json_string (opt_set->bool_keys[i]);
+	  printf (":%s", opt_set->bool_values[i] ? "true" : "false");
+	}
+      else
+	printf ("module.%s.%s.%s=%d\n", mod->name, type2string (type),
+		opt_set->bool_keys[i], opt_set->bool_values[i] ? 1 : 0);
+      first_opt = FALSE;
+    }
+
+  for (i = 0; opt_set->string_keys[i] != NULL; i++)
+    {
+      if (opt_set->string_values[i] == NULL)
+	continue;
+      if (json)
+	{
+	  printf ("%s", first_opt ? "" : ",");
+	  print_json_string (opt_set->string_keys[i]);
+	  putchar (':');
+	  print_json_string (opt_set->string_values[i]);
+	}
+      else
+	printf ("module.%s.%s.%s=%s\n", mod->name, type2string (type),
+		opt_set->string_keys[i], opt_set->string_values[i]);
+      first_opt = FALSE;
+    }
+
+  if (json)
+    printf ("}}");
+}
+
+int
+print_query_all (const char *service, int json)
+{
+  pam_module_t **module_list = service ? service_module_list :
+    common_module_list;
+  size_t i;
+
+  if (load_all_types (confdir, service, module_list) != 0)
+    {
+      if (service)
+	fprintf (stderr,
+		 _("\nCouldn't load config file '%s/pam.d/%s', aborted!\n"),
+		 confdir, service);
+      else
+	fprintf (stderr, _("\nCouldn't load config file, aborted!\n"));
+      return 1;
+    }
+
+  if (json)
+    {
+      printf ("{\"service\":");
+      if (service)
+	print_json_string (service);
+      else
+	printf ("null");
+    }
+
+  if (!service)
+    {
+      if (json)
+	printf (",\"symlinks\":{");
+      for (i = 0; i < sizeof (symlinks) / sizeof (symlinks[0]); i++)
+	{
+	  const char *status = symlink_status (symlinks[i][0], symlinks[i][1]);
+
+	  if (json)
+	    printf ("%s\"%s\":\"%s\"", i ? "," : "", symlinks[i][0], status);
+	  else
+	    printf ("symlink.%s=%s\n", symlinks[i][0], status);
+	}
+      if (json)
+	putchar ('}');
+    }
+
+  if (json)
+    printf (",\"modules\":{");
+  for (i = 0; module_list[i] != NULL; i++)
+    {
+      write_type_t type;
+
+      if (json)
+	{
+	  printf ("%s", i ? "," : "");
+	  print_json_string (module_list[i]->name);
+	  putchar (':');
+	  putchar ('{');
+	}
+      for (type = AUTH; type <= SESSION; type++)
+	print_module_type (module_list[i], type, json, type == AUTH);
+      if (json)
+	putchar ('}');
+    }
+  if (json)
+    printf ("}}\n");
+
+  return 0;
+}
@@ -23,6 +23,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #include "pam-config.h"
 #include "pam-module.h"
@@ -34,7 +35,7 @@ check_for_pam_module_path (const char *path, const char *name, int force)
 
   sprintf (module, "%s/%s", path, name);
 
-  if (access (module, F_OK) != 0)
+  if (!vfs_have_module (module))
     {
       if (force)
 	{
@@ -53,20 +54,20 @@ check_for_pam_module_path (const char *path, const char *name, int force)
   return 0;
 }
 
-int
-check_for_pam_module (const char *name, int force)
+static int
+probe_pam_module (const char *name, int force)
 {
 #if defined(__LP64__)
-  int i = check_for_pam_module_path ("/lib64/security", name, force);
+  int i = check_for_pam_module_path (PAM_MODULE_DIR, name, force);
 
   if (i > 0)
     return 1;
 
   /* Only print warning if 32bit PAM module is missing */
-  if (access("/lib/libpam.so.0", F_OK) == 0)
+  if (vfs_have_module ("/lib/libpam.so.0"))
     return check_for_pam_module_path ("/lib/security", name, 1);
 #else
-  int i = check_for_pam_module_path ("/lib/security", name, force);
+  int i = check_for_pam_module_path (PAM_MODULE_DIR, name, force);
 
   if (i > 0)
     return 1;
@@ -75,194 +76,378 @@ check_for_pam_module (const char *name, int force)
   return 0;
 }
 
-static int
-check_for_unix_conflict (pam_module_t **module_list, write_type_t op,
-			 int verify)
+int
+check_for_pam_module (const char *name, int force)
 {
-  int with_unix, with_unix2;
-  int retval = 0;
-
-  with_unix = is_module_enabled (module_list,
-				 "pam_unix.so", op );
-  with_unix2 = is_module_enabled (module_list,
-				  "pam_unix2.so", op );
-
-  if (with_unix && with_unix2 )
-    {
-      if (verify)
-	{
-	  fprintf (stderr,
-		   _("WARNING: pam_unix.so and pam_unix2.so enabled!\n"));
-	  retval = 1;
-	}
-      else
-	{
-	  fprintf (stderr, _("INFO: pam_unix.so and pam_unix2.so enabled in service %s,\nINFO: only pam_unix2.so will be enabled.\n"), type2string (op));
-	  pam_module_t *mod_unix = lookup (module_list, "pam_unix.so");
-	  if (mod_unix)
-	    {
-	      option_set_t *opt_set = mod_unix->get_opt_set (mod_unix, op);
-	      if (opt_set)
-		{
-		  opt_set->enable (opt_set, "is_enabled", FALSE);
-		}
-	      else
-		{
-		  fprintf(stderr, _("ERROR: Failed to disable pam_unix.so.\n"));
-		  retval = 1;
-		}
-	    }
-	  else
-	    {
-	      fprintf(stderr, _("ERROR: Failed to disable pam_unix.so.\n"));
-	      retval = 1;
-	    }
-	}
-      }
+  int phase = STATS_PHASE (STATS_PROBE);
+  struct timespec start;
+  int retval;
+
+  TRACE_BEGIN (start);
+  retval = probe_pam_module (name, force);
+  TRACE_END (start, "check_for_pam_module", name, -1, NULL);
+  STATS_PHASE (phase);
   return retval;
 }
 
+/* Like check_for_pam_module() without messages, only the module
+   directory of the native ABI counts.  */
 int
-sanitize_check_account (pam_module_t **module_list, int verify)
+is_pam_module_installed (const char *name)
 {
-  int with_ldap_auth, with_ldap_account, with_krb5;
-  int with_nam, with_winbind, with_localuser, with_sss;
-  option_set_t *opt_set;
-  int retval = 0;
+  char module[sizeof (PAM_MODULE_DIR) + strlen (name) + 1];
 
-  retval = check_for_unix_conflict (module_list, ACCOUNT, verify);
-  if (retval && !verify)
-    return retval;
+  sprintf (module, "%s/%s", PAM_MODULE_DIR, name);
 
-  with_ldap_account = is_module_enabled (module_list, "pam_ldap.so", ACCOUNT);
-  with_ldap_auth = is_module_enabled (module_list, "pam_ldap.so", AUTH);
-  with_krb5 = is_module_enabled (module_list, "pam_krb5.so", AUTH);
+  return vfs_have_module (module);
+}
+
+/* Relations between modules which are checked before a config is
+   written (fix mode) or by --verify. A rule fires if any module of
+   "when" is enabled and, for RULE_CONFLICTS, any module of "with"
+   is enabled too or, for RULE_REQUIRES, none of them. In verify
+   mode the verify message is printed and the check fails, the
+   number of failed rules is returned. In fix mode the rule's action
+   is taken.
+
+   All modules used in rules get a bit, the enabled state of the
+   config is read once into a bitmap per type, so evaluating a rule
+   is a few bit operations. New relations only need a new entry in
+   module_rules[].  */
+
+/* The type which gets checked, for rules valid for every type.  */
+#define SAME_TYPE -1
+#define MAX_RULE_MODULES 4
+#define MAX_RULE_BITS 64
+#define NUM_TYPES (SESSION + 1)
+
+enum rule_kind {
+  RULE_CONFLICTS,
+  RULE_REQUIRES
+};
+
+enum rule_action {
+  FIX_NONE,       /* print fix message, nothing else */
+  FIX_ABORT,      /* print fix message, config is not written */
+  FIX_DISABLE,    /* print fix message, disable module "fix" */
+  FIX_ENABLE,     /* print fix message, enable module "fix" */
+  FIX_REPLACE     /* print fix message, call replace hook */
+};
+
+struct rule_module {
+  const char *name;
+  int type;       /* write_type_t or SAME_TYPE */
+};
+
+struct module_rule {
+  int type;       /* checked for this write_type_t or SAME_TYPE */
+  enum rule_kind kind;
+  struct rule_module when[MAX_RULE_MODULES];
+  struct rule_module with[MAX_RULE_MODULES];
+  const char *verify_msg;
+  enum rule_action action;
+  const char *fix_msg;   /* may contain one %s for the type */
+  struct rule_module fix;
+  int (*replace) (pam_module_t **module_list);
+};
+
+static int replace_pwcheck_with_cracklib (pam_module_t **module_list);
+
+static const struct module_rule module_rules[] = {
+  {SAME_TYPE, RULE_CONFLICTS,
+   {{"pam_unix.so", SAME_TYPE}}, {{"pam_unix2.so", SAME_TYPE}},
+   N_("WARNING: pam_unix.so and pam_unix2.so enabled!\n"),
+   FIX_DISABLE,
+   N_("INFO: pam_unix.so and pam_unix2.so enabled in service %s,\nINFO: only pam_unix2.so will be enabled.\n"),
+   {"pam_unix.so", SAME_TYPE}, NULL},
+  {ACCOUNT, RULE_REQUIRES,
+   {{"pam_ldap.so", ACCOUNT}},
+   {{"pam_ldap.so", AUTH}, {"pam_krb5.so", AUTH}},
+   N_("ERROR: ldap-account_only is only allowed in combination with krb5.\nConfiguration not changed!\n"),
+   FIX_ABORT,
+   N_("ERROR: ldap-account_only is only allowed in combination with krb5.\nConfiguration not changed!\n"),
+   {NULL, 0}, NULL},
+  /* These modules require pam_localuser. Enable it automaticaly if
+     it is disabled. See also bnc#371558 .  */
+  {ACCOUNT, RULE_REQUIRES,
+   {{"pam_ldap.so", ACCOUNT}, {"pam_nam.so", ACCOUNT},
+    {"pam_winbind.so", ACCOUNT}, {"pam_sss.so", ACCOUNT}},
+   {{"pam_localuser.so", ACCOUNT}},
+   N_("WARNING: pam_localuser is not enabled!\n"),
+   FIX_ENABLE, NULL,
+   {"pam_localuser.so", ACCOUNT}, NULL},
+  {AUTH, RULE_REQUIRES,
+   {{"pam_ccreds.so", AUTH}},
+   {{"pam_ldap.so", AUTH}, {"pam_krb5.so", AUTH}},
+   N_("WARNING: pam_ccreds.so needs LDAP or Kerberos5, ignored\n"),
+   FIX_NONE,
+   N_("WARNING: pam_ccreds.so needs LDAP or Kerberos5, ignored\n"),
+   {NULL, 0}, NULL},
+  {PASSWORD, RULE_CONFLICTS,
+   {{"pam_pwcheck.so", PASSWORD}}, {{"pam_cracklib.so", PASSWORD}},
+   N_("WARNING: pam_pwcheck and pam_cracklib enabled!\n"),
+   FIX_REPLACE,
+   N_("INFO: pam_pwcheck.so and pam_cracklib.so enabled,\nINFO: only pam_cracklib.so will be used.\n"),
+   {NULL, 0}, replace_pwcheck_with_cracklib},
+  {SESSION, RULE_CONFLICTS,
+   {{"pam_selinux.so", SESSION}}, {{"pam_apparmor.so", SESSION}},
+   N_("ERROR: pam_apparmor and pam_selinux together is not allowed.\nConfiguration not changed!\n"),
+   FIX_ABORT,
+   N_("ERROR: pam_apparmor and pam_selinux together is not allowed.\nConfiguration not changed!\n"),
+   {NULL, 0}, NULL},
+};
+
+#define NUM_RULES (sizeof (module_rules) / sizeof (module_rules[0]))
+
+/* Masks of a rule: same_mask is checked against the type being
+   checked, type_mask[t] against type t.  */
+struct rule_masks {
+  uint64_t same_mask;
+  uint64_t type_mask[NUM_TYPES];
+};
+
+static const char *rule_modules[MAX_RULE_BITS];
+static unsigned int n_rule_modules;
+static struct rule_masks when_masks[NUM_RULES];
+static struct rule_masks with_masks[NUM_RULES];
+static int rules_broken = FALSE;
+static pthread_once_t rules_once = PTHREAD_ONCE_INIT;
 
-  if (with_ldap_account && !with_ldap_auth && !with_krb5)
+static int
+rule_module_bit (const char *name)
+{
+  unsigned int i;
+
+  for (i = 0; i < n_rule_modules; i++)
+    if (strcmp (rule_modules[i], name) == 0)
+      return i;
+
+  if (n_rule_modules == MAX_RULE_BITS)
+    return -1;
+  rule_modules[n_rule_modules] = name;
+  return n_rule_modules++;
+}
+
+static int
+compile_masks (const struct rule_module *modules, struct rule_masks *masks)
+{
+  int i;
+
+  for (i = 0; i < MAX_RULE_MODULES && modules[i].name != NULL; i++)
     {
-      fprintf (stderr,
-	       _("ERROR: ldap-account_only is only allowed in combination with krb5.\nConfiguration not changed!\n"));
-      if (verify)
-	retval = 1;
+      int bit = rule_module_bit (modules[i].name);
+
+      if (bit < 0)
+	return -1;
+      if (modules[i].type == SAME_TYPE)
+	masks->same_mask |= (uint64_t) 1 << bit;
       else
-	return 1;
+	masks->type_mask[modules[i].type] |= (uint64_t) 1 << bit;
     }
 
-  with_nam = is_module_enabled (module_list, "pam_nam.so", ACCOUNT);
-  with_sss = is_module_enabled (module_list, "pam_sss.so", ACCOUNT);
-  with_winbind = is_module_enabled (module_list, "pam_winbind.so", ACCOUNT);
-  with_localuser = is_module_enabled (module_list, "pam_localuser.so", ACCOUNT);
+  return 0;
+}
 
-  /*
-   * These modules require pam_localuser. Enable it automaticaly if it is disabled.
-   * See also bnc#371558 .
-   */
-  if( (with_ldap_account || with_nam || with_winbind || with_sss) && !with_localuser)
-  {
-    if (verify)
-      {
-	fprintf (stderr,
-		 _("WARNING: pam_localuser is not enabled!\n"));
-	retval = 1;
-      }
-    else
+static void
+compile_all_rules (void)
+{
+  size_t i;
+
+  for (i = 0; i < NUM_RULES; i++)
+    if (compile_masks (module_rules[i].when, &when_masks[i]) != 0 ||
+	compile_masks (module_rules[i].with, &with_masks[i]) != 0)
       {
-	pam_module_t *localuser_mod = lookup (module_list, "pam_localuser.so");
-	opt_set = localuser_mod->get_opt_set (localuser_mod, ACCOUNT);
-	opt_set->enable (opt_set, "is_enabled", TRUE);
+	fprintf (stderr, _("ERROR: Too many modules in sanity check rules.\n"));
+	rules_broken = TRUE;
+	return;
       }
-  }
-
-  return retval;
 }
 
-int
-sanitize_check_auth (pam_module_t **module_list, int verify)
+/* The masks are shared by all threads, they are compiled once.  */
+static int
+compile_rules (void)
 {
-  int with_ccreds, with_ldap, with_krb5;
-  int retval = 0;
+  pthread_once (&rules_once, &compile_all_rules);
 
-  retval = check_for_unix_conflict (module_list, AUTH, verify);
-  if (retval && !verify)
-    return retval;
+  return rules_broken ? -1 : 0;
+}
 
-  with_ccreds = is_module_enabled (module_list,
-				   "pam_ccreds.so", AUTH);
-  with_ldap = is_module_enabled (module_list,
-				 "pam_ldap.so", AUTH);
-  with_krb5 = is_module_enabled (module_list,
-				 "pam_krb5.so", AUTH);
+static void
+load_enabled_bitmap (pam_module_t **module_list, uint64_t enabled[NUM_TYPES])
+{
+  unsigned int i;
+  int t;
 
-  if (with_ccreds && !with_ldap && !with_krb5)
+  for (t = 0; t < NUM_TYPES; t++)
     {
-      fprintf (stderr,
-	       _("WARNING: pam_ccreds.so needs LDAP or Kerberos5, ignored\n"));
-      if (verify)
-	retval = 1;
+      enabled[t] = 0;
+      for (i = 0; i < n_rule_modules; i++)
+	if (is_module_enabled (module_list, rule_modules[i], t))
+	  enabled[t] |= (uint64_t) 1 << i;
     }
+}
 
-  return retval;
+static int
+any_enabled (const struct rule_masks *masks, const uint64_t enabled[NUM_TYPES],
+	     write_type_t op)
+{
+  int t;
+
+  if (enabled[op] & masks->same_mask)
+    return TRUE;
+  for (t = 0; t < NUM_TYPES; t++)
+    if (enabled[t] & masks->type_mask[t])
+      return TRUE;
+
+  return FALSE;
 }
 
-int
-sanitize_check_password (pam_module_t **module_list, int verify)
+static int
+set_rule_module (pam_module_t **module_list, const struct rule_module *rm,
+		 write_type_t op, int value, uint64_t enabled[NUM_TYPES])
 {
-  int with_pwcheck, with_cracklib;
+  write_type_t type = rm->type == SAME_TYPE ? op : (write_type_t) rm->type;
+  pam_module_t *mod = lookup (module_list, rm->name);
   option_set_t *opt_set;
+
+  if (mod == NULL || (opt_set = mod->get_opt_set (mod, type)) == NULL)
+    {
+      if (value)
+	fprintf (stderr, _("ERROR: Failed to enable %s.\n"), rm->name);
+      else
+	fprintf (stderr, _("ERROR: Failed to disable %s.\n"), rm->name);
+      return 1;
+    }
+
+  opt_set->enable (opt_set, "is_enabled", value);
+  if (value)
+    enabled[type] |= (uint64_t) 1 << rule_module_bit (rm->name);
+  else
+    enabled[type] &= ~((uint64_t) 1 << rule_module_bit (rm->name));
+
+  return 0;
+}
+
+/* Evaluate all rules for type op in table order.  */
+static int
+check_module_rules (pam_module_t **module_list, write_type_t op, int verify)
+{
+  uint64_t enabled[NUM_TYPES];
   int retval = 0;
+  size_t i;
 
-  retval = check_for_unix_conflict (module_list, PASSWORD, verify);
-  if (retval && !verify)
-    return retval;
+  if (compile_rules () != 0)
+    return 1;
 
-  with_pwcheck = is_module_enabled (module_list,
-				    "pam_pwcheck.so", PASSWORD);
-  with_cracklib = is_module_enabled (module_list,
-				     "pam_cracklib.so", PASSWORD);
+  load_enabled_bitmap (module_list, enabled);
 
-  if (with_pwcheck && with_cracklib)
+  for (i = 0; i < NUM_RULES; i++)
     {
+      const struct module_rule *rule = &module_rules[i];
+      int with;
+
+      if (rule->type != SAME_TYPE && rule->type != (int) op)
+	continue;
+
+      if (!any_enabled (&when_masks[i], enabled, op))
+	continue;
+      with = any_enabled (&with_masks[i], enabled, op);
+      if ((rule->kind == RULE_CONFLICTS && !with) ||
+	  (rule->kind == RULE_REQUIRES && with))
+	continue;
+
       if (verify)
 	{
-	  fprintf (stderr,
-		   _("WARNING: pam_pwcheck and pam_cracklib enabled!\n"));
-	  retval = 1;
+	  fputs (_(rule->verify_msg), stderr);
+	  retval++;
+	  continue;
 	}
-      else
+
+      if (rule->fix_msg)
+	fprintf (stderr, _(rule->fix_msg), type2string (op));
+
+      switch (rule->action)
 	{
-	  fprintf (stderr, _("INFO: pam_pwcheck.so and pam_cracklib.so enabled,\nINFO: only pam_cracklib.so will be used.\n"));
-
-	  pam_module_t *cracklib_mod = lookup (module_list, "pam_cracklib.so");
-	  pam_module_t *pwcheck_mod = lookup (module_list, "pam_pwcheck.so");
-	  option_set_t *pwcheck_opt_set =
-	    pwcheck_mod->get_opt_set (pwcheck_mod, PASSWORD);
-	  char *cpath;
-
-	  /* conf->use_cracklib = 1; */
-	  opt_set = cracklib_mod->get_opt_set (cracklib_mod, PASSWORD);
-	  opt_set->enable (opt_set, "is_enabled", TRUE);
-
-	  pwcheck_opt_set->enable (pwcheck_opt_set, "is_enabled", FALSE);
-
-	  cpath = opt_set->get_opt (opt_set, "dictpath");
-
-	  if (cpath == NULL)
-	    {
-	      /* If pam_cracklib has a path set and pam_pwcheck not, copy path
-		 to pam_pwcheck data. */
-	      cpath = pwcheck_opt_set->get_opt (pwcheck_opt_set, "cracklib_path");
-	      opt_set->set_opt (opt_set, "dictpath", cpath);
-	    }
-
-	  if (pwcheck_opt_set->is_enabled (pwcheck_opt_set, "debug"))
-	    {
-	      /* conf->cracklib_debug = 1; */
-	      opt_set->enable (opt_set, "debug", TRUE);
-	    }
+	case FIX_NONE:
+	  break;
+	case FIX_ABORT:
+	  return 1;
+	case FIX_DISABLE:
+	case FIX_ENABLE:
+	  if (set_rule_module (module_list, &rule->fix, op,
+			       rule->action == FIX_ENABLE, enabled) != 0)
+	    return 1;
+	  break;
+	case FIX_REPLACE:
+	  if (rule->replace (module_list) != 0)
+	    return 1;
+	  load_enabled_bitmap (module_list, enabled);
+	  break;
 	}
     }
 
-  if (with_cracklib)
+  return retval;
+}
+
+static int
+replace_pwcheck_with_cracklib (pam_module_t **module_list)
+{
+  pam_module_t *cracklib_mod = lookup (module_list, "pam_cracklib.so");
+  pam_module_t *pwcheck_mod = lookup (module_list, "pam_pwcheck.so");
+  option_set_t *opt_set, *pwcheck_opt_set;
+  char *cpath;
+
+  if (cracklib_mod == NULL || pwcheck_mod == NULL)
+    return 1;
+
+  pwcheck_opt_set = pwcheck_mod->get_opt_set (pwcheck_mod, PASSWORD);
+
+  /* conf->use_cracklib = 1; */
+  opt_set = cracklib_mod->get_opt_set (cracklib_mod, PASSWORD);
+  opt_set->enable (opt_set, "is_enabled", TRUE);
+
+  pwcheck_opt_set->enable (pwcheck_opt_set, "is_enabled", FALSE);
+
+  cpath = opt_set->get_opt (opt_set, "dictpath");
+
+  if (cpath == NULL)
+    {
+      /* If pam_cracklib has a path set and pam_pwcheck not, copy path
+	 to pam_pwcheck data. */
+      cpath = pwcheck_opt_set->get_opt (pwcheck_opt_set, "cracklib_path");
+      opt_set->set_opt (opt_set, "dictpath", cpath ? strdup (cpath) : NULL);
+    }
+
+  if (pwcheck_opt_set->is_enabled (pwcheck_opt_set, "debug"))
+    {
+      /* conf->cracklib_debug = 1; */
+      opt_set->enable (opt_set, "debug", TRUE);
+    }
+
+  return 0;
+}
+
+int
+sanitize_check_account (pam_module_t **module_list, int verify)
+{
+  return check_module_rules (module_list, ACCOUNT, verify);
+}
+
+int
+sanitize_check_auth (pam_module_t **module_list, int verify)
+{
+  return check_module_rules (module_list, AUTH, verify);
+}
+
+int
+sanitize_check_password (pam_module_t **module_list, int verify)
+{
+  int retval = check_module_rules (module_list, PASSWORD, verify);
+
+  if (retval && !verify)
+    return retval;
+
+  if (is_module_enabled (module_list, "pam_cracklib.so", PASSWORD))
   {
     pam_module_t *cracklib_mod = lookup (module_list, "pam_cracklib.so");
     option_set_t *cracklib_opt_set = cracklib_mod->get_opt_set (cracklib_mod, PASSWORD);
@@ -279,25 +464,5 @@ sanitize_check_password (pam_module_t **module_list, int verify)
 int
 sanitize_check_session (pam_module_t **module_list, int verify)
 {
-  int with_selinux, with_apparmor;
-  int retval = 0;
-
-  retval = check_for_unix_conflict (module_list, SESSION, verify);
-  if (retval && !verify)
-    return retval;
-
-  with_selinux = is_module_enabled (module_list, "pam_selinux.so", SESSION);
-  with_apparmor = is_module_enabled (module_list, "pam_apparmor.so", SESSION);
-
-  if (with_selinux && with_apparmor)
-    {
-      fprintf (stderr,
-	       _("ERROR: pam_apparmor and pam_selinux together is not allowed.\nConfiguration not changed!\n"));
-      if (verify)
-	retval = 1;
-      else
-	return 1;
-    }
-
-  return retval;
+  return check_module_rules (module_list, SESSION, verify);
 }
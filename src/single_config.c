@@ -48,7 +48,23 @@ load_single_config (const char *config_name, config_content_t **ptr)
   if (debug)
     printf ("*** load_single_config (%s)\n", file);
 
-  fp = fopen(file, "r");
+  if (plan_mode)
+    {
+      int planned;
+
+      fp = plan_open_file (config_name, &planned);
+      if (planned && fp == NULL)
+	{
+	  /* planned, but empty */
+	  free (file);
+	  return 0;
+	}
+    }
+  else
+    fp = NULL;
+
+  if (fp == NULL)
+    fp = vfs->open_read (file);
   if (fp == NULL)
     {
       int err = errno;
@@ -70,6 +86,19 @@ load_single_config (const char *config_name, config_content_t **ptr)
       if (n < 1)
         break;
 
+      /* the last line may miss the newline, the next line written
+	 after it would be joined to it.  */
+      if (buf[n - 1] != '\n')
+	{
+	  char *tmp = realloc (buf, n + 2);
+
+	  if (tmp == NULL)
+	    break;
+	  buf = tmp;
+	  buflen = n + 2;
+	  strcpy (buf + n, "\n");
+	}
+
       if (debug)
 	printf ("READ: %s", buf);
 
@@ -116,111 +145,73 @@ write_single_config (const char *service, config_content_t **cfg_content)
 int
 insert_if (config_content_t **cfg, const char *line, int (*predicate)(config_content_t *next), insert_pos_t position)
 {
-  config_content_t *prev = NULL, *new_element = NULL, **head;
-  config_content_t *cfg_content = *cfg;
-  int result = FALSE, inserted = FALSE;
-
-  if (debug) {
-      char *l = strdup(line);
-      printf("**** insert_if (%s)**** \n", strtok(l, "\n"));
-      free(l);
-  }
+  config_content_t **link;
+
+  if (debug)
+    printf ("**** insert_if (%.*s)**** \n", (int) strcspn (line, "\n"), line);
 
-  /* save the list head */
-  head = cfg;
-  while (cfg_content != NULL && !inserted)
+  /* link is the pointer to the current line, so inserting before
+     the head only changes *cfg.  */
+  for (link = cfg; *link != NULL; link = &(*link)->next)
   {
+    config_content_t *cfg_content = *link;
+
     if (predicate (cfg_content))
     {
-      new_element = malloc (sizeof (config_content_t));
-      if (new_element)
+      config_content_t *new_element = malloc (sizeof (config_content_t));
+
+      if (new_element == NULL || (new_element->line = strdup (line)) == NULL)
       {
-	new_element->line = strdup ( line );
-	if (position==BEFORE)
-	{
-	  if (prev)
-	  {
-	    new_element->next = cfg_content;
-	    prev->next = new_element;
-	  }
-	  else
-	  {
-	    /* new_element will be new list head */
-	    /* switch data of head and new element and insert
-	     * new_element after head -- which effectivly inserts
-	     * new_element _before_ head. 
-	     */
-	    char *tmp = (*head)->line;
-	    (*head)->line = new_element->line;
-	    new_element->line = tmp;
-	    new_element->next = (*head)->next;
-	    (*head)->next = new_element;
-	  }
-	  result = TRUE;
-	}
-	else if(position==AFTER)
-	{
-	  prev = cfg_content->next;
-	  cfg_content->next = new_element;
-	  new_element->next = prev;
-	  result = TRUE;
-	}
+	free (new_element);
+	return FALSE;
+      }
+      if (position == BEFORE)
+      {
+	new_element->next = cfg_content;
+	*link = new_element;
       }
-      inserted = TRUE;
+      else
+      {
+	new_element->next = cfg_content->next;
+	cfg_content->next = new_element;
+      }
+      return TRUE;
     }
     /* skip ourselves, i.e. if a line is encountered that is equal
      * to the one that is to be inserted, we don't need to do
      * anything more.*/
-    if (strcmp (cfg_content->line, line) == 0){
-      result = TRUE;
-      inserted = TRUE;
-    }
-    prev = cfg_content;
-    cfg_content = cfg_content->next;
+    if (strcmp (cfg_content->line, line) == 0)
+      return TRUE;
   }
-  return result; 
+  return FALSE;
 }
 
 int
 remove_module (config_content_t **cfg, const char *module_name)
 {
-  config_content_t *prev = NULL, **head;
-  config_content_t *cfg_content = *cfg;
+  config_content_t **link = cfg;
   int removed = 0;
 
   if (debug)
       printf("**** remove_module (%s)**** \n", module_name);
 
-  /* save list head */
-  head = cfg;
-  while (cfg_content != NULL)
+  while (*link != NULL)
   {
+    config_content_t *cfg_content = *link;
+
     if (strcasestr (cfg_content->line, module_name) != NULL)
     {
-      /* found an element cotaining module_name */
-      if (prev)
-      {
-	 if (debug)
-            printf("REMOVE: %s", cfg_content->line); 
-	prev->next = cfg_content->next;
-	free (cfg_content);
-	cfg_content = prev;
-      }
-      else
-      {
-	/* no prev means we remove list head */
-	 if (debug)
-            printf("REMOVE from head: %s", cfg_content->line); 
-	config_content_t *succ = (*head)->next;
-	(*head)->line = succ->line;
-	(*head)->next = succ->next;
-	free (succ);
-	succ = NULL;
-      }
+      /* found an element containing module_name, this may be the
+	 head or the only line */
+      if (debug)
+	printf("REMOVE: %s", cfg_content->line);
+      *link = cfg_content->next;
+      free (cfg_content->line);
+      free (cfg_content);
       removed += 1;
     }
-    prev = cfg_content;
-    cfg_content = cfg_content->next;
+    else
+      link = &cfg_content->next;
   }
   if (debug)
     printf("Remove %d items\n", removed); 
@@ -228,66 +219,75 @@ remove_module (config_content_t **cfg, const char *module_name)
   return removed;
 }
 
-static char *tmp_file;
+/* The new content of the service file, written with
+   vfs->replace () by close_service_file ().  */
+static __thread char *service_buf;
+static __thread size_t service_len;
 
-FILE *
-create_service_file (const char *service)
+static FILE *
+open_service_buffer (const char *service)
 {
   FILE *fp;
-  int fd;
   struct stat f_stat;
   char *conffile;
 
-  if (asprintf (&tmp_file, "%s/pam.d/pam-config.tmpXXXXXX", confdir) < 0)
-	  return NULL;
-
   if (asprintf (&conffile, "%s/pam.d/%s", confdir, service) < 0)
     return NULL;
 
-  if (stat (conffile, &f_stat) != 0)
+  /* a planned file exists, even if not on disk */
+  if (!(plan_mode && plan_has_file (service)) &&
+      vfs->stat (conffile, &f_stat) != 0)
   {
     fprintf (stderr, _("Cannot stat '%s': %m\n"), conffile);
-    free (tmp_file);
     free (conffile);
     return NULL;
   }
 
   free (conffile);
-  fd = mkstemp (tmp_file);
-  if (fchmod (fd, f_stat.st_mode) < 0)
-    {
-      fprintf (stderr, _("Cannot set permissions for '%s': %m\n"),
-               tmp_file);
-      unlink (tmp_file);
-      free (tmp_file);
-      return NULL;
-    }
-  if (fchown (fd, f_stat.st_uid, f_stat.st_gid) < 0)
-    {
-      fprintf (stderr,
-               _("Cannot change owner/group for `%s': %m\n"),
-               tmp_file);
-      unlink (tmp_file);
-      free (tmp_file);
-      return NULL;
-    }
 
-  fp = fdopen (fd, "w");
+  if (plan_mode)
+    return plan_create_file (service, TRUE);
+
+  fp = open_memstream (&service_buf, &service_len);
   if (fp == NULL)
     {
       fprintf (stderr, _("Cannot create file handle: %m\n"));
-      unlink (tmp_file);
-      free (tmp_file);
       return NULL;
     }
 
   return fp;
 }
 
-int
-close_service_file (FILE *fp, const char *service)
+FILE *
+create_service_file (const char *service)
+{
+  struct timespec start;
+  FILE *fp;
+
+  TRACE_BEGIN (start);
+  fp = open_service_buffer (service);
+  TRACE_END (start, "create_service_file", NULL, -1, service);
+  return fp;
+}
+
+static int
+commit_service_file (FILE *fp, const char *service)
 {
   char *conffile, *oldfile;
+  int retval = 0;
+
+  if (plan_mode)
+    {
+      plan_action ("backup\t%s\t%s.old", service, service);
+      return plan_close_file (fp);
+    }
+
+  if (fclose (fp) != 0)
+    {
+      fprintf (stderr, _("Out of memory\n"));
+      free (service_buf);
+      return 1;
+    }
 
   if (asprintf (&conffile, "%s/pam.d/%s", confdir, service) < 0)
     return 1;
@@ -295,13 +295,30 @@ close_service_file (FILE *fp, const char *service)
   if (asprintf (&oldfile, "%s/pam.d/%s.old", confdir, service) < 0)
     return 1;
 
-  fclose (fp);
+  /* keep the old file as .old, replace () keeps owner and mode.  */
+  vfs->unlink (oldfile);
+  vfs->link (conffile, oldfile);
+  if (vfs->replace (conffile, service_buf, service_len) != 0)
+    retval = 1;
 
-  rename (conffile, oldfile);
-  rename (tmp_file, conffile);
+  /* the reverse module index does not know about the new file.  */
+  free_module_index ();
 
   free (conffile);
   free (oldfile);
-  free (tmp_file);
-  return 0;
+  free (service_buf);
+  service_buf = NULL;
+  return retval;
+}
+
+int
+close_service_file (FILE *fp, const char *service)
+{
+  struct timespec start;
+  int retval;
+
+  TRACE_BEGIN (start);
+  retval = commit_service_file (fp, service);
+  TRACE_END (start, "close_service_file", NULL, -1, service);
+  return retval;
 }
@@ -0,0 +1,651 @@
+/* Copyright (C) 2020 Thorsten Kukuk
+   Author: Thorsten Kukuk <kukuk@thkukuk.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pam-config.h"
+
+/* --export-state and --apply-state: the complete module state of
+   the common config or of one service in a small text file, so
+   the same configuration can be applied on other hosts without
+   replaying all pam-config calls:
+
+     pam-config-state 1
+     service gdm
+     pam_unix.so auth nullok try_first_pass remember=5
+
+   The "service" line is missing for the common config. There is
+   one line for every enabled module and type, with the enabled
+   options. Everything not listed is disabled.
+
+   --converge reads a profile in the same format with several
+   sections, every "service" line starts a new one. Only sections
+   which differ from the current state are written. All files are
+   created in memory first and only written if every section
+   passed the sanity checks.  */
+
+#define STATE_MAGIC "pam-config-state"
+#define STATE_VERSION 1
+
+#define NUM_TYPES (SESSION + 1)
+
+struct state_line {
+  char *text;
+  unsigned int lineno;
+};
+
+struct state_section {
+  char *service;             /* NULL for the common config */
+  struct state_line *lines;
+  size_t nlines;
+  struct state_section *next;
+};
+
+static void
+write_module_state (FILE *fp, pam_module_t *mod, write_type_t type)
+{
+  option_set_t *opt_set = mod->get_opt_set (mod, type);
+  size_t i;
+
+  if (!opt_set->is_enabled (opt_set, "is_enabled"))
+    return;
+
+  fprintf (fp, "%s %s", mod->name, type2string (type));
+  for (i = 0; opt_set->bool_keys[i] != NULL; i++)
+    if (opt_set->bool_values[i] &&
+	strcmp (opt_set->bool_keys[i], "is_enabled") != 0)
+      fprintf (fp, " %s", opt_set->bool_keys[i]);
+  for (i = 0; opt_set->string_keys[i] != NULL; i++)
+    if (opt_set->string_values[i])
+      fprintf (fp, " %s=%s", opt_set->string_keys[i],
+	       opt_set->string_values[i]);
+  fputc ('\n', fp);
+}
+
+static int
+load_current_state (const char *service, pam_module_t **module_list)
+{
+  if (load_all_types (confdir, service, module_list) != 0)
+    {
+      if (service)
+	fprintf (stderr,
+		 _("\nCouldn't load config file '%s/pam.d/%s', aborted!\n"),
+		 confdir, service);
+      else
+	fprintf (stderr, _("\nCouldn't load config file, aborted!\n"));
+      return 1;
+    }
+
+  return 0;
+}
+
+int
+export_state (const char *service, const char *file)
+{
+  pam_module_t **module_list = service ? service_module_list :
+    common_module_list;
+  write_type_t type;
+  FILE *fp;
+  size_t i;
+
+  if (load_current_state (service, module_list) != 0)
+    return 1;
+
+  if (file == NULL || strcmp (file, "-") == 0)
+    fp = stdout;
+  else if ((fp = fopen (file, "w")) == NULL)
+    {
+      fprintf (stderr, _("Cannot create %s: %m\n"), file);
+      return 1;
+    }
+
+  fprintf (fp, "%s %d\n", STATE_MAGIC, STATE_VERSION);
+  if (service)
+    fprintf (fp, "service %s\n", service);
+  for (i = 0; module_list[i] != NULL; i++)
+    for (type = AUTH; type <= SESSION; type++)
+      write_module_state (fp, module_list[i], type);
+
+  if (fp != stdout && fclose (fp) != 0)
+    {
+      fprintf (stderr, _("Cannot create %s: %m\n"), file);
+      return 1;
+    }
+
+  return 0;
+}
+
+static void
+reset_module_state (pam_module_t **module_list)
+{
+  write_type_t type;
+
+  for (; *module_list != NULL; module_list++)
+    for (type = AUTH; type <= SESSION; type++)
+      {
+	option_set_t *opt_set = (*module_list)->get_opt_set (*module_list,
+							     type);
+
+	clear_opt_set (opt_set);
+      }
+}
+
+static pam_module_t *
+find_module (pam_module_t **module_list, const char *name)
+{
+  for (; *module_list != NULL; module_list++)
+    if (strcmp ((*module_list)->name, name) == 0)
+      return *module_list;
+
+  return NULL;
+}
+
+static int
+string2type (const char *str)
+{
+  write_type_t type;
+
+  for (type = AUTH; type <= SESSION; type++)
+    if (strcmp (str, type2string (type)) == 0)
+      return type;
+
+  return -1;
+}
+
+/* Parse one "module type option..." line into the option sets.  */
+static int
+apply_module_state (pam_module_t **module_list, const char *text,
+		    const char *file, unsigned int lineno)
+{
+  char *line, *name, *type_str, *opt;
+  option_set_t *opt_set;
+  pam_module_t *mod;
+  int type, retval = 0;
+
+  if ((line = strdup (text)) == NULL)
+    {
+      fprintf (stderr, _("Out of memory\n"));
+      return 1;
+    }
+
+  name = strtok (line, " \t");
+  type_str = strtok (NULL, " \t");
+  if (type_str == NULL)
+    {
+      fprintf (stderr, _("%s:%u: broken line\n"), file, lineno);
+      free (line);
+      return 1;
+    }
+  if ((mod = find_module (module_list, name)) == NULL)
+    {
+      fprintf (stderr, _("%s:%u: unknown module '%s'\n"),
+	       file, lineno, name);
+      free (line);
+      return 1;
+    }
+  if ((type = string2type (type_str)) < 0)
+    {
+      fprintf (stderr, _("%s:%u: unknown type '%s'\n"),
+	       file, lineno, type_str);
+      free (line);
+      return 1;
+    }
+
+  opt_set = mod->get_opt_set (mod, type);
+  opt_set->enable (opt_set, "is_enabled", TRUE);
+
+  while (retval == 0 && (opt = strtok (NULL, " \t")) != NULL)
+    {
+      char *value = strchr (opt, '=');
+      int found;
+
+      if (value)
+	{
+	  *value++ = '\0';
+	  value = strdup (value);
+	  if (value == NULL)
+	    {
+	      fprintf (stderr, _("Out of memory\n"));
+	      retval = 1;
+	      break;
+	    }
+	  found = opt_set->set_opt (opt_set, opt, value);
+	}
+      else
+	found = opt_set->enable (opt_set, opt, TRUE);
+
+      if (!found)
+	{
+	  fprintf (stderr, _("%s:%u: unknown option '%s' for %s\n"),
+		   file, lineno, opt, name);
+	  retval = 1;
+	}
+    }
+
+  free (line);
+  return retval;
+}
+
+/* Set the option sets to the state of section, everything not
+   listed is disabled.  */
+static int
+apply_section (const struct state_section *section, const char *file)
+{
+  pam_module_t **module_list = section->service ? service_module_list :
+    common_module_list;
+  size_t i;
+
+  reset_module_state (module_list);
+  for (i = 0; i < section->nlines; i++)
+    if (apply_module_state (module_list, section->lines[i].text, file,
+			    section->lines[i].lineno) != 0)
+      return 1;
+
+  return 0;
+}
+
+static void
+free_sections (struct state_section *section)
+{
+  while (section)
+    {
+      struct state_section *next = section->next;
+      size_t i;
+
+      for (i = 0; i < section->nlines; i++)
+	free (section->lines[i].text);
+      free (section->lines);
+      free (section->service);
+      free (section);
+      section = next;
+    }
+}
+
+static struct state_section *
+new_section (struct state_section ***tail, const char *service)
+{
+  struct state_section *section = calloc (1, sizeof (struct state_section));
+
+  if (section == NULL)
+    return NULL;
+  if (service && (section->service = strdup (service)) == NULL)
+    {
+      free (section);
+      return NULL;
+    }
+  **tail = section;
+  *tail = &section->next;
+
+  return section;
+}
+
+/* Read a state file or profile into sections. The module lines are
+   only checked by apply_section().  */
+static int
+read_state_file (const char *file, struct state_section **sections)
+{
+  struct state_section **tail = sections, *section = NULL;
+  char *buf = NULL;
+  size_t buflen = 0;
+  unsigned int lineno = 1;
+  int version, retval = 0;
+  FILE *fp;
+
+  *sections = NULL;
+
+  fp = strcmp (file, "-") == 0 ? stdin : fopen (file, "r");
+  if (fp == NULL)
+    {
+      fprintf (stderr, _("Cannot open '%s': %m\n"), file);
+      return 1;
+    }
+
+  if (getline (&buf, &buflen, fp) < 1 ||
+      sscanf (buf, STATE_MAGIC " %d", &version) != 1)
+    {
+      fprintf (stderr, _("ERROR: %s is no pam-config state file\n"), file);
+      retval = 1;
+    }
+  else if (version != STATE_VERSION)
+    {
+      fprintf (stderr, _("ERROR: %s: unsupported state version %d\n"),
+	       file, version);
+      retval = 1;
+    }
+
+  while (retval == 0)
+    {
+      ssize_t n = getline (&buf, &buflen, fp);
+      struct state_line *lines;
+      char *cp;
+
+      if (n < 1)
+	break;
+      lineno++;
+
+      /* files from other systems may end their lines with CRLF */
+      if (buf[n - 1] == '\n')
+	buf[--n] = '\0';
+      if (n > 0 && buf[n - 1] == '\r')
+	buf[--n] = '\0';
+      cp = buf + strspn (buf, " \t");
+      if (*cp == '\0' || *cp == '#')
+	continue;
+
+      if (strncmp (cp, "service", 7) == 0 && (cp[7] == ' ' || cp[7] == '\t'))
+	{
+	  cp += 7;
+	  cp += strspn (cp, " \t");
+	  if ((section = new_section (&tail, cp)) == NULL)
+	    retval = -1;
+	  continue;
+	}
+
+      if (section == NULL && (section = new_section (&tail, NULL)) == NULL)
+	{
+	  retval = -1;
+	  break;
+	}
+
+      lines = realloc (section->lines,
+		       (section->nlines + 1) * sizeof (struct state_line));
+      if (lines == NULL)
+	{
+	  retval = -1;
+	  break;
+	}
+      section->lines = lines;
+      lines[section->nlines].lineno = lineno;
+      if ((lines[section->nlines].text = strdup (cp)) == NULL)
+	retval = -1;
+      else
+	section->nlines++;
+    }
+
+  /* Without any line everything is disabled.  */
+  if (retval == 0 && *sections == NULL && new_section (&tail, NULL) == NULL)
+    retval = -1;
+
+  if (retval < 0)
+    {
+      fprintf (stderr, _("Out of memory\n"));
+      retval = 1;
+    }
+
+  if (fp != stdin)
+    fclose (fp);
+  free (buf);
+
+  if (retval != 0)
+    {
+      free_sections (*sections);
+      *sections = NULL;
+    }
+
+  return retval;
+}
+
+int
+load_state (const char *file, char **service)
+{
+  struct state_section *sections;
+  int retval;
+
+  *service = NULL;
+
+  if (read_state_file (file, &sections) != 0)
+    return 1;
+
+  if (sections->next)
+    {
+      fprintf (stderr,
+	       _("ERROR: %s contains more than one section, use --converge\n"),
+	       file);
+      free_sections (sections);
+      return 1;
+    }
+
+  retval = apply_section (sections, file);
+  if (retval == 0)
+    {
+      *service = sections->service;
+      sections->service = NULL;
+    }
+  free_sections (sections);
+
+  return retval;
+}
+
+int
+check_state_stacks (const char *file)
+{
+  static const write_type_t types[] = {AUTH, ACCOUNT};
+  size_t i, j;
+  int retval = 0;
+
+  for (i = 0; i < sizeof (types)/sizeof (types[0]); i++)
+    {
+      for (j = 0; common_module_list[j] != NULL; j++)
+	{
+	  pam_module_t *mod = common_module_list[j];
+	  option_set_t *opt_set = mod->get_opt_set (mod, types[i]);
+
+	  if (opt_set->is_enabled (opt_set, "is_enabled"))
+	    break;
+	}
+      if (common_module_list[j] == NULL)
+	{
+	  fprintf (stderr, _("ERROR: %s enables no %s module, "
+			     "use --force to apply it anyway\n"),
+		   file, type2string (types[i]));
+	  retval = 1;
+	}
+    }
+
+  return retval;
+}
+
+/* The state line of every module and type, NULL if disabled.  */
+static char **
+snapshot_state (pam_module_t **module_list, size_t nmods)
+{
+  char **lines = calloc (nmods * NUM_TYPES, sizeof (char *));
+  size_t i;
+
+  if (lines == NULL)
+    return NULL;
+
+  for (i = 0; i < nmods * NUM_TYPES; i++)
+    {
+      size_t len = 0;
+      FILE *fp = open_memstream (&lines[i], &len);
+
+      if (fp == NULL)
+	continue;
+      write_module_state (fp, module_list[i / NUM_TYPES], i % NUM_TYPES);
+      fclose (fp);
+      if (len == 0)
+	{
+	  free (lines[i]);
+	  lines[i] = NULL;
+	}
+      else
+	lines[i][len - 1] = '\0';
+    }
+
+  return lines;
+}
+
+static void
+free_snapshot (char **lines, size_t nmods)
+{
+  size_t i;
+
+  if (lines == NULL)
+    return;
+  for (i = 0; i < nmods * NUM_TYPES; i++)
+    free (lines[i]);
+  free (lines);
+}
+
+/* Print every module and type whose state changes, returns the
+   number of changes.  */
+static int
+print_state_delta (const char *scope, char **before, char **after,
+		   size_t nmods)
+{
+  int changes = 0;
+  size_t i;
+
+  for (i = 0; i < nmods * NUM_TYPES; i++)
+    {
+      if (before[i] == NULL && after[i] == NULL)
+	continue;
+      if (before[i] && after[i] && strcmp (before[i], after[i]) == 0)
+	continue;
+
+      if (before[i])
+	printf ("%s: -%s\n", scope, before[i]);
+      if (after[i])
+	printf ("%s: +%s\n", scope, after[i]);
+      changes++;
+    }
+
+  return changes;
+}
+
+/* Compare a section with the current config and write it into the
+   plan if it differs. Returns the number of changes, -1 on error.  */
+static int
+converge_section (const struct state_section *section, const char *file)
+{
+  pam_module_t **module_list = section->service ? service_module_list :
+    common_module_list;
+  char **before, **after = NULL;
+  size_t nmods = 0;
+  int changes = -1;
+
+  while (module_list[nmods] != NULL)
+    nmods++;
+
+  reset_module_state (module_list);
+  if (load_current_state (section->service, module_list) != 0)
+    return -1;
+
+  before = snapshot_state (module_list, nmods);
+  if (before == NULL)
+    fprintf (stderr, _("Out of memory\n"));
+  else if (apply_section (section, file) == 0)
+    {
+      after = snapshot_state (module_list, nmods);
+      if (after == NULL)
+	fprintf (stderr, _("Out of memory\n"));
+      else
+	changes = print_state_delta (section->service ?
+				     section->service : "common",
+				     before, after, nmods);
+    }
+  free_snapshot (before, nmods);
+  free_snapshot (after, nmods);
+
+  if (changes <= 0)
+    return changes;
+
+  if (section->service == NULL)
+    {
+      if (sanitize_check_account (common_module_list, 0) != 0 ||
+	  sanitize_check_auth (common_module_list, 0) != 0 ||
+	  sanitize_check_password (common_module_list, 0) != 0 ||
+	  sanitize_check_session (common_module_list, 0) != 0 ||
+	  write_common_config () != 0)
+	changes = -1;
+    }
+  else
+    {
+      gl_service = section->service;
+      if (write_service_config () != 0)
+	changes = -1;
+      gl_service = NULL;
+    }
+
+  return changes;
+}
+
+int
+converge_profile (const char *file)
+{
+  struct state_section *sections, *section;
+  int user_plan = plan_mode, common_changed = FALSE;
+  int changes = 0, retval = 0;
+
+  if (read_state_file (file, &sections) != 0)
+    return 1;
+
+  /* Check all sections before anything is compared.  */
+  for (section = sections; section != NULL; section = section->next)
+    if (apply_section (section, file) != 0)
+      {
+	free_sections (sections);
+	return 1;
+      }
+
+  /* Nothing is written before all sections are done.  */
+  plan_mode = TRUE;
+
+  for (section = sections; section != NULL; section = section->next)
+    {
+      int n = converge_section (section, file);
+
+      if (n < 0)
+	{
+	  fprintf (stderr, _("Nothing written.\n"));
+	  retval = 1;
+	  break;
+	}
+      if (n > 0 && section->service == NULL)
+	common_changed = TRUE;
+      changes += n;
+    }
+
+  plan_mode = user_plan;
+
+  if (retval == 0 && changes > 0)
+    {
+      if (!plan_mode)
+	retval = plan_commit ();
+
+      if (retval == 0 && common_changed)
+	{
+	  retval |= check_symlink (confdir, CONF_ACCOUNT_PC, CONF_ACCOUNT);
+	  retval |= check_symlink (confdir, CONF_AUTH_PC, CONF_AUTH);
+	  retval |= check_symlink (confdir, CONF_PASSWORD_PC, CONF_PASSWORD);
+	  retval |= check_symlink (confdir, CONF_SESSION_PC, CONF_SESSION);
+	}
+
+      if (plan_mode && print_plan () != 0)
+	retval = 1;
+    }
+
+  free_sections (sections);
+
+  return retval;
+}
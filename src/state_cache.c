@@ -0,0 +1,436 @@
+/* Copyright (C) 2020 Thorsten Kukuk
+   Author: Thorsten Kukuk <kukuk@thkukuk.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "pam-config.h"
+
+/* Binary image of the option sets of the common-*-pc files.
+
+   Parsing the four files is done on nearly every run. If a cache
+   directory is configured, the resulting option sets are stored in
+   cachedir/common-state and the next run copies them from there
+   instead of parsing the files again. The text files stay the only
+   source of truth: the image is used only if the stat data of every
+   file is unchanged or, if they differ, the content hash matches.
+   The image is only written if parsing printed no warnings, so that
+   these are not lost on later runs.
+
+   Format (see cache_file.c):
+     magic, string VERSION,
+     per -pc file: string path ("" if not found),
+       CACHE_STAT_KEY_LEN times uint64 stat data, uint64 content hash,
+     uint32 number of modules,
+     per module: string name, per type:
+       uint32 number of bool options, per option: string key,
+         uint32 value,
+       uint32 number of string options, per option: string key,
+         uint32 0 or uint32 1 and string value.  */
+
+#define STATE_CACHE_FILE "common-state"
+#define STATE_CACHE_MAGIC "PCSTAT01"
+
+static const struct {
+  const char *file;
+  write_type_t type;
+} pc_files[] = {
+  {CONF_ACCOUNT_PC, ACCOUNT},
+  {CONF_AUTH_PC, AUTH},
+  {CONF_PASSWORD_PC, PASSWORD},
+  {CONF_SESSION_PC, SESSION}
+};
+
+#define NUM_PC_FILES (sizeof (pc_files)/sizeof (pc_files[0]))
+
+struct pc_file_key {
+  char *path;
+  uint64_t key[CACHE_STAT_KEY_LEN];
+  uint64_t hash;
+  int have_hash;
+};
+
+/* Find the file and get its stat data, and the content hash if
+   with_hash is set. A file which does not exist has an empty
+   key.  */
+static int
+get_file_key (const char *sysconfdir, const char *file,
+	      struct pc_file_key *fk, int with_hash)
+{
+  struct stat st;
+  char buf[4096];
+  ssize_t n;
+  int fd;
+
+  memset (fk, 0, sizeof (struct pc_file_key));
+
+  fk->path = find_config_file (sysconfdir, file);
+  if (fk->path == NULL)
+    {
+      fk->have_hash = TRUE;
+      return errno == ENOMEM ? -1 : 0;
+    }
+
+  fd = open (fk->path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0 || fstat (fd, &st) != 0)
+    {
+      if (fd >= 0)
+	close (fd);
+      return -1;
+    }
+  cache_stat_key (&st, fk->key);
+
+  if (with_hash)
+    {
+      fk->hash = CACHE_HASH_INIT;
+      while ((n = read (fd, buf, sizeof (buf))) > 0)
+	fk->hash = cache_hash_bytes (fk->hash, buf, n);
+      if (n < 0)
+	{
+	  close (fd);
+	  return -1;
+	}
+      fk->have_hash = TRUE;
+    }
+
+  close (fd);
+  return 0;
+}
+
+static void
+free_file_keys (struct pc_file_key keys[NUM_PC_FILES])
+{
+  size_t i;
+
+  for (i = 0; i < NUM_PC_FILES; i++)
+    free (keys[i].path);
+}
+
+/* Compare the record of a -pc file with the current file. Returns
+   0 if it matches, -1 if not. *stale is set if only the stat data
+   differ.  */
+static int
+check_file_key (cache_reader_t *r, const char *sysconfdir,
+		struct pc_file_key *fk, const char *file, int *stale)
+{
+  uint64_t key[CACHE_STAT_KEY_LEN];
+  const char *path;
+  uint64_t hash;
+
+  if (read_cache_string (r, &path) != 0 ||
+      read_cache_bytes (r, key, sizeof (key)) != 0 ||
+      read_cache_bytes (r, &hash, sizeof (hash)) != 0)
+    return -1;
+
+  if (strcmp (path, fk->path ? fk->path : "") != 0)
+    return -1;
+  if (memcmp (key, fk->key, sizeof (key)) == 0)
+    {
+      fk->hash = hash;
+      fk->have_hash = TRUE;
+      return 0;
+    }
+
+  /* touched or copied, but maybe not changed */
+  if (!fk->have_hash)
+    {
+      free (fk->path);
+      if (get_file_key (sysconfdir, file, fk, TRUE) != 0)
+	return -1;
+    }
+  if (hash != fk->hash)
+    return -1;
+
+  *stale = TRUE;
+  return 0;
+}
+
+/* Read the option sets of all modules. If apply is FALSE, the
+   records are only checked against module_list.  */
+static int
+read_cached_options (cache_reader_t *r, pam_module_t **module_list,
+		     int apply)
+{
+  uint32_t nmodules, i;
+
+  if (read_cache_u32 (r, &nmodules) != 0)
+    return -1;
+
+  for (i = 0; i < nmodules; i++)
+    {
+      pam_module_t *mod = module_list[i];
+      const char *name;
+      size_t type;
+
+      if (mod == NULL || read_cache_string (r, &name) != 0 ||
+	  strcmp (name, mod->name) != 0)
+	return -1;
+
+      for (type = 0; type < NUM_PC_FILES; type++)
+	{
+	  option_set_t *opt_set = mod->get_opt_set (mod, pc_files[type].type);
+	  uint32_t count, j;
+
+	  if (read_cache_u32 (r, &count) != 0)
+	    return -1;
+	  for (j = 0; j < count; j++)
+	    {
+	      const char *key;
+	      uint32_t value;
+
+	      if (opt_set->bool_keys[j] == NULL ||
+		  read_cache_string (r, &key) != 0 ||
+		  strcmp (key, opt_set->bool_keys[j]) != 0 ||
+		  read_cache_u32 (r, &value) != 0)
+		return -1;
+	      if (apply)
+		opt_set->bool_values[j] = value;
+	    }
+	  if (opt_set->bool_keys[j] != NULL)
+	    return -1;
+
+	  if (read_cache_u32 (r, &count) != 0)
+	    return -1;
+	  for (j = 0; j < count; j++)
+	    {
+	      const char *key, *value;
+	      uint32_t present;
+
+	      if (opt_set->string_keys[j] == NULL ||
+		  read_cache_string (r, &key) != 0 ||
+		  strcmp (key, opt_set->string_keys[j]) != 0 ||
+		  read_cache_u32 (r, &present) != 0)
+		return -1;
+	      if (present && read_cache_string (r, &value) != 0)
+		return -1;
+	      if (apply && present)
+		{
+		  free (opt_set->string_values[j]);
+		  if ((opt_set->string_values[j] = strdup (value)) == NULL)
+		    return -1;
+		}
+	    }
+	  if (opt_set->string_keys[j] != NULL)
+	    return -1;
+	}
+    }
+
+  if (module_list[i] != NULL || r->pos != r->end)
+    return -1;
+
+  return 0;
+}
+
+/* Try to fill the option sets from the cache. Returns TRUE if this
+   was done, FALSE if the files need to be parsed. *stale is set if
+   the cache should be rewritten.  */
+static int
+load_cached_state (const char *sysconfdir, pam_module_t **module_list,
+		   struct pc_file_key keys[NUM_PC_FILES], int *stale)
+{
+  cache_reader_t check;
+  cache_map_t cm;
+  const char *version;
+  size_t i;
+
+  if (!map_cache_file (STATE_CACHE_FILE, STATE_CACHE_MAGIC, &cm))
+    return FALSE;
+
+  if (read_cache_string (&cm.r, &version) != 0 ||
+      strcmp (version, VERSION) != 0)
+    goto invalid;
+
+  for (i = 0; i < NUM_PC_FILES; i++)
+    if (check_file_key (&cm.r, sysconfdir, &keys[i], pc_files[i].file,
+			stale) != 0)
+      goto invalid;
+
+  check = cm.r;
+  if (read_cached_options (&check, module_list, FALSE) != 0 ||
+      read_cached_options (&cm.r, module_list, TRUE) != 0)
+    goto invalid;
+
+  unmap_cache_file (&cm);
+
+  if (debug)
+    printf ("*** load_common_state: using %s/%s\n", cachedir,
+	    STATE_CACHE_FILE);
+
+  return TRUE;
+
+ invalid:
+  if (debug)
+    printf ("*** load_common_state: %s/%s is outdated\n", cachedir,
+	    STATE_CACHE_FILE);
+  unmap_cache_file (&cm);
+  return FALSE;
+}
+
+static int
+write_cached_options (FILE *fp, pam_module_t **module_list)
+{
+  uint32_t nmodules = 0;
+
+  while (module_list[nmodules] != NULL)
+    nmodules++;
+  if (write_cache_u32 (fp, nmodules) != 0)
+    return -1;
+
+  for (; *module_list != NULL; module_list++)
+    {
+      pam_module_t *mod = *module_list;
+      size_t type;
+
+      if (write_cache_string (fp, mod->name) != 0)
+	return -1;
+
+      for (type = 0; type < NUM_PC_FILES; type++)
+	{
+	  option_set_t *opt_set = mod->get_opt_set (mod, pc_files[type].type);
+	  size_t j;
+
+	  if (write_cache_u32 (fp, count_opts (opt_set->bool_keys)) != 0)
+	    return -1;
+	  for (j = 0; opt_set->bool_keys[j] != NULL; j++)
+	    if (write_cache_string (fp, opt_set->bool_keys[j]) != 0 ||
+		write_cache_u32 (fp, opt_set->bool_values[j]) != 0)
+	      return -1;
+
+	  if (write_cache_u32 (fp, count_opts (opt_set->string_keys)) != 0)
+	    return -1;
+	  for (j = 0; opt_set->string_keys[j] != NULL; j++)
+	    {
+	      const char *value = opt_set->string_values[j];
+
+	      if (write_cache_string (fp, opt_set->string_keys[j]) != 0 ||
+		  write_cache_u32 (fp, value != NULL) != 0)
+		return -1;
+	      if (value != NULL && write_cache_string (fp, value) != 0)
+		return -1;
+	    }
+	}
+    }
+
+  return 0;
+}
+
+/* Replace the cache file. Failing is not an error, the next run
+   will only be slower.  */
+static void
+write_state_cache (pam_module_t **module_list,
+		   struct pc_file_key keys[NUM_PC_FILES])
+{
+  FILE *fp = create_cache_file (STATE_CACHE_FILE, STATE_CACHE_MAGIC);
+  size_t i;
+  int retval;
+
+  if (fp == NULL)
+    return;
+
+  retval = write_cache_string (fp, VERSION);
+  for (i = 0; retval == 0 && i < NUM_PC_FILES; i++)
+    if (write_cache_string (fp, keys[i].path ? keys[i].path : "") != 0 ||
+	write_cache_bytes (fp, keys[i].key, sizeof (keys[i].key)) != 0 ||
+	write_cache_bytes (fp, &keys[i].hash, sizeof (keys[i].hash)) != 0)
+      retval = -1;
+  if (retval == 0)
+    retval = write_cached_options (fp, module_list);
+
+  close_cache_file (fp, STATE_CACHE_FILE, retval == 0);
+}
+
+static int
+get_file_keys (const char *sysconfdir, struct pc_file_key keys[NUM_PC_FILES],
+	       int with_hash)
+{
+  size_t i;
+
+  memset (keys, 0, NUM_PC_FILES * sizeof (struct pc_file_key));
+  for (i = 0; i < NUM_PC_FILES; i++)
+    if (get_file_key (sysconfdir, pc_files[i].file, &keys[i], with_hash) != 0)
+      {
+	free_file_keys (keys);
+	return -1;
+      }
+
+  return 0;
+}
+
+static int
+load_state_or_parse (const char *sysconfdir, pam_module_t **module_list)
+{
+  struct pc_file_key keys[NUM_PC_FILES];
+  unsigned int warnings = config_warnings;
+  int stale = FALSE;
+  size_t i;
+
+  if (cachedir == NULL || plan_mode || vfs_backend () != &vfs_posix ||
+      get_file_keys (sysconfdir, keys, FALSE) != 0)
+    goto parse;
+
+  if (load_cached_state (sysconfdir, module_list, keys, &stale))
+    {
+      if (stale)
+	write_state_cache (module_list, keys);
+      free_file_keys (keys);
+      return 0;
+    }
+  free_file_keys (keys);
+
+  /* The keys are taken before parsing, a file modified meanwhile
+     has a different stat key and is parsed again next time.  */
+  if (get_file_keys (sysconfdir, keys, TRUE) != 0)
+    goto parse;
+
+  for (i = 0; i < NUM_PC_FILES; i++)
+    if (load_config (sysconfdir, pc_files[i].file, pc_files[i].type,
+		     module_list, 1) != 0)
+      {
+	free_file_keys (keys);
+	return -1;
+      }
+
+  if (config_warnings == warnings)
+    write_state_cache (module_list, keys);
+  free_file_keys (keys);
+  return 0;
+
+ parse:
+  for (i = 0; i < NUM_PC_FILES; i++)
+    if (load_config (sysconfdir, pc_files[i].file, pc_files[i].type,
+		     module_list, 1) != 0)
+      return -1;
+  return 0;
+}
+
+int
+load_common_state (const char *sysconfdir, pam_module_t **module_list)
+{
+  int phase = STATS_PHASE (STATS_LOAD);
+  int retval = load_state_or_parse (sysconfdir, module_list);
+
+  STATS_PHASE (phase);
+  return retval;
+}
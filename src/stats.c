@@ -0,0 +1,449 @@
+/* Copyright (C) 2020 Thorsten Kukuk
+   Author: Thorsten Kukuk <kukuk@thkukuk.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+#include "pam-config.h"
+
+/* --stats: the time is charged to the current phase, which is
+   switched with STATS_PHASE(). The file access is counted by a vfs
+   backend which forwards every call to the backend selected before,
+   charges writes to the commit phase and traces every call for
+   --trace. Without --stats nothing of this is active, STATS_PHASE()
+   and STATS_ADD() only test stats_enabled.
+
+   The counters are process-wide, not per thread or context. Only
+   the pam-config command enables them, libpamconfig never does.  */
+
+int stats_enabled = FALSE;
+stats_counters_t stats_counters;
+
+static const char *const phase_names[STATS_NPHASES] = {
+  "getopt", "load", "probe", "sanity", "render", "commit", "relink", "other"
+};
+
+struct phase_time {
+  struct timespec wall;
+  struct timespec cpu;
+};
+
+struct module_time {
+  const char *name;
+  struct timespec wall;
+  struct module_time *next;
+};
+
+static struct phase_time phase_times[STATS_NPHASES];
+static struct phase_time start_time, phase_start;
+static int current_phase = STATS_GETOPT;
+static struct module_time *module_times;
+static struct module_time **module_times_tail = &module_times;
+static const vfs_t *counted_vfs;
+static FILE *stats_out;
+
+static void
+now (struct phase_time *t)
+{
+  clock_gettime (CLOCK_MONOTONIC, &t->wall);
+  clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &t->cpu);
+}
+
+/* sum += end - start */
+static void
+add_diff (struct timespec *sum, const struct timespec *start,
+	  const struct timespec *end)
+{
+  sum->tv_sec += end->tv_sec - start->tv_sec;
+  sum->tv_nsec += end->tv_nsec - start->tv_nsec;
+  if (sum->tv_nsec < 0)
+    {
+      sum->tv_nsec += 1000000000;
+      sum->tv_sec--;
+    }
+  else if (sum->tv_nsec >= 1000000000)
+    {
+      sum->tv_nsec -= 1000000000;
+      sum->tv_sec++;
+    }
+}
+
+static double
+to_ms (const struct timespec *t)
+{
+  return t->tv_sec * 1000.0 + t->tv_nsec / 1000000.0;
+}
+
+int
+stats_phase (int phase)
+{
+  struct phase_time t;
+  int prev = current_phase;
+
+  now (&t);
+  add_diff (&phase_times[current_phase].wall, &phase_start.wall, &t.wall);
+  add_diff (&phase_times[current_phase].cpu, &phase_start.cpu, &t.cpu);
+  phase_start = t;
+  current_phase = phase;
+
+  return prev;
+}
+
+void
+stats_module_begin (struct timespec *start)
+{
+  clock_gettime (CLOCK_MONOTONIC, start);
+}
+
+void
+stats_module_end (const char *name, const struct timespec *start)
+{
+  struct module_time *mt;
+  struct timespec end;
+
+  clock_gettime (CLOCK_MONOTONIC, &end);
+
+  /* the names are the static ones of the module descriptions */
+  for (mt = module_times; mt != NULL; mt = mt->next)
+    if (mt->name == name)
+      break;
+  if (mt == NULL)
+    {
+      if ((mt = calloc (1, sizeof (struct module_time))) == NULL)
+	return;
+      mt->name = name;
+      *module_times_tail = mt;
+      module_times_tail = &mt->next;
+    }
+  add_diff (&mt->wall, start, &end);
+}
+
+/* Counting vfs backend.  */
+
+struct read_cookie {
+  FILE *fp;
+};
+
+static ssize_t
+count_cookie_read (void *cookie, char *buf, size_t size)
+{
+  struct read_cookie *rc = cookie;
+  size_t n = fread (buf, 1, size, rc->fp);
+
+  stats_counters.read_bytes += n;
+  if (n == 0 && ferror (rc->fp))
+    return -1;
+  return n;
+}
+
+static int
+count_cookie_close (void *cookie)
+{
+  struct read_cookie *rc = cookie;
+  int retval = fclose (rc->fp);
+
+  free (rc);
+  return retval;
+}
+
+static FILE *
+count_open_read (const char *path)
+{
+  cookie_io_functions_t io = {
+    &count_cookie_read, NULL, NULL, &count_cookie_close
+  };
+  struct read_cookie *rc;
+  struct timespec start;
+  FILE *fp;
+
+  stats_counters.open++;
+  TRACE_BEGIN (start);
+  fp = counted_vfs->open_read (path);
+  TRACE_END (start, "open", NULL, -1, path);
+  if (fp == NULL)
+    return NULL;
+
+  if ((rc = malloc (sizeof (struct read_cookie))) == NULL)
+    return fp;
+  rc->fp = fp;
+  if ((fp = fopencookie (rc, "r", io)) == NULL)
+    {
+      fp = rc->fp;
+      free (rc);
+    }
+
+  return fp;
+}
+
+static int
+count_replace (const char *path, const char *buf, size_t len)
+{
+  int phase = STATS_PHASE (STATS_COMMIT);
+  struct timespec start;
+  int retval;
+
+  stats_counters.write++;
+  stats_counters.write_bytes += len;
+  /* the new content is renamed over the old one */
+  stats_counters.rename++;
+  TRACE_BEGIN (start);
+  retval = counted_vfs->replace (path, buf, len);
+  TRACE_END (start, "replace", NULL, -1, path);
+  STATS_PHASE (phase);
+
+  return retval;
+}
+
+static int
+count_stat (const char *path, struct stat *st)
+{
+  struct timespec start;
+  int retval;
+
+  stats_counters.stat++;
+  TRACE_BEGIN (start);
+  retval = counted_vfs->stat (path, st);
+  TRACE_END (start, "stat", NULL, -1, path);
+
+  return retval;
+}
+
+static int
+count_lstat (const char *path, struct stat *st)
+{
+  struct timespec start;
+  int retval;
+
+  stats_counters.stat++;
+  TRACE_BEGIN (start);
+  retval = counted_vfs->lstat (path, st);
+  TRACE_END (start, "lstat", NULL, -1, path);
+
+  return retval;
+}
+
+static ssize_t
+count_readlink (const char *path, char *buf, size_t size)
+{
+  struct timespec start;
+  ssize_t retval;
+
+  stats_counters.stat++;
+  TRACE_BEGIN (start);
+  retval = counted_vfs->readlink (path, buf, size);
+  TRACE_END (start, "readlink", NULL, -1, path);
+
+  return retval;
+}
+
+static int
+count_access (const char *path, int mode)
+{
+  struct timespec start;
+  int retval;
+
+  stats_counters.access++;
+  TRACE_BEGIN (start);
+  retval = counted_vfs->access (path, mode);
+  TRACE_END (start, "access", NULL, -1, path);
+
+  return retval;
+}
+
+static int
+count_symlink (const char *target, const char *path)
+{
+  int phase = STATS_PHASE (STATS_COMMIT);
+  struct timespec start;
+  int retval;
+
+  stats_counters.link++;
+  TRACE_BEGIN (start);
+  retval = counted_vfs->symlink (target, path);
+  TRACE_END (start, "symlink", NULL, -1, path);
+  STATS_PHASE (phase);
+
+  return retval;
+}
+
+static int
+count_link (const char *from, const char *to)
+{
+  int phase = STATS_PHASE (STATS_COMMIT);
+  struct timespec start;
+  int retval;
+
+  stats_counters.link++;
+  TRACE_BEGIN (start);
+  retval = counted_vfs->link (from, to);
+  TRACE_END (start, "link", NULL, -1, to);
+  STATS_PHASE (phase);
+
+  return retval;
+}
+
+static int
+count_rename (const char *from, const char *to)
+{
+  int phase = STATS_PHASE (STATS_COMMIT);
+  struct timespec start;
+  int retval;
+
+  stats_counters.rename++;
+  TRACE_BEGIN (start);
+  retval = counted_vfs->rename (from, to);
+  TRACE_END (start, "rename", NULL, -1, to);
+  STATS_PHASE (phase);
+
+  return retval;
+}
+
+static int
+count_unlink (const char *path)
+{
+  int phase = STATS_PHASE (STATS_COMMIT);
+  struct timespec start;
+  int retval;
+
+  stats_counters.unlink++;
+  TRACE_BEGIN (start);
+  retval = counted_vfs->unlink (path);
+  TRACE_END (start, "unlink", NULL, -1, path);
+  STATS_PHASE (phase);
+
+  return retval;
+}
+
+static int
+count_scandir (const char *dir, struct dirent ***namelist,
+	       int (*filter) (const struct dirent *))
+{
+  struct timespec start;
+  int retval;
+
+  stats_counters.scandir++;
+  TRACE_BEGIN (start);
+  retval = counted_vfs->scandir (dir, namelist, filter);
+  TRACE_END (start, "scandir", NULL, -1, dir);
+
+  return retval;
+}
+
+static const vfs_t vfs_stats = {
+  "stats",
+  &count_open_read,
+  &count_replace,
+  &count_stat,
+  &count_lstat,
+  &count_readlink,
+  &count_access,
+  &count_symlink,
+  &count_link,
+  &count_rename,
+  &count_unlink,
+  &count_scandir
+};
+
+/* Install the counting backend, --trace uses it, too.  */
+void
+stats_count_vfs (void)
+{
+  if (vfs == &vfs_stats)
+    return;
+  counted_vfs = vfs;
+  vfs = &vfs_stats;
+}
+
+const vfs_t *
+vfs_backend (void)
+{
+  return vfs == &vfs_stats ? counted_vfs : vfs;
+}
+
+static void
+print_stats (void)
+{
+  struct timespec total;
+  struct module_time *mt;
+  struct rusage ru;
+  FILE *out = stats_out ? stats_out : stderr;
+  int i;
+
+  /* charge the time up to now */
+  stats_phase (current_phase);
+
+  memset (&total, 0, sizeof (total));
+  add_diff (&total, &start_time.wall, &phase_start.wall);
+  fprintf (out, "stats\ttotal\twall_ms=%.3f\n", to_ms (&total));
+
+  for (i = 0; i < STATS_NPHASES; i++)
+    fprintf (out, "stats\tphase\t%s\twall_ms=%.3f\tcpu_ms=%.3f\n",
+	     phase_names[i], to_ms (&phase_times[i].wall),
+	     to_ms (&phase_times[i].cpu));
+
+  fprintf (out, "stats\tio\topen=%lu\tread_bytes=%lu\twrite=%lu\t"
+	   "write_bytes=%lu\tstat=%lu\taccess=%lu\trename=%lu\tlink=%lu\t"
+	   "unlink=%lu\tscandir=%lu\n",
+	   stats_counters.open, stats_counters.read_bytes,
+	   stats_counters.write, stats_counters.write_bytes,
+	   stats_counters.stat, stats_counters.access,
+	   stats_counters.rename, stats_counters.link,
+	   stats_counters.unlink, stats_counters.scandir);
+
+  for (mt = module_times; mt != NULL; mt = mt->next)
+    fprintf (out, "stats\tmodule\t%s\twrite_ms=%.3f\n", mt->name,
+	     to_ms (&mt->wall));
+
+  /* The heap high-water mark is not available without hooking
+     malloc, the peak resident set size is close enough.  */
+  if (getrusage (RUSAGE_SELF, &ru) == 0)
+    fprintf (out, "stats\tmemory\tmaxrss_kb=%ld\n", ru.ru_maxrss);
+
+  if (stats_out)
+    fclose (stats_out);
+}
+
+int
+stats_enable (const char *file)
+{
+  if (stats_enabled)
+    return 0;
+
+  if (file && (stats_out = fopen (file, "a")) == NULL)
+    {
+      fprintf (stderr, _("Cannot open %s: %m\n"), file);
+      return -1;
+    }
+
+  now (&start_time);
+  phase_start = start_time;
+  stats_count_vfs ();
+  stats_enabled = TRUE;
+  atexit (&print_stats);
+
+  return 0;
+}
@@ -27,6 +27,7 @@ extern pam_module_t mod_pam_pwcheck;
 extern pam_module_t mod_pam_pwhistory;
 extern pam_module_t mod_pam_pwquality;
 extern pam_module_t mod_pam_selinux;
+extern pam_module_t mod_pam_selinux_open;
 extern pam_module_t mod_pam_ssh;
 extern pam_module_t mod_pam_sss;
 extern pam_module_t mod_pam_succeed_if;
@@ -164,7 +165,7 @@ static pam_module_t *module_list_session[] = {
   &mod_pam_nam,
   &mod_pam_umask,
   &mod_pam_ssh,
-  &mod_pam_selinux,
+  &mod_pam_selinux_open,
   &mod_pam_gnome_keyring,
   &mod_pam_kwallet5,
   &mod_pam_exec,
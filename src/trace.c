@@ -0,0 +1,138 @@
+/* Copyright (C) 2020 Thorsten Kukuk
+   Author: Thorsten Kukuk <kukuk@thkukuk.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pam-config.h"
+
+/* --trace: every span is written as complete event ("ph":"X") of
+   the Trace Event format when it ends, so the file can be loaded
+   into Perfetto or chrome://tracing. Spans are nested by time,
+   which the viewers understand without begin/end pairs.
+
+   Like the --stats counters, the trace is process-wide and only
+   enabled by the pam-config command.  */
+
+int trace_enabled = FALSE;
+
+static FILE *trace_fp;
+static struct timespec trace_start;
+static int trace_events;
+static long trace_pid;
+
+static double
+since_start_us (const struct timespec *t)
+{
+  return (t->tv_sec - trace_start.tv_sec) * 1000000.0 +
+    (t->tv_nsec - trace_start.tv_nsec) / 1000.0;
+}
+
+static void
+print_json_string (const char *str)
+{
+  fputc ('"', trace_fp);
+  for (; *str; str++)
+    {
+      if (*str == '"' || *str == '\\')
+	fprintf (trace_fp, "\\%c", *str);
+      else if ((unsigned char) *str < 0x20)
+	fprintf (trace_fp, "\\u%04x", *str);
+      else
+	fputc (*str, trace_fp);
+    }
+  fputc ('"', trace_fp);
+}
+
+void
+trace_begin (struct timespec *start)
+{
+  clock_gettime (CLOCK_MONOTONIC, start);
+}
+
+void
+trace_end (const struct timespec *start, const char *name,
+	   const char *module, int type, const char *path)
+{
+  struct timespec end;
+  const char *sep = "";
+
+  clock_gettime (CLOCK_MONOTONIC, &end);
+
+  fprintf (trace_fp, "%s{\"name\":", trace_events++ ? ",\n" : "");
+  print_json_string (name);
+  fprintf (trace_fp, ",\"cat\":\"pam-config\",\"ph\":\"X\","
+	   "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld,\"args\":{",
+	   since_start_us (start),
+	   since_start_us (&end) - since_start_us (start),
+	   trace_pid, trace_pid);
+  if (module)
+    {
+      fputs ("\"module\":", trace_fp);
+      print_json_string (module);
+      sep = ",";
+    }
+  if (type >= 0)
+    {
+      fprintf (trace_fp, "%s\"type\":", sep);
+      print_json_string (type2string (type));
+      sep = ",";
+    }
+  if (path)
+    {
+      fprintf (trace_fp, "%s\"path\":", sep);
+      print_json_string (path);
+    }
+  fputs ("}}", trace_fp);
+}
+
+static void
+close_trace (void)
+{
+  /* nothing may be traced after the file is closed */
+  trace_enabled = FALSE;
+  fputs ("\n],\"displayTimeUnit\":\"ms\"}\n", trace_fp);
+  if (fclose (trace_fp) != 0)
+    fprintf (stderr, _("Cannot write trace file: %m\n"));
+}
+
+int
+trace_enable (const char *file)
+{
+  if (trace_enabled)
+    return 0;
+
+  if ((trace_fp = fopen (file, "w")) == NULL)
+    {
+      fprintf (stderr, _("Cannot create %s: %m\n"), file);
+      return -1;
+    }
+  fputs ("{\"traceEvents\":[\n", trace_fp);
+
+  clock_gettime (CLOCK_MONOTONIC, &trace_start);
+  trace_pid = getpid ();
+  stats_count_vfs ();
+  trace_enabled = TRUE;
+  atexit (&close_trace);
+
+  return 0;
+}
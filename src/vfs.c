@@ -0,0 +1,844 @@
+/* Copyright (C) 2020 Thorsten Kukuk
+   Author: Thorsten Kukuk <kukuk@thkukuk.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <time.h>
+#include <errno.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "pam-config.h"
+
+/* Access to the config files and PAM modules goes through vfs, so
+   that everything can be done in memory as well.
+
+   The POSIX backend works on the real filesystem. The memory
+   backend is an overlay: files, symlinks and removals are kept in
+   memory, everything else is read from the real filesystem, which
+   is never modified. A tree which exists only in memory can be
+   built with vfs_memory_add_file().  */
+
+#define DEF_MODE 0644
+#define MAX_SYMLINKS 8
+
+/* POSIX backend.  */
+
+static FILE *
+posix_open_read (const char *path)
+{
+  return fopen (path, "r");
+}
+
+/* Write a temporary file in the same directory and rename it, the
+   owner and mode of an existing file are kept.  */
+static int
+posix_replace (const char *path, const char *buf, size_t len)
+{
+  struct stat f_stat;
+  char *tmpfname;
+  FILE *fp;
+  int fd;
+  /* defaults for uid, gid and mode */
+  uid_t user_id = getuid();
+  gid_t group_id = getgid();
+  mode_t mode = DEF_MODE;
+
+  if (asprintf (&tmpfname, "%s.XXXXXX", path) < 0)
+    return -1;
+
+  if (stat (path, &f_stat) == 0)
+    {
+      user_id = f_stat.st_uid;
+      group_id = f_stat.st_gid;
+      mode = f_stat.st_mode;
+    }
+
+  fd = mkstemp (tmpfname);
+  if (fd < 0)
+    {
+      fprintf (stderr, _("Cannot create %s: %m\n"), path);
+      free (tmpfname);
+      return -1;
+    }
+  if (fchmod (fd, mode) < 0)
+    {
+      fprintf (stderr, _("Cannot set permissions for '%s': %m\n"),
+               tmpfname);
+      goto error;
+    }
+  if (fchown (fd, user_id, group_id) < 0)
+    {
+      fprintf (stderr,
+               _("Cannot change owner/group for `%s': %m\n"),
+               tmpfname);
+      goto error;
+    }
+
+  fp = fdopen (fd, "w");
+  if (fp == NULL)
+    {
+      fprintf (stderr, _("Cannot create %s: %m\n"), path);
+      goto error;
+    }
+
+  fwrite (buf, 1, len, fp);
+  if (fclose (fp) != 0)
+    {
+      fprintf (stderr, _("Cannot create %s: %m\n"), path);
+      unlink (tmpfname);
+      free (tmpfname);
+      return -1;
+    }
+
+  if (rename (tmpfname, path) != 0)
+    {
+      fprintf (stderr, _("Cannot create %s: %m\n"), path);
+      unlink (tmpfname);
+      free (tmpfname);
+      return -1;
+    }
+  free (tmpfname);
+
+  return 0;
+
+ error:
+  close (fd);
+  unlink (tmpfname);
+  free (tmpfname);
+  return -1;
+}
+
+static int
+posix_scandir (const char *dir, struct dirent ***namelist,
+	       int (*filter) (const struct dirent *))
+{
+  return scandir (dir, namelist, filter, alphasort);
+}
+
+const vfs_t vfs_posix = {
+  "posix",
+  &posix_open_read,
+  &posix_replace,
+  &stat,
+  &lstat,
+  &readlink,
+  &access,
+  &symlink,
+  &link,
+  &rename,
+  &unlink,
+  &posix_scandir
+};
+
+/* Memory backend.  */
+
+enum mem_type {
+  MEM_FILE,
+  MEM_SYMLINK,
+  MEM_REMOVED
+};
+
+struct mem_entry {
+  char *path;
+  enum mem_type type;
+  char *data;        /* content or symlink target */
+  size_t len;
+  mode_t mode;
+  uid_t uid;
+  gid_t gid;
+  ino_t ino;
+  struct timespec mtime;
+  struct mem_entry *next;
+};
+
+/* The memory file system is shared by all threads, the backend
+   functions of vfs_memory hold mem_lock, see MEM_LOCKED.  */
+static struct mem_entry *mem_entries;
+static struct mem_entry **mem_entries_tail = &mem_entries;
+static ino_t mem_next_ino = 1;
+static pthread_mutex_t mem_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct mem_entry *
+mem_lookup (const char *path)
+{
+  struct mem_entry *me;
+
+  for (me = mem_entries; me != NULL; me = me->next)
+    if (strcmp (me->path, path) == 0)
+      return me;
+
+  return NULL;
+}
+
+/* Get the entry for path, a new one is appended, so the order of
+   the dump follows the order of the changes.  */
+static struct mem_entry *
+mem_entry (const char *path)
+{
+  struct mem_entry *me = mem_lookup (path);
+
+  if (me != NULL)
+    return me;
+
+  me = calloc (1, sizeof (struct mem_entry));
+  if (me == NULL || (me->path = strdup (path)) == NULL)
+    {
+      free (me);
+      errno = ENOMEM;
+      return NULL;
+    }
+  me->type = MEM_REMOVED;
+  *mem_entries_tail = me;
+  mem_entries_tail = &me->next;
+
+  return me;
+}
+
+static void
+mem_set (struct mem_entry *me, enum mem_type type, char *data, size_t len)
+{
+  free (me->data);
+  me->type = type;
+  me->data = data;
+  me->len = len;
+  me->ino = mem_next_ino++;
+  clock_gettime (CLOCK_REALTIME, &me->mtime);
+}
+
+/* Build the path a relative symlink target points to.  */
+static char *
+mem_link_target (const char *path, const char *target, size_t len)
+{
+  const char *slash = strrchr (path, '/');
+  char *result;
+
+  if (target[0] == '/' || slash == NULL)
+    return strndup (target, len);
+
+  if (asprintf (&result, "%.*s/%.*s", (int) (slash - path), path,
+		(int) len, target) < 0)
+    return NULL;
+
+  return result;
+}
+
+/* Follow symlinks in memory and on disk, returns the malloc'ed
+   path of the file which is finally used.  */
+static char *
+mem_resolve (const char *path)
+{
+  char *cur = strdup (path);
+  int i;
+
+  for (i = 0; cur != NULL && i < MAX_SYMLINKS; i++)
+    {
+      struct mem_entry *me = mem_lookup (cur);
+      char buf[PATH_MAX], *next;
+      ssize_t n;
+
+      if (me != NULL)
+	{
+	  if (me->type != MEM_SYMLINK)
+	    return cur;
+	  next = mem_link_target (cur, me->data, me->len);
+	}
+      else
+	{
+	  struct stat st;
+
+	  if (lstat (cur, &st) != 0 || !S_ISLNK (st.st_mode) ||
+	      (n = readlink (cur, buf, sizeof (buf))) < 0)
+	    return cur;
+	  next = mem_link_target (cur, buf, n);
+	}
+      free (cur);
+      cur = next;
+    }
+
+  free (cur);
+  errno = (i == MAX_SYMLINKS) ? ELOOP : ENOMEM;
+  return NULL;
+}
+
+static void
+mem_fill_stat (const struct mem_entry *me, struct stat *st)
+{
+  memset (st, 0, sizeof (struct stat));
+  st->st_ino = me->ino;
+  st->st_nlink = 1;
+  st->st_uid = me->uid;
+  st->st_gid = me->gid;
+  st->st_size = me->len;
+  st->st_mtim = me->mtime;
+  st->st_ctim = me->mtime;
+  if (me->type == MEM_SYMLINK)
+    st->st_mode = S_IFLNK | 0777;
+  else
+    st->st_mode = S_IFREG | (me->mode & 07777);
+}
+
+static int
+mem_lstat (const char *path, struct stat *st)
+{
+  struct mem_entry *me = mem_lookup (path);
+
+  if (me == NULL)
+    return lstat (path, st);
+  if (me->type == MEM_REMOVED)
+    {
+      errno = ENOENT;
+      return -1;
+    }
+
+  mem_fill_stat (me, st);
+  return 0;
+}
+
+static int
+mem_stat (const char *path, struct stat *st)
+{
+  char *real = mem_resolve (path);
+  int retval;
+
+  if (real == NULL)
+    return -1;
+  retval = mem_lstat (real, st);
+  if (retval == 0 && S_ISLNK (st->st_mode))
+    retval = stat (real, st);
+  free (real);
+
+  return retval;
+}
+
+static int
+mem_access (const char *path, int mode __attribute__ ((unused)))
+{
+  struct stat st;
+
+  return mem_stat (path, &st);
+}
+
+static FILE *
+mem_open_read (const char *path)
+{
+  char *real = mem_resolve (path);
+  struct mem_entry *me;
+  FILE *fp;
+
+  if (real == NULL)
+    return NULL;
+
+  me = mem_lookup (real);
+  if (me == NULL)
+    fp = fopen (real, "r");
+  else if (me->type == MEM_REMOVED)
+    {
+      errno = ENOENT;
+      fp = NULL;
+    }
+  else if (me->len == 0)
+    fp = fopen ("/dev/null", "r");
+  else if ((fp = fmemopen (NULL, me->len + 1, "w+")) != NULL)
+    {
+      /* a copy, another thread may replace the entry while fp
+	 is read; one byte more for the NUL fmemopen appends */
+      if (fwrite (me->data, 1, me->len, fp) != me->len ||
+	  fseek (fp, 0, SEEK_SET) != 0)
+	{
+	  fclose (fp);
+	  fp = NULL;
+	}
+    }
+
+  free (real);
+  return fp;
+}
+
+/* Copy a file or symlink which is not in memory yet.  */
+static struct mem_entry *
+mem_copy_up (const char *path)
+{
+  struct mem_entry *me = mem_lookup (path);
+  struct stat st;
+  char *data = NULL;
+  size_t len = 0;
+
+  if (me != NULL)
+    {
+      if (me->type != MEM_REMOVED)
+	return me;
+      errno = ENOENT;
+      return NULL;
+    }
+
+  if (lstat (path, &st) != 0)
+    return NULL;
+
+  if (S_ISLNK (st.st_mode))
+    {
+      char buf[PATH_MAX];
+      ssize_t n = readlink (path, buf, sizeof (buf));
+
+      if (n < 0 || (data = strndup (buf, n)) == NULL)
+	return NULL;
+      len = n;
+    }
+  else if (S_ISREG (st.st_mode))
+    {
+      FILE *fp = fopen (path, "r"), *out;
+      char tmp[4096];
+      size_t n;
+
+      if (fp == NULL)
+	return NULL;
+      out = open_memstream (&data, &len);
+      if (out == NULL)
+	{
+	  fclose (fp);
+	  return NULL;
+	}
+      while ((n = fread (tmp, 1, sizeof (tmp), fp)) > 0)
+	fwrite (tmp, 1, n, out);
+      fclose (fp);
+      if (fclose (out) != 0)
+	{
+	  free (data);
+	  return NULL;
+	}
+    }
+  else
+    {
+      errno = EISDIR;
+      return NULL;
+    }
+
+  if ((me = mem_entry (path)) == NULL)
+    {
+      free (data);
+      return NULL;
+    }
+  mem_set (me, S_ISLNK (st.st_mode) ? MEM_SYMLINK : MEM_FILE, data, len);
+  me->mode = st.st_mode;
+  me->uid = st.st_uid;
+  me->gid = st.st_gid;
+
+  return me;
+}
+
+static int
+mem_replace (const char *path, const char *buf, size_t len)
+{
+  struct mem_entry *me;
+  struct stat st;
+  char *data;
+
+  if ((data = malloc (len + 1)) == NULL)
+    {
+      fprintf (stderr, _("Out of memory\n"));
+      return -1;
+    }
+  memcpy (data, buf, len);
+  data[len] = '\0';
+
+  if (mem_stat (path, &st) != 0)
+    {
+      st.st_mode = DEF_MODE;
+      st.st_uid = getuid ();
+      st.st_gid = getgid ();
+    }
+
+  if ((me = mem_entry (path)) == NULL)
+    {
+      fprintf (stderr, _("Out of memory\n"));
+      free (data);
+      return -1;
+    }
+  mem_set (me, MEM_FILE, data, len);
+  me->mode = st.st_mode;
+  me->uid = st.st_uid;
+  me->gid = st.st_gid;
+
+  return 0;
+}
+
+static ssize_t
+mem_readlink (const char *path, char *buf, size_t size)
+{
+  struct mem_entry *me = mem_lookup (path);
+
+  if (me == NULL)
+    return readlink (path, buf, size);
+  if (me->type != MEM_SYMLINK)
+    {
+      errno = (me->type == MEM_REMOVED) ? ENOENT : EINVAL;
+      return -1;
+    }
+
+  if (size > me->len)
+    size = me->len;
+  memcpy (buf, me->data, size);
+  return size;
+}
+
+static int
+mem_symlink (const char *target, const char *path)
+{
+  struct mem_entry *me;
+  struct stat st;
+  char *data;
+
+  if (mem_lstat (path, &st) == 0)
+    {
+      errno = EEXIST;
+      return -1;
+    }
+
+  if ((data = strdup (target)) == NULL || (me = mem_entry (path)) == NULL)
+    {
+      free (data);
+      errno = ENOMEM;
+      return -1;
+    }
+  mem_set (me, MEM_SYMLINK, data, strlen (target));
+  me->uid = getuid ();
+  me->gid = getgid ();
+
+  return 0;
+}
+
+/* A hard link is a copy, nobody modifies a file in place.  */
+static int
+mem_link (const char *from, const char *to)
+{
+  struct mem_entry *src, *dst;
+  struct stat st;
+  char *data;
+
+  if (mem_lstat (to, &st) == 0)
+    {
+      errno = EEXIST;
+      return -1;
+    }
+  if ((src = mem_copy_up (from)) == NULL)
+    return -1;
+
+  if ((data = malloc (src->len + 1)) == NULL ||
+      (dst = mem_entry (to)) == NULL)
+    {
+      free (data);
+      errno = ENOMEM;
+      return -1;
+    }
+  memcpy (data, src->data, src->len);
+  data[src->len] = '\0';
+  mem_set (dst, src->type, data, src->len);
+  dst->mode = src->mode;
+  dst->uid = src->uid;
+  dst->gid = src->gid;
+  dst->ino = src->ino;
+
+  return 0;
+}
+
+static int
+mem_unlink (const char *path)
+{
+  struct mem_entry *me;
+  struct stat st;
+
+  if (mem_lstat (path, &st) != 0)
+    return -1;
+
+  if ((me = mem_entry (path)) == NULL)
+    return -1;
+  mem_set (me, MEM_REMOVED, NULL, 0);
+
+  return 0;
+}
+
+static int
+mem_rename (const char *from, const char *to)
+{
+  struct mem_entry *src, *dst;
+
+  if ((src = mem_copy_up (from)) == NULL)
+    return -1;
+  if (strcmp (from, to) == 0)
+    return 0;
+  if ((dst = mem_entry (to)) == NULL)
+    return -1;
+
+  /* mem_entry () may have appended, src is still valid */
+  free (dst->data);
+  dst->type = src->type;
+  dst->data = src->data;
+  dst->len = src->len;
+  dst->mode = src->mode;
+  dst->uid = src->uid;
+  dst->gid = src->gid;
+  dst->ino = src->ino;
+  dst->mtime = src->mtime;
+
+  src->data = NULL;
+  mem_set (src, MEM_REMOVED, NULL, 0);
+
+  return 0;
+}
+
+static int
+mem_add_dirent (struct dirent ***namelist, int *n, const char *name,
+		unsigned char type, int (*filter) (const struct dirent *))
+{
+  struct dirent *d, **tmp;
+
+  d = calloc (1, sizeof (struct dirent));
+  if (d == NULL)
+    return -1;
+  strncpy (d->d_name, name, sizeof (d->d_name) - 1);
+  d->d_type = type;
+
+  if (filter != NULL && !filter (d))
+    {
+      free (d);
+      return 0;
+    }
+
+  tmp = realloc (*namelist, (*n + 1) * sizeof (struct dirent *));
+  if (tmp == NULL)
+    {
+      free (d);
+      return -1;
+    }
+  *namelist = tmp;
+  (*namelist)[(*n)++] = d;
+
+  return 0;
+}
+
+static int
+mem_compare_dirent (const void *a, const void *b)
+{
+  const struct dirent *const *da = a;
+  const struct dirent *const *db = b;
+
+  return strcoll ((*da)->d_name, (*db)->d_name);
+}
+
+/* The names on disk without the removed ones, plus the names in
+   memory.  */
+static int
+mem_scandir (const char *dir, struct dirent ***namelist,
+	     int (*filter) (const struct dirent *))
+{
+  struct dirent **disk = NULL;
+  struct mem_entry *me;
+  size_t dlen = strlen (dir);
+  int ndisk, n = 0, i;
+
+  *namelist = NULL;
+
+  ndisk = scandir (dir, &disk, filter, alphasort);
+  for (i = 0; i < ndisk; i++)
+    {
+      char *path;
+
+      if (asprintf (&path, "%s/%s", dir, disk[i]->d_name) < 0)
+	goto error;
+      me = mem_lookup (path);
+      free (path);
+      if (me == NULL &&
+	  mem_add_dirent (namelist, &n, disk[i]->d_name, disk[i]->d_type,
+			  NULL) != 0)
+	goto error;
+    }
+
+  for (me = mem_entries; me != NULL; me = me->next)
+    if (me->type != MEM_REMOVED && strncmp (me->path, dir, dlen) == 0 &&
+	me->path[dlen] == '/' && strchr (&me->path[dlen + 1], '/') == NULL &&
+	mem_add_dirent (namelist, &n, &me->path[dlen + 1],
+			me->type == MEM_SYMLINK ? DT_LNK : DT_REG,
+			filter) != 0)
+      goto error;
+
+  for (i = 0; i < ndisk; i++)
+    free (disk[i]);
+  free (disk);
+
+  if (n == 0 && ndisk < 0)
+    {
+      errno = ENOENT;
+      return -1;
+    }
+  if (n > 0)
+    qsort (*namelist, n, sizeof (struct dirent *), &mem_compare_dirent);
+
+  return n;
+
+ error:
+  for (i = 0; i < ndisk; i++)
+    free (disk[i]);
+  free (disk);
+  for (i = 0; i < n; i++)
+    free ((*namelist)[i]);
+  free (*namelist);
+  errno = ENOMEM;
+  return -1;
+}
+
+/* locked_mem_NAME () calls mem_NAME () with mem_lock held, the
+   mem_* functions call each other without it.  */
+#define MEM_LOCKED(type, name, params, args)				\
+  static type								\
+  locked_mem_##name params						\
+  {									\
+    type retval;							\
+									\
+    pthread_mutex_lock (&mem_lock);					\
+    retval = mem_##name args;						\
+    pthread_mutex_unlock (&mem_lock);					\
+    return retval;							\
+  }
+
+MEM_LOCKED (FILE *, open_read, (const char *path), (path))
+MEM_LOCKED (int, replace, (const char *path, const char *buf, size_t len),
+	    (path, buf, len))
+MEM_LOCKED (int, stat, (const char *path, struct stat *st), (path, st))
+MEM_LOCKED (int, lstat, (const char *path, struct stat *st), (path, st))
+MEM_LOCKED (ssize_t, readlink, (const char *path, char *buf, size_t size),
+	    (path, buf, size))
+MEM_LOCKED (int, access, (const char *path, int mode), (path, mode))
+MEM_LOCKED (int, symlink, (const char *target, const char *path),
+	    (target, path))
+MEM_LOCKED (int, link, (const char *from, const char *to), (from, to))
+MEM_LOCKED (int, rename, (const char *from, const char *to), (from, to))
+MEM_LOCKED (int, unlink, (const char *path), (path))
+MEM_LOCKED (int, scandir, (const char *dir, struct dirent ***namelist,
+			   int (*filter) (const struct dirent *)),
+	    (dir, namelist, filter))
+
+const vfs_t vfs_memory = {
+  "memory",
+  &locked_mem_open_read,
+  &locked_mem_replace,
+  &locked_mem_stat,
+  &locked_mem_lstat,
+  &locked_mem_readlink,
+  &locked_mem_access,
+  &locked_mem_symlink,
+  &locked_mem_link,
+  &locked_mem_rename,
+  &locked_mem_unlink,
+  &locked_mem_scandir
+};
+
+__thread const vfs_t *vfs = &vfs_posix;
+__thread const char *module_root;
+
+int
+vfs_select (const char *name)
+{
+  if (strcmp (name, vfs_posix.name) == 0)
+    vfs = &vfs_posix;
+  else if (strcmp (name, vfs_memory.name) == 0)
+    vfs = &vfs_memory;
+  else
+    return -1;
+
+  return 0;
+}
+
+const char *
+vfs_module_root (void)
+{
+  return module_root ? module_root : "";
+}
+
+int
+vfs_have_module (const char *path)
+{
+  const char *root = vfs_module_root ();
+  char *real;
+  int retval;
+
+  if (*root == '\0')
+    return vfs->access (path, F_OK) == 0;
+
+  if (asprintf (&real, "%s%s", root, path) < 0)
+    return 0;
+  retval = vfs->access (real, F_OK) == 0;
+  free (real);
+
+  return retval;
+}
+
+int
+vfs_memory_add_file (const char *path, const char *buf, size_t len)
+{
+  return locked_mem_replace (path, buf, len);
+}
+
+/* Print every path changed in memory in the order of the first
+   change, relative to prefix.  */
+void
+vfs_memory_dump (FILE *out, const char *prefix)
+{
+  size_t plen = prefix ? strlen (prefix) : 0;
+  struct mem_entry *me;
+
+  pthread_mutex_lock (&mem_lock);
+  for (me = mem_entries; me != NULL; me = me->next)
+    {
+      const char *name = me->path;
+
+      if (plen > 0 && strncmp (name, prefix, plen) == 0 &&
+	  name[plen] == '/')
+	name += plen + 1;
+
+      switch (me->type)
+	{
+	case MEM_FILE:
+	  fprintf (out, "==> %s <==\n", name);
+	  fwrite (me->data, 1, me->len, out);
+	  if (me->len > 0 && me->data[me->len - 1] != '\n')
+	    fputc ('\n', out);
+	  break;
+	case MEM_SYMLINK:
+	  fprintf (out, "==> %s -> %.*s <==\n", name, (int) me->len,
+		   me->data);
+	  break;
+	case MEM_REMOVED:
+	  {
+	    struct stat st;
+
+	    /* created and removed again */
+	    if (lstat (me->path, &st) == 0)
+	      fprintf (out, "==> %s (removed) <==\n", name);
+	  }
+	  break;
+	}
+    }
+  pthread_mutex_unlock (&mem_lock);
+}
@@ -29,22 +29,44 @@
 
 #include "pam-config.h"
 
-#define DEF_MODE 0644
+
+/* TRUE if the file config exists and has exactly the content buf.  */
+int
+config_has_content (const char *config, const char *buf, size_t len)
+{
+  char tmp[4096];
+  size_t pos = 0;
+  int same = TRUE;
+  FILE *fp;
+
+  fp = vfs->open_read (config);
+  if (fp == NULL)
+    return FALSE;
+
+  while (same)
+    {
+      size_t n = fread (tmp, 1, sizeof (tmp), fp);
+
+      if (n == 0)
+	break;
+      if (pos + n > len || memcmp (tmp, buf + pos, n) != 0)
+	same = FALSE;
+      pos += n;
+    }
+  fclose (fp);
+
+  return same && pos == len;
+}
 
 int
 write_config (const char *sysconfdir, const char *file, write_type_t op, pam_module_t **module_list)
 {
   const char *opc = type2string (op);
-  struct stat f_stat;
-  char *tmpfname;
   FILE *fp;
-  int fd;
   int result = 0;
-  /* defaults for uid, gid and mode */
-  uid_t user_id = getuid();
-  gid_t group_id = getgid();
-  mode_t mode = DEF_MODE;
   char *config = NULL;
+  char *buf = NULL;
+  size_t len = 0;
 
   if (debug)
     printf ("*** write_config (%s, %s/pam.d/%s, ...)\n", opc, sysconfdir, file);
@@ -52,36 +74,14 @@ write_config (const char *sysconfdir, const char *file, write_type_t op, pam_mod
   if (asprintf (&config, "%s/pam.d/%s", sysconfdir, file) < 0)
     return -1;
 
-  if (asprintf (&tmpfname, "%s.XXXXXX", config) < 0)
-    return -1;
-
-  if ( stat (config, &f_stat) == 0 )
-    {
-      user_id = f_stat.st_uid;
-      group_id = f_stat.st_gid;
-      mode = f_stat.st_mode;
-    }
-
-  fd = mkstemp (tmpfname);
-  if (fchmod (fd, mode) < 0)
-    {
-      fprintf (stderr, _("Cannot set permissions for '%s': %m\n"),
-               tmpfname);
-      return 1;
-    }
-  if (fchown (fd, user_id, group_id) < 0)
-    {
-      fprintf (stderr,
-               _("Cannot change owner/group for `%s': %m\n"),
-               tmpfname);
-      return 1;
-    }
-
-  fp = fdopen(fd, "w");
+  /* The file is created in memory first and only written if the
+     content changed.  */
+  fp = open_memstream (&buf, &len);
   if (fp == NULL)
     {
       fprintf (stderr, _("Cannot create %s: %m\n"),
 	       config);
+      free (config);
       return -1;
     }
 
@@ -142,14 +142,44 @@ write_config (const char *sysconfdir, const char *file, write_type_t op, pam_mod
 
   while (*modptr != NULL)
     {
+      struct timespec start;
+
+      STATS_MODULE_BEGIN (start);
+      TRACE_BEGIN (start);
       result |= (*modptr)->write_config (*modptr, op, fp);
+      TRACE_END (start, "write_config", (*modptr)->name, op, file);
+      STATS_MODULE_END ((*modptr)->name, start);
       ++modptr;
     }
 
-  fclose (fp);
+  if (fclose (fp) != 0)
+    {
+      fprintf (stderr, _("Out of memory\n"));
+      free (config);
+      return -1;
+    }
+
+  if (plan_mode)
+    {
+      fp = plan_create_file (file, FALSE);
+      if (fp == NULL)
+	result = -1;
+      else
+	{
+	  fwrite (buf, 1, len, fp);
+	  result |= plan_close_file (fp);
+	}
+    }
+  else if (config_has_content (config, buf, len))
+    {
+      if (debug)
+	printf ("*** %s unchanged, not written\n", config);
+    }
+  else
+    result |= vfs->replace (config, buf, len);
 
-  rename (tmpfname, config);
-  free (tmpfname);
+  free (buf);
+  free (config);
 
   return result;
 }
@@ -0,0 +1,305 @@
+/* Fuzz harnesses of the config file parsers. The parser is chosen
+   at compile time:
+
+     -DFUZZ_LOAD_CONFIG     the input is every common-*-pc file and a
+			    service file, loaded with load_config()
+     -DFUZZ_MODULE_OPTIONS  the input is the argument string passed
+			    to the parse_config function of every module
+     -DFUZZ_OBSOLETE_CONF   the input is pam_unix2.conf and
+			    pam_pwcheck.conf for load_obsolete_conf()
+
+   All files are kept in the memory vfs backend, nothing is read
+   from or written to disk.
+
+   Built with -DFUZZ_LIBFUZZER, only LLVMFuzzerTestOneInput() is
+   defined for libFuzzer. Else main() runs every file or directory
+   given on the command line (the seed corpus) and prints the
+   executions per second:
+
+     fuzz-<parser> [-r runs] [file|dir ...]
+
+   Without files, the input is read from stdin once, as afl-fuzz
+   expects it.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "pam-config.h"
+
+#define FUZZ_CONFDIR "/fuzz"
+
+int LLVMFuzzerTestOneInput (const uint8_t *data, size_t size);
+
+static void
+clear_options (pam_module_t **module_list)
+{
+  pam_module_t **modptr;
+  write_type_t type;
+
+  for (modptr = module_list; *modptr != NULL; modptr++)
+    for (type = AUTH; type <= SESSION; type++)
+      clear_opt_set ((*modptr)->get_opt_set (*modptr, type));
+}
+
+#if defined (FUZZ_LOAD_CONFIG)
+
+static const char *const common_files[] = {
+  CONF_ACCOUNT_PC, CONF_AUTH_PC, CONF_PASSWORD_PC, CONF_SESSION_PC
+};
+
+static void
+add_file (const char *file, const uint8_t *data, size_t size)
+{
+  char *path;
+
+  if (asprintf (&path, "%s/%s", FUZZ_CONFDIR, file) < 0)
+    abort ();
+  if (vfs_memory_add_file (path, (const char *) data, size) != 0)
+    abort ();
+  free (path);
+}
+
+static void
+run_parser (const uint8_t *data, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof (common_files) / sizeof (common_files[0]); i++)
+    {
+      char *file;
+
+      if (asprintf (&file, "pam.d/%s", common_files[i]) < 0)
+	abort ();
+      add_file (file, data, size);
+      free (file);
+    }
+  add_file ("pam.d/fuzz", data, size);
+
+  load_all_types (confdir, NULL, common_module_list);
+  load_all_types (confdir, "fuzz", service_module_list);
+}
+
+#elif defined (FUZZ_MODULE_OPTIONS)
+
+static void
+parse_options (pam_module_t **module_list, const uint8_t *data, size_t size)
+{
+  pam_module_t **modptr;
+  write_type_t type;
+
+  for (modptr = module_list; *modptr != NULL; modptr++)
+    for (type = AUTH; type <= SESSION; type++)
+      {
+	/* the parsers split the arguments in place */
+	char *args = strndup ((const char *) data, size);
+
+	if (args == NULL)
+	  abort ();
+	(*modptr)->parse_config (*modptr, args, type);
+	free (args);
+      }
+}
+
+static void
+run_parser (const uint8_t *data, size_t size)
+{
+  parse_options (common_module_list, data, size);
+  parse_options (service_module_list, data, size);
+}
+
+#elif defined (FUZZ_OBSOLETE_CONF)
+
+static void
+run_parser (const uint8_t *data, size_t size)
+{
+  /* load_obsolete_conf() uses absolute paths */
+  if (vfs_memory_add_file ("/etc/security/pam_unix2.conf",
+			   (const char *) data, size) != 0 ||
+      vfs_memory_add_file ("/etc/security/pam_pwcheck.conf",
+			   (const char *) data, size) != 0)
+    abort ();
+
+  load_obsolete_conf (common_module_list);
+}
+
+#else
+#error "Define FUZZ_LOAD_CONFIG, FUZZ_MODULE_OPTIONS or FUZZ_OBSOLETE_CONF"
+#endif
+
+int
+LLVMFuzzerTestOneInput (const uint8_t *data, size_t size)
+{
+  static int initialized;
+
+  if (!initialized)
+    {
+      vfs_select ("memory");
+      confdir = strdup (FUZZ_CONFDIR);
+      cachedir = NULL;
+      initialized = 1;
+    }
+
+  run_parser (data, size);
+
+  clear_options (common_module_list);
+  clear_options (service_module_list);
+
+  return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+
+struct input {
+  char *data;
+  size_t size;
+  struct input *next;
+};
+
+static struct input *inputs;
+static struct input **inputs_tail = &inputs;
+static size_t ninputs;
+
+static int
+read_input (FILE *fp, const char *name)
+{
+  struct input *in = calloc (1, sizeof (struct input));
+  char buf[4096];
+  size_t n;
+
+  /* like libFuzzer, never pass NULL, even for empty files */
+  if (in == NULL || (in->data = malloc (1)) == NULL)
+    abort ();
+
+  while ((n = fread (buf, 1, sizeof (buf), fp)) > 0)
+    {
+      if ((in->data = realloc (in->data, in->size + n)) == NULL)
+	abort ();
+      memcpy (in->data + in->size, buf, n);
+      in->size += n;
+    }
+  if (ferror (fp))
+    {
+      fprintf (stderr, "Cannot read %s: %m\n", name);
+      free (in->data);
+      free (in);
+      return -1;
+    }
+
+  *inputs_tail = in;
+  inputs_tail = &in->next;
+  ninputs++;
+
+  return 0;
+}
+
+static int
+read_path (const char *path)
+{
+  struct stat st;
+  FILE *fp;
+  int retval;
+
+  if (stat (path, &st) != 0)
+    {
+      fprintf (stderr, "Cannot stat %s: %m\n", path);
+      return -1;
+    }
+
+  if (S_ISDIR (st.st_mode))
+    {
+      struct dirent **namelist;
+      int n, i;
+
+      if ((n = scandir (path, &namelist, NULL, alphasort)) < 0)
+	{
+	  fprintf (stderr, "Cannot read %s: %m\n", path);
+	  return -1;
+	}
+
+      retval = 0;
+      for (i = 0; i < n; i++)
+	{
+	  char *sub;
+
+	  if (namelist[i]->d_name[0] != '.')
+	    {
+	      if (asprintf (&sub, "%s/%s", path, namelist[i]->d_name) < 0)
+		abort ();
+	      if (read_path (sub) != 0)
+		retval = -1;
+	      free (sub);
+	    }
+	  free (namelist[i]);
+	}
+      free (namelist);
+      return retval;
+    }
+
+  if (!S_ISREG (st.st_mode))
+    return 0;
+
+  if ((fp = fopen (path, "r")) == NULL)
+    {
+      fprintf (stderr, "Cannot open %s: %m\n", path);
+      return -1;
+    }
+  retval = read_input (fp, path);
+  fclose (fp);
+
+  return retval;
+}
+
+int
+main (int argc, char *argv[])
+{
+  struct timespec start, end;
+  struct input *in;
+  unsigned long runs = 1, i;
+  double secs;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "r:")) != -1)
+    switch (opt)
+      {
+      case 'r':
+	runs = strtoul (optarg, NULL, 10);
+	break;
+      default:
+	fprintf (stderr, "Usage: %s [-r runs] [file|dir ...]\n", argv[0]);
+	return 1;
+      }
+
+  if (optind == argc)
+    {
+      if (read_input (stdin, "stdin") != 0)
+	return 1;
+    }
+  else
+    for (; optind < argc; optind++)
+      if (read_path (argv[optind]) != 0)
+	return 1;
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < runs; i++)
+    for (in = inputs; in != NULL; in = in->next)
+      LLVMFuzzerTestOneInput ((const uint8_t *) in->data, in->size);
+  clock_gettime (CLOCK_MONOTONIC, &end);
+
+  secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf ("%s: %lu execs in %.3f s, %.0f execs/s\n", argv[0],
+	  runs * ninputs, secs, secs > 0 ? runs * ninputs / secs : 0.0);
+
+  return 0;
+}
+
+#endif
@@ -0,0 +1,122 @@
+/* Test of the libpamconfig API: two contexts on different
+   directories are modified by two threads at the same time and
+   must not see the changes of each other.
+
+   Usage: libpamconfig-test <confdir1> <confdir2>  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "pamconfig.h"
+
+#define ROUNDS 1000
+
+struct worker {
+  pamconfig_ctx_t *ctx;
+  const char *option;
+  int errors;
+};
+
+static void *
+toggle_option (void *arg)
+{
+  struct worker *w = arg;
+  int i;
+
+  for (i = 0; i < ROUNDS; i++)
+    if (pamconfig_enable (w->ctx, "pam_unix2.so", "auth", w->option,
+			  i & 1) != 0 ||
+	pamconfig_is_enabled (w->ctx, "pam_unix2.so", "auth",
+			      w->option) != (i & 1))
+      w->errors++;
+
+  return NULL;
+}
+
+static void
+print_state (const char *name, pamconfig_ctx_t *ctx)
+{
+  char *value = pamconfig_get_string (ctx, "pam_unix2.so", "auth",
+				      "call_modules");
+
+  printf ("%s: pam_unix2.so auth enabled=%d nullok=%d debug=%d "
+	  "call_modules=%s\n", name,
+	  pamconfig_is_enabled (ctx, "pam_unix2.so", "auth", NULL),
+	  pamconfig_is_enabled (ctx, "pam_unix2.so", "auth", "nullok"),
+	  pamconfig_is_enabled (ctx, "pam_unix2.so", "auth", "debug"),
+	  value ? value : "(null)");
+  free (value);
+}
+
+int
+main (int argc, char *argv[])
+{
+  struct worker w1, w2;
+  pthread_t t1, t2;
+
+  if (argc != 3)
+    {
+      fprintf (stderr, "Usage: %s confdir1 confdir2\n", argv[0]);
+      return 1;
+    }
+
+  if (pamconfig_new ("relative") != NULL)
+    printf ("relative confdir accepted\n");
+
+  w1.ctx = pamconfig_new (argv[1]);
+  w2.ctx = pamconfig_new (argv[2]);
+  if (w1.ctx == NULL || w2.ctx == NULL)
+    return 1;
+  w1.option = "nullok";
+  w2.option = "trace";
+  w1.errors = w2.errors = 0;
+
+  if (pamconfig_load (w1.ctx, NULL) != 0 ||
+      pamconfig_load (w2.ctx, NULL) != 0)
+    return 1;
+
+  pamconfig_set_string (w2.ctx, "pam_unix2.so", "auth", "call_modules",
+			"krb5");
+  print_state ("ctx1", w1.ctx);
+  print_state ("ctx2", w2.ctx);
+
+  pthread_create (&t1, NULL, toggle_option, &w1);
+  pthread_create (&t2, NULL, toggle_option, &w2);
+  pthread_join (t1, NULL);
+  pthread_join (t2, NULL);
+  printf ("errors: %d %d\n", w1.errors, w2.errors);
+
+  print_state ("ctx1", w1.ctx);
+  print_state ("ctx2", w2.ctx);
+  printf ("trace ctx1: %d\n",
+	  pamconfig_is_enabled (w1.ctx, "pam_unix2.so", "auth", "trace"));
+
+  printf ("unknown module: %d\n",
+	  pamconfig_enable (w1.ctx, "pam_fnord.so", "auth", NULL, 1));
+  printf ("unknown option: %d\n",
+	  pamconfig_is_enabled (w1.ctx, "pam_unix2.so", "auth", "fnord"));
+  printf ("unknown string option: %d\n",
+	  pamconfig_set_string (w1.ctx, "pam_unix2.so", "auth", "fnord", "x"));
+  printf ("unknown type: %d\n",
+	  pamconfig_is_enabled (w1.ctx, "pam_unix2.so", "fnord", NULL));
+  printf ("type never used: %d %d\n",
+	  pamconfig_is_enabled (w1.ctx, "pam_ssh.so", "account", NULL),
+	  pamconfig_enable (w1.ctx, "pam_exec.so", "auth", NULL, 1));
+
+  pamconfig_enable (w1.ctx, "pam_unix2.so", "auth", "debug", 0);
+  printf ("commit ctx1: %d\n", pamconfig_commit (w1.ctx));
+  printf ("plan ctx2: %d\n", pamconfig_plan (w2.ctx));
+
+  /* a new context sees what was written */
+  pamconfig_free (w1.ctx);
+  w1.ctx = pamconfig_new (argv[1]);
+  if (w1.ctx == NULL || pamconfig_load (w1.ctx, NULL) != 0)
+    return 1;
+  print_state ("ctx1", w1.ctx);
+
+  pamconfig_free (w1.ctx);
+  pamconfig_free (w2.ctx);
+
+  return 0;
+}
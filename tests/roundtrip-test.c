@@ -0,0 +1,471 @@
+/* Round trip test of the common-*-pc files: random option states
+   of all modules are written with write_common_config(), parsed again
+   with load_config() and written a second time. The state after the
+   first parse is the one pam-config can express, parsing its files
+   again has to give the same state and the same bytes.
+
+   Usage: roundtrip-test [-j jobs] [-n cases] [-s seed]
+
+   Everything is kept in the memory vfs backend. Prints the number
+   of cases, how many of the random option values survived the
+   first round trip and the render and parse throughput.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "pam-config.h"
+
+#define RT_CONFDIR "/roundtrip"
+
+static const struct {
+  const char *file;
+  write_type_t type;
+} common_files[] = {
+  {CONF_ACCOUNT_PC, ACCOUNT},
+  {CONF_AUTH_PC, AUTH},
+  {CONF_PASSWORD_PC, PASSWORD},
+  {CONF_SESSION_PC, SESSION}
+};
+#define NFILES (sizeof (common_files) / sizeof (common_files[0]))
+
+/* The option state of all common modules, in the order of
+   common_module_list and of the types.  */
+typedef struct {
+  int *bool_values;
+  char **string_values;
+  size_t nbool, nstring;
+} state_t;
+
+static unsigned long long rng_state;
+static size_t state_size;
+
+/* Every case has its own start value, so a case only depends on
+   the seed and its number, not on the number of jobs.  */
+static void
+seed_case (unsigned long seed, unsigned long i)
+{
+  /* splitmix64 of both, xorshift must not start with 0 */
+  unsigned long long z = seed * 0x9E3779B97F4A7C15ULL + i + 1;
+
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  rng_state = (z ^ (z >> 31)) | 1;
+}
+
+/* xorshift64* */
+static unsigned long
+rng (void)
+{
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return (rng_state * 2685821657736338717ULL) >> 32;
+}
+
+static int
+chance (unsigned int percent)
+{
+  return rng () % 100 < percent;
+}
+
+static char *
+random_value (void)
+{
+  static const char chars[] =
+    "abcdefghijklmnopqrstuvwxyz0123456789_./-";
+  size_t len = 1 + rng () % 8, i;
+  char *value = malloc (len + 1);
+
+  if (value == NULL)
+    abort ();
+  for (i = 0; i < len; i++)
+    value[i] = chars[rng () % (sizeof (chars) - 1)];
+  value[len] = '\0';
+
+  return value;
+}
+
+/* Call fn for every option set of the common modules. Types may
+   share an option set, fn sees it more than once then.  */
+static void
+for_each_opt_set (void (*fn) (option_set_t *, state_t *), state_t *state)
+{
+  pam_module_t **modptr;
+  write_type_t type;
+
+  for (modptr = common_module_list; *modptr != NULL; modptr++)
+    for (type = AUTH; type <= SESSION; type++)
+      fn ((*modptr)->get_opt_set (*modptr, type), state);
+}
+
+static void
+count_opt_set (option_set_t *opt_set, state_t *state)
+{
+  state->nbool += count_opts (opt_set->bool_keys);
+  state->nstring += count_opts (opt_set->string_keys);
+}
+
+static void
+save_opt_set (option_set_t *opt_set, state_t *state)
+{
+  size_t i;
+
+  for (i = 0; opt_set->bool_keys[i] != NULL; i++)
+    state->bool_values[state->nbool++] = opt_set->bool_values[i];
+  for (i = 0; opt_set->string_keys[i] != NULL; i++)
+    {
+      const char *value = opt_set->string_values[i];
+
+      state->string_values[state->nstring++] = value ? strdup (value) : NULL;
+    }
+}
+
+static void
+clear_values (option_set_t *opt_set, state_t *state __attribute__ ((unused)))
+{
+  clear_opt_set (opt_set);
+}
+
+/* Options are only valid for enabled modules.  */
+static void
+randomize_opt_set (option_set_t *opt_set,
+		   state_t *state __attribute__ ((unused)))
+{
+  int enabled = chance (50);
+  size_t i;
+
+  for (i = 0; opt_set->bool_keys[i] != NULL; i++)
+    opt_set->bool_values[i] =
+      strcmp (opt_set->bool_keys[i], "is_enabled") == 0 ? enabled :
+      enabled && chance (30);
+  for (i = 0; opt_set->string_keys[i] != NULL; i++)
+    {
+      free (opt_set->string_values[i]);
+      opt_set->string_values[i] =
+	enabled && chance (20) ? random_value () : NULL;
+    }
+}
+
+static void
+save_state (state_t *state)
+{
+  memset (state, 0, sizeof (state_t));
+  for_each_opt_set (&count_opt_set, state);
+  state->bool_values = calloc (state->nbool + 1, sizeof (int));
+  state->string_values = calloc (state->nstring + 1, sizeof (char *));
+  if (state->bool_values == NULL || state->string_values == NULL)
+    abort ();
+  state->nbool = state->nstring = 0;
+  for_each_opt_set (&save_opt_set, state);
+}
+
+static void
+free_state (state_t *state)
+{
+  size_t i;
+
+  for (i = 0; i < state->nstring; i++)
+    free (state->string_values[i]);
+  free (state->string_values);
+  free (state->bool_values);
+}
+
+/* Returns the number of option values which differ.  */
+static size_t
+diff_state (const state_t *a, const state_t *b)
+{
+  size_t i, n = 0;
+
+  for (i = 0; i < a->nbool; i++)
+    if (a->bool_values[i] != b->bool_values[i])
+      n++;
+  for (i = 0; i < a->nstring; i++)
+    {
+      const char *va = a->string_values[i], *vb = b->string_values[i];
+
+      if ((va == NULL) != (vb == NULL) || (va && strcmp (va, vb) != 0))
+	n++;
+    }
+
+  return n;
+}
+
+/* Print every option which differs between a and b.  */
+static void
+print_difference (const state_t *a, const state_t *b)
+{
+  pam_module_t **modptr;
+  write_type_t type;
+  size_t nbool = 0, nstring = 0, i;
+
+  for (modptr = common_module_list; *modptr != NULL; modptr++)
+    for (type = AUTH; type <= SESSION; type++)
+      {
+	option_set_t *opt_set = (*modptr)->get_opt_set (*modptr, type);
+
+	for (i = 0; opt_set->bool_keys[i] != NULL; i++, nbool++)
+	  if (a->bool_values[nbool] != b->bool_values[nbool])
+	    printf ("  %s %s %s: %d -> %d\n", (*modptr)->name,
+		    type2string (type), opt_set->bool_keys[i],
+		    a->bool_values[nbool], b->bool_values[nbool]);
+	for (i = 0; opt_set->string_keys[i] != NULL; i++, nstring++)
+	  {
+	    const char *va = a->string_values[nstring];
+	    const char *vb = b->string_values[nstring];
+
+	    if ((va == NULL) != (vb == NULL) || (va && strcmp (va, vb) != 0))
+	      printf ("  %s %s %s: '%s' -> '%s'\n", (*modptr)->name,
+		      type2string (type), opt_set->string_keys[i],
+		      va ? va : "(null)", vb ? vb : "(null)");
+	  }
+      }
+}
+
+static double
+now (void)
+{
+  struct timespec t;
+
+  clock_gettime (CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static double render_time, parse_time;
+
+/* Write all common-*-pc files like pam-config does and return
+   their concatenated content.  */
+static char *
+render (size_t *len)
+{
+  double start = now ();
+  char *all = NULL;
+  size_t i;
+  FILE *out = open_memstream (&all, len);
+
+  if (out == NULL)
+    abort ();
+
+  if (write_common_config () != 0)
+    {
+      fprintf (stderr, "write_common_config () failed\n");
+      exit (1);
+    }
+
+  for (i = 0; i < NFILES; i++)
+    {
+      char *path, buf[4096];
+      size_t n;
+      FILE *fp;
+
+      if (asprintf (&path, "%s/pam.d/%s", confdir, common_files[i].file) < 0 ||
+	  (fp = vfs->open_read (path)) == NULL)
+	abort ();
+      while ((n = fread (buf, 1, sizeof (buf), fp)) > 0)
+	fwrite (buf, 1, n, out);
+      fclose (fp);
+      free (path);
+    }
+  fclose (out);
+
+  render_time += now () - start;
+  return all;
+}
+
+static void
+parse (void)
+{
+  double start = now ();
+  size_t i;
+
+  for_each_opt_set (&clear_values, NULL);
+  for (i = 0; i < NFILES; i++)
+    if (load_config (confdir, common_files[i].file, common_files[i].type,
+		     common_module_list, TRUE) != 0)
+      {
+	fprintf (stderr, "load_config (%s) failed\n", common_files[i].file);
+	exit (1);
+      }
+
+  parse_time += now () - start;
+}
+
+/* Run case i, returns the number of random option values lost by
+   the first round trip or -1 if the case failed.  */
+static long
+run_case (unsigned long seed, unsigned long i)
+{
+  state_t random, first, second;
+  char *out1, *out2;
+  size_t len1, len2;
+  long lost = -1;
+
+  seed_case (seed, i);
+  for_each_opt_set (&randomize_opt_set, NULL);
+  save_state (&random);
+  free (render (&len1));
+  parse ();
+  save_state (&first);
+  out1 = render (&len1);
+  parse ();
+  save_state (&second);
+  out2 = render (&len2);
+
+  if (diff_state (&first, &second) != 0)
+    {
+      printf ("case %lu: the state changed after the second parse:\n", i);
+      print_difference (&first, &second);
+      printf ("%s", out1);
+    }
+  else if (len1 != len2 || memcmp (out1, out2, len1) != 0)
+    printf ("case %lu: the output changed:\n%s---\n%s", i, out1, out2);
+  else
+    lost = diff_state (&random, &first);
+
+  free_state (&random);
+  free_state (&first);
+  free_state (&second);
+  free (out1);
+  free (out2);
+
+  return lost;
+}
+
+/* What a job sends back to main().  */
+struct result {
+  int failed;
+  size_t values, lost;
+  double render_time, parse_time;
+};
+
+/* Run every case i with i % jobs == job.  */
+static void
+run_job (unsigned long seed, unsigned long cases, unsigned long jobs,
+	 unsigned long job, struct result *res)
+{
+  unsigned long i;
+
+  memset (res, 0, sizeof (struct result));
+  for (i = job; i < cases; i += jobs)
+    {
+      long lost = run_case (seed, i);
+
+      if (lost < 0)
+	{
+	  res->failed = 1;
+	  break;
+	}
+      res->lost += lost;
+      res->values += state_size;
+    }
+  res->render_time = render_time;
+  res->parse_time = parse_time;
+}
+
+int
+main (int argc, char *argv[])
+{
+  unsigned long cases = 10000, seed = 1, jobs = 1, job;
+  struct result total, res;
+  double start;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "j:n:s:")) != -1)
+    switch (opt)
+      {
+      case 'j':
+	jobs = strtoul (optarg, NULL, 10);
+	if (jobs < 1)
+	  jobs = 1;
+	break;
+      case 'n':
+	cases = strtoul (optarg, NULL, 10);
+	break;
+      case 's':
+	seed = strtoul (optarg, NULL, 10);
+	break;
+      default:
+	fprintf (stderr, "Usage: %s [-j jobs] [-n cases] [-s seed]\n",
+		 argv[0]);
+	return 1;
+      }
+
+  vfs_select ("memory");
+  confdir = strdup (RT_CONFDIR);
+  cachedir = NULL;
+  /* some modules look for service files using them */
+  vfs_memory_add_file (RT_CONFDIR "/pam.d/login", "#%PAM-1.0\n", 10);
+  {
+    state_t empty;
+
+    save_state (&empty);
+    state_size = empty.nbool + empty.nstring;
+    free_state (&empty);
+  }
+
+  start = now ();
+  if (jobs == 1)
+    run_job (seed, cases, 1, 0, &total);
+  else
+    {
+      /* All state is global, so every job is a process which
+	 writes its result into a pipe.  */
+      int fds[2];
+
+      fflush (stdout);
+      if (pipe (fds) != 0)
+	abort ();
+      for (job = 0; job < jobs; job++)
+	{
+	  pid_t pid = fork ();
+
+	  if (pid < 0)
+	    abort ();
+	  if (pid == 0)
+	    {
+	      close (fds[0]);
+	      run_job (seed, cases, jobs, job, &res);
+	      fflush (stdout);
+	      if (write (fds[1], &res, sizeof (res)) != sizeof (res))
+		_exit (1);
+	      _exit (0);
+	    }
+	}
+      close (fds[1]);
+
+      memset (&total, 0, sizeof (total));
+      for (job = 0; job < jobs; job++)
+	{
+	  if (read (fds[0], &res, sizeof (res)) != sizeof (res))
+	    res.failed = 1;
+	  total.failed |= res.failed;
+	  total.values += res.values;
+	  total.lost += res.lost;
+	  total.render_time += res.render_time;
+	  total.parse_time += res.parse_time;
+	}
+      close (fds[0]);
+      while (wait (NULL) > 0)
+	;
+    }
+
+  if (total.failed)
+    return 1;
+
+  printf ("%lu cases, %.1f%% of the option values kept by the first round trip\n",
+	  cases, total.values ?
+	  100.0 * (total.values - total.lost) / total.values : 100.0);
+  /* render and parse are per job */
+  printf ("%.0f cases/s, render %.0f/s, parse %.0f/s\n",
+	  cases / (now () - start), 3 * cases / total.render_time,
+	  2 * cases / total.parse_time);
+
+  return 0;
+}
@@ -0,0 +1,452 @@
+/* Unit tests and micro benchmarks of the service file list in
+   single_config.c: insert_if(), remove_module() and the predicates of
+   pam_cryptpass, which uses both on the loaded service file.
+
+   Usage: single-config-test [-b] [-n lines] [-o file]
+
+   Without -b, every test runs on generated lists of 1 up to 1000
+   lines and prints one line per test. With -b, every operation is
+   timed on lists of 1 up to -n lines (default 100000) and the ns per
+   operation are printed as JSON, into file with -o.
+
+   Service files are kept in the memory vfs backend.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pam-config.h"
+
+#define SC_CONFDIR "/single"
+#define SC_SERVICE "svc"
+
+static const char *const types[] = {"auth", "account", "password", "session"};
+
+/* Line i of n generated lines, the four types in their usual order.  */
+static char *
+gen_line (unsigned long i, unsigned long n)
+{
+  char *line;
+
+  if (asprintf (&line, "%s\trequired\tpam_gen%lu.so\n",
+		types[i * 4 / n], i) < 0)
+    abort ();
+  return line;
+}
+
+static config_content_t *
+gen_list (unsigned long n)
+{
+  config_content_t *list = NULL, **tail = &list;
+  unsigned long i;
+
+  for (i = 0; i < n; i++)
+    {
+      config_content_t *elem = malloc (sizeof (config_content_t));
+
+      if (elem == NULL)
+	abort ();
+      elem->line = gen_line (i, n);
+      elem->next = NULL;
+      *tail = elem;
+      tail = &elem->next;
+    }
+  return list;
+}
+
+static void
+free_list (config_content_t *list)
+{
+  while (list != NULL)
+    {
+      config_content_t *next = list->next;
+
+      free (list->line);
+      free (list);
+      list = next;
+    }
+}
+
+static unsigned long
+list_length (const config_content_t *list)
+{
+  unsigned long n = 0;
+
+  for (; list != NULL; list = list->next)
+    n++;
+  return n;
+}
+
+/* The generated lines without line skip, with the lines added at
+   added_pos, or -1 for none.  */
+static int
+list_is (const config_content_t *list, unsigned long n, unsigned long skip,
+	 long added_pos, const char *added)
+{
+  unsigned long i;
+  long pos = 0;
+
+  for (i = 0; i <= n; i++, pos++)
+    {
+      if (pos == added_pos)
+	{
+	  if (list == NULL || strcmp (list->line, added) != 0)
+	    return FALSE;
+	  list = list->next;
+	}
+      if (i < n && i != skip)
+	{
+	  char *line = gen_line (i, n);
+	  int same = list != NULL && strcmp (list->line, line) == 0;
+
+	  free (line);
+	  if (!same)
+	    return FALSE;
+	  list = list->next;
+	}
+    }
+  return list == NULL;
+}
+
+static int
+pred_true (config_content_t *cfg_content __attribute__ ((unused)))
+{
+  return TRUE;
+}
+
+static int
+pred_false (config_content_t *cfg_content __attribute__ ((unused)))
+{
+  return FALSE;
+}
+
+static int
+pred_last (config_content_t *cfg_content)
+{
+  return cfg_content->next == NULL;
+}
+
+static int failed;
+
+#define CHECK(name, n, expr)						\
+  do {									\
+    if (!(expr))							\
+      {									\
+	printf ("FAIL: %s, %lu lines: %s\n", name, (unsigned long) (n),	\
+		#expr);							\
+	failed++;							\
+      }									\
+  } while (0)
+
+static void
+test_list (unsigned long n)
+{
+  config_content_t *list;
+  char *line;
+
+  /* every line, the head first */
+  list = gen_list (n);
+  CHECK ("remove all", n, remove_module (&list, "pam_gen") == (int) n);
+  CHECK ("remove all", n, list == NULL);
+
+  /* the head only, the list may become empty */
+  list = gen_list (n);
+  CHECK ("remove head", n, remove_module (&list, "\tpam_gen0.so") == 1);
+  CHECK ("remove head", n, list_is (list, n, 0, -1, NULL));
+  free_list (list);
+
+  /* the last line */
+  list = gen_list (n);
+  if (asprintf (&line, "\tpam_gen%lu.so", n - 1) < 0)
+    abort ();
+  CHECK ("remove last", n, remove_module (&list, line) == 1);
+  CHECK ("remove last", n, list_is (list, n, n - 1, -1, NULL));
+  free (line);
+  free_list (list);
+
+  list = gen_list (n);
+  CHECK ("remove none", n, remove_module (&list, "pam_none.so") == 0);
+  CHECK ("remove none", n, list_is (list, n, n, -1, NULL));
+  free_list (list);
+
+  list = gen_list (n);
+  CHECK ("insert before head", n,
+	 insert_if (&list, "new\n", &pred_true, BEFORE) == TRUE);
+  CHECK ("insert before head", n, list_is (list, n, n, 0, "new\n"));
+  free_list (list);
+
+  list = gen_list (n);
+  CHECK ("insert after head", n,
+	 insert_if (&list, "new\n", &pred_true, AFTER) == TRUE);
+  CHECK ("insert after head", n, list_is (list, n, n, 1, "new\n"));
+  free_list (list);
+
+  list = gen_list (n);
+  CHECK ("insert after last", n,
+	 insert_if (&list, "new\n", &pred_last, AFTER) == TRUE);
+  CHECK ("insert after last", n, list_is (list, n, n, n, "new\n"));
+  free_list (list);
+
+  list = gen_list (n);
+  CHECK ("insert without match", n,
+	 insert_if (&list, "new\n", &pred_false, AFTER) == FALSE);
+  CHECK ("insert without match", n, list_is (list, n, n, -1, NULL));
+  free_list (list);
+
+  /* a line already in the file is not added again */
+  list = gen_list (n);
+  line = gen_line (n - 1, n);
+  CHECK ("insert existing", n,
+	 insert_if (&list, line, &pred_false, BEFORE) == TRUE);
+  CHECK ("insert existing", n, list_is (list, n, n, -1, NULL));
+  free (line);
+  free_list (list);
+}
+
+static void
+test_heads (void)
+{
+  config_content_t *list = gen_list (10);
+
+  /* the first three lines are auth, the new head has to be checked
+     again after removing the old one */
+  CHECK ("remove three heads", 10, remove_module (&list, "auth") == 3);
+  CHECK ("remove three heads", 10, list_length (list) == 7 &&
+	 strncmp (list->line, "account\t", 8) == 0);
+  free_list (list);
+
+  list = NULL;
+  CHECK ("insert into empty", 0,
+	 insert_if (&list, "new\n", &pred_true, BEFORE) == FALSE);
+  CHECK ("remove from empty", 0, remove_module (&list, "new") == 0);
+}
+
+static void
+set_service (const char *content)
+{
+  if (vfs_memory_add_file (SC_CONFDIR "/pam.d/" SC_SERVICE, content,
+			   strlen (content)) != 0)
+    abort ();
+}
+
+/* The service file after pam_cryptpass wrote it, or NULL.  */
+static char *
+write_cryptpass (int session, int password)
+{
+  pam_module_t *cryptpass = lookup (service_module_list, "pam_cryptpass.so");
+  pam_module_t *mount = lookup (service_module_list, "pam_mount.so");
+  option_set_t *opt_set;
+  char *content = NULL, buf[4096];
+  size_t len = 0, n;
+  FILE *fp, *out;
+
+  opt_set = cryptpass->get_opt_set (cryptpass, SESSION);
+  opt_set->enable (opt_set, "is_enabled", session);
+  opt_set = cryptpass->get_opt_set (cryptpass, PASSWORD);
+  opt_set->enable (opt_set, "is_enabled", password);
+  opt_set = mount->get_opt_set (mount, AUTH);
+  opt_set->enable (opt_set, "is_enabled", TRUE);
+
+  if (cryptpass->write_config (cryptpass, SESSION, NULL) != 0)
+    return NULL;
+
+  if ((fp = vfs->open_read (SC_CONFDIR "/pam.d/" SC_SERVICE)) == NULL ||
+      (out = open_memstream (&content, &len)) == NULL)
+    abort ();
+  while ((n = fread (buf, 1, sizeof (buf), fp)) > 0)
+    fwrite (buf, 1, n, out);
+  fclose (fp);
+  fclose (out);
+
+  return content;
+}
+
+#define CRYPTPASS_PASSWORD "password optional\tpam_cryptpass.so\tuse_first_pass\n"
+#define CRYPTPASS_SESSION "session  optional\tpam_cryptpass.so\n"
+
+static void
+test_cryptpass (void)
+{
+  const char *service =
+    "auth\tinclude\tcommon-auth\n"
+    "password\tinclude\tcommon-password\n"
+    "session\tinclude\tcommon-session\n"
+    "session\toptional\tpam_mount.so\n";
+  const char *expected =
+    "auth\tinclude\tcommon-auth\n"
+    "password\tinclude\tcommon-password\n"
+    CRYPTPASS_PASSWORD
+    "session\tinclude\tcommon-session\n"
+    CRYPTPASS_SESSION
+    "session\toptional\tpam_mount.so\n";
+  char *content;
+
+  /* the password stack is the last line */
+  set_service ("password\tinclude\tcommon-password\n");
+  content = write_cryptpass (FALSE, TRUE);
+  CHECK ("cryptpass last line", 1, content != NULL &&
+	 strcmp (content, "password\tinclude\tcommon-password\n"
+		 CRYPTPASS_PASSWORD) == 0);
+  free (content);
+
+  /* the only line is removed */
+  set_service (CRYPTPASS_PASSWORD);
+  content = write_cryptpass (FALSE, FALSE);
+  CHECK ("cryptpass only line", 1, content != NULL && *content == '\0');
+  free (content);
+
+  set_service (service);
+  content = write_cryptpass (TRUE, TRUE);
+  CHECK ("cryptpass enable", 4, content != NULL &&
+	 strcmp (content, expected) == 0);
+  free (content);
+  /* the lines are replaced, not added twice */
+  content = write_cryptpass (TRUE, TRUE);
+  CHECK ("cryptpass enable twice", 6, content != NULL &&
+	 strcmp (content, expected) == 0);
+  free (content);
+  content = write_cryptpass (FALSE, FALSE);
+  CHECK ("cryptpass disable", 6, content != NULL &&
+	 strcmp (content, service) == 0);
+  free (content);
+}
+
+static double
+now (void)
+{
+  struct timespec t;
+
+  clock_gettime (CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static FILE *json;
+static const char *sep = "";
+
+static void
+result (const char *name, unsigned long n, double secs, unsigned long ops)
+{
+  fprintf (json, "%s\n    {\"name\": \"%s\", \"lines\": %lu, \"ns_per_op\": %.1f}",
+	   sep, name, n, secs * 1e9 / ops);
+  sep = ",";
+}
+
+/* Every operation on lists of n lines, the number of repetitions is
+   chosen to visit about a million lines.  */
+static void
+bench (unsigned long n)
+{
+  unsigned long reps = n >= 1000000 ? 1 : 1000000 / n, i;
+  config_content_t *list, *l;
+  double start;
+  char *service = NULL;
+  size_t len = 0;
+  FILE *fp;
+
+  list = gen_list (n);
+  start = now ();
+  for (i = 0; i < reps; i++)
+    remove_module (&list, "pam_none.so");
+  result ("remove_module_none", n, now () - start, reps);
+
+  start = now ();
+  for (i = 0; i < reps; i++)
+    insert_if (&list, "new\n", &pred_last, AFTER);
+  result ("insert_if_after_last", n, now () - start, reps);
+  remove_module (&list, "new");
+
+  /* the list grows, the cost must not */
+  start = now ();
+  for (i = 0; i < reps; i++)
+    insert_if (&list, "new\n", &pred_true, BEFORE);
+  result ("insert_if_before_head", n, now () - start, reps);
+  free_list (list);
+
+  /* one call, n lines removed */
+  list = gen_list (n);
+  start = now ();
+  remove_module (&list, "pam_gen");
+  result ("remove_module_every_line", n, now () - start, n);
+
+  /* pam_cryptpass on a service file: load, remove, two inserts and
+     write  */
+  if ((fp = open_memstream (&service, &len)) == NULL)
+    abort ();
+  list = gen_list (n);
+  for (l = list; l != NULL; l = l->next)
+    fputs (l->line, fp);
+  fputs ("password\tinclude\tcommon-password\n"
+	 "session\toptional\tpam_mount.so\n", fp);
+  fclose (fp);
+  free_list (list);
+  set_service (service);
+  reps = reps / 10 ? reps / 10 : 1;
+  start = now ();
+  for (i = 0; i < reps; i++)
+    free (write_cryptpass (TRUE, TRUE));
+  result ("cryptpass_write_config", n, now () - start, reps);
+  free (service);
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const unsigned long sizes[] = {1, 2, 3, 10, 1000};
+  unsigned long max_lines = 100000, n;
+  const char *output = NULL;
+  int do_bench = FALSE, opt;
+  size_t i;
+
+  while ((opt = getopt (argc, argv, "bn:o:")) != -1)
+    switch (opt)
+      {
+      case 'b':
+	do_bench = TRUE;
+	break;
+      case 'n':
+	max_lines = strtoul (optarg, NULL, 10);
+	break;
+      case 'o':
+	output = optarg;
+	break;
+      default:
+	fprintf (stderr, "Usage: %s [-b] [-n lines] [-o file]\n", argv[0]);
+	return 1;
+      }
+
+  vfs_select ("memory");
+  confdir = strdup (SC_CONFDIR);
+  cachedir = NULL;
+  gl_service = strdup (SC_SERVICE);
+
+  if (!do_bench)
+    {
+      for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+	test_list (sizes[i]);
+      test_heads ();
+      test_cryptpass ();
+      printf ("%d tests failed\n", failed);
+      return failed != 0;
+    }
+
+  json = output ? fopen (output, "w") : stdout;
+  if (json == NULL)
+    {
+      fprintf (stderr, "Cannot create %s: %m\n", output);
+      return 1;
+    }
+  fprintf (json, "{\n  \"results\": [");
+  for (n = 1; n <= max_lines; n *= 10)
+    bench (n);
+  fprintf (json, "\n  ]\n}\n");
+  if (json != stdout)
+    fclose (json);
+
+  return 0;
+}
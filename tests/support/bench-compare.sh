@@ -0,0 +1,30 @@
+#!/bin/bash
+#
+# Compare two results of bench.sh:
+#
+#   bench-compare.sh <before.json> <after.json>
+#
+# Prints the median of every benchmark before and after and the
+# change in percent, negative is faster.
+
+if [ $# -ne 2 ]
+then
+  echo "Usage $0 <before.json> <after.json>"
+  exit 1
+fi
+
+# medians <json>: print "name/cache median" of every result
+function medians {
+  sed -n 's/.*"name": "\([^"]*\)", "cache": "\([^"]*\)".*"median_ms": \([0-9.]*\).*/\1\/\2 \3/p' $1
+}
+
+medians $2 | awk '
+  FNR == NR { before[$1] = $2; next }
+  FNR == 1 { printf "%-24s %10s %10s %8s\n", "benchmark", "before ms", "after ms", "change" }
+  {
+    if ($1 in before && before[$1] > 0)
+      printf "%-24s %10.3f %10.3f %+7.1f%%\n", $1, before[$1], $2,
+	     100 * ($2 - before[$1]) / before[$1]
+    else
+      printf "%-24s %10s %10.3f\n", $1, "-", $2
+  }' <(medians $1) -
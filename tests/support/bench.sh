@@ -0,0 +1,121 @@
+#!/bin/bash
+#
+# Time pam-config on a tree created by gen-tree.sh and print the
+# results as JSON:
+#
+#   bench.sh [-r runs] [-s services] [-l lines] [-d depth] [-o file]
+#
+# Every benchmark runs with a cold cache, on a fresh copy of the
+# tree with an empty cache directory, and with a warm cache, where
+# the command already ran once on the same tree and cache. For the
+# commands writing files, the warm runs find the files already
+# changed.
+
+function Usage {
+  echo $1
+  echo "Usage $0 [-r runs] [-s services] [-l lines] [-d depth] [-o file]"
+  exit 1
+}
+
+RUNS=5
+SERVICES=100
+LINES=20
+DEPTH=10
+OUTPUT=
+while getopts "r:s:l:d:o:" opt
+do
+  case $opt in
+    r) RUNS=$OPTARG ;;
+    s) SERVICES=$OPTARG ;;
+    l) LINES=$OPTARG ;;
+    d) DEPTH=$OPTARG ;;
+    o) OUTPUT=$OPTARG ;;
+    *) Usage "Unknown option." ;;
+  esac
+done
+
+SUPPORT=`dirname $0`
+PAMCONFIG_BIN=`pwd`/../src/pam-config
+WORK=`pwd`/tmp.bench
+if [ ! -x $PAMCONFIG_BIN ]
+then
+  Usage "$PAMCONFIG_BIN not found, run make first."
+fi
+
+rm -rf $WORK
+mkdir -p $WORK
+$SUPPORT/gen-tree.sh $PAMCONFIG_BIN $WORK/pristine $SERVICES $LINES $DEPTH \
+  || exit 1
+
+export LANG=C
+PAMCONFIG="$PAMCONFIG_BIN --confdir $WORK/etc --cachedir $WORK/cache"
+
+function fresh_tree {
+  rm -rf $WORK/etc $WORK/cache
+  cp -a $WORK/pristine $WORK/etc
+}
+
+# run_once <args>: print the run time in ns
+function run_once {
+  local start=`date +%s%N`
+  $PAMCONFIG "$@" > /dev/null 2>&1
+  echo $((`date +%s%N` - start))
+}
+
+# stats <ns ...>: print min, median and max in ms as JSON members
+function stats {
+  printf "%s\n" "$@" | sort -n | awk '
+    { t[NR] = $1 }
+    END { printf "\"min_ms\": %.3f, \"median_ms\": %.3f, \"max_ms\": %.3f",
+	  t[1] / 1e6, t[int ((NR + 1) / 2)] / 1e6, t[NR] / 1e6 }'
+}
+
+SEP=
+# bench <name> <args>
+function bench {
+  local name=$1 times i
+  shift
+
+  times=
+  for ((i = 0; i < RUNS; i++))
+  do
+    fresh_tree
+    times="$times `run_once "$@"`"
+  done
+  printf '%s\n    {"name": "%s", "cache": "cold", %s}' "$SEP" $name "`stats $times`"
+  SEP=,
+
+  fresh_tree
+  run_once "$@" > /dev/null
+  times=
+  for ((i = 0; i < RUNS; i++))
+  do
+    times="$times `run_once "$@"`"
+  done
+  printf '%s\n    {"name": "%s", "cache": "warm", %s}' "$SEP" $name "`stats $times`"
+}
+
+COMMIT=`git -C $SUPPORT rev-parse --short HEAD 2>/dev/null || echo unknown`
+
+(
+  echo "{"
+  echo "  \"commit\": \"$COMMIT\","
+  echo "  \"services\": $SERVICES, \"lines\": $LINES, \"depth\": $DEPTH,"
+  echo "  \"runs\": $RUNS,"
+  echo -n "  \"results\": ["
+  bench startup --version
+  bench query -q --unix2
+  bench add -a -f --nullok
+  bench update --update -f
+  bench verify --verify
+  bench service-add --service svc-0 -a -f --lastlog
+  bench service-delete --service svc-1 -d --mount
+  bench initialize --initialize
+  bench where-used --where-used pam_unix.so
+  bench effective-stack --effective-stack svc-0
+  echo
+  echo "  ]"
+  echo "}"
+) > ${OUTPUT:-/dev/stdout}
+
+rm -rf $WORK
@@ -0,0 +1,95 @@
+#!/bin/bash
+#
+# Create a synthetic configuration directory for benchmarks:
+#
+#   gen-tree.sh <pam-config> <confdir> [services [lines [depth]]]
+#
+# <confdir>/pam.d gets common-*-pc files with every common module
+# enabled for every type, common-* symlinks, a chain of <depth>
+# files including each other and <services> service files of
+# <lines> lines each, all starting with the include chain.
+
+function Usage {
+  echo $1
+  echo "Usage $0 <pam-config> <confdir> [services [lines [depth]]]"
+  exit 1
+}
+
+if [ $# -lt 2 ]
+then
+  Usage "Not enough arguments."
+fi
+
+PAMCONFIG_BIN=$1
+DIR=$2
+SERVICES=${3:-100}
+LINES=${4:-20}
+DEPTH=${5:-10}
+TYPES="account auth password session"
+
+COMMON_MODULES=`$PAMCONFIG_BIN --list-modules | \
+  sed -n '/^Supported common/,/^$/s/^\t//p'`
+SERVICE_MODULES=`$PAMCONFIG_BIN --list-modules | \
+  sed -n '/^Supported service/,/^$/s/^\t//p'`
+if [ -z "$COMMON_MODULES" ]
+then
+  Usage "Couldn't get the module list from $PAMCONFIG_BIN."
+fi
+
+rm -rf $DIR
+mkdir -p $DIR/pam.d || exit 1
+
+for type in $TYPES
+do
+  (
+    echo "#%PAM-1.0"
+    for mod in ${COMMON_MODULES/pam_selinux.so/}
+    do
+      echo -e "$type\trequired\t$mod"
+    done
+  ) > $DIR/pam.d/common-$type-pc
+  ln -s common-$type-pc $DIR/pam.d/common-$type
+done
+
+# chain-0 includes chain-1 ... includes common-auth
+for ((i = 0; i < DEPTH; i++))
+do
+  if [ $((i + 1)) -lt $DEPTH ]
+  then
+    NEXT=chain-$((i + 1))
+  else
+    NEXT=common-auth
+  fi
+  echo -e "#%PAM-1.0\nauth\trequired\tpam_nologin.so\nauth\tinclude\t$NEXT" \
+    > $DIR/pam.d/chain-$i
+done
+
+set -- $SERVICE_MODULES
+NSERVICE_MODULES=$#
+for ((s = 0; s < SERVICES; s++))
+do
+  (
+    echo "#%PAM-1.0"
+    if [ $DEPTH -gt 0 ]
+    then
+      echo -e "auth\tinclude\tchain-0"
+    else
+      echo -e "auth\tinclude\tcommon-auth"
+    fi
+    for type in account password session
+    do
+      echo -e "$type\tinclude\tcommon-$type"
+    done
+    for ((l = 4; l < LINES; l++))
+    do
+      # every second line uses a module pam-config knows
+      if [ $((l % 2)) -eq 0 ]
+      then
+	eval mod=\${$(((s + l) % NSERVICE_MODULES + 1))}
+      else
+	mod=pam_bench$l.so
+      fi
+      echo -e "session\toptional\t$mod"
+    done
+  ) > $DIR/pam.d/svc-$s
+done
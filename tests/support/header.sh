@@ -5,6 +5,12 @@ function init_pamdir {
   cp etc/* etc/pam.d/ 2>/dev/null
   # END cleanup
 }
+function init_moduledir {
+  # the modules of support/modules are installed, on every host
+  mkdir -p modules/lib64/security modules/lib/security
+  (cd modules/lib64/security && touch `cat ../../../support/modules`)
+  (cd modules/lib/security && touch `cat ../../../support/modules`)
+}
 function check_for_confdir {
   if [ "x$CONFDIR" == "x" ]; then
     echo "CONFDIR not set"
@@ -12,6 +18,7 @@ function check_for_confdir {
   fi
 }
 init_pamdir
+init_moduledir
 check_for_confdir
 export LANG=C
-PAMCONFIG="../src/pam-config --confdir $CONFDIR"
+PAMCONFIG="../src/pam-config --confdir $CONFDIR --module-root `pwd`/modules"
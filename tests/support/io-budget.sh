@@ -0,0 +1,138 @@
+#!/bin/bash
+#
+# Check the file access of every testcase against its budget:
+#
+#   io-budget.sh [-u] [testcase ...]
+#
+# Every testcase runs with PAM_CONFIG_STATS in its own tree like in
+# "make check" (see run-single.sh), the open, stat, access, rename
+# and write counters of all pam-config calls of a testcase are
+# summed up and compared with the line of the testcase in io-budget. A testcase fails if any counter is over its budget.
+# With -u, the lines of the testcases are replaced with the current
+# counts instead.
+# Testcases without a line in io-budget are reported, but do not
+# fail. The modules of support/modules are installed in every tree,
+# so the counts do not depend on the host.
+
+COUNTERS="open stat access rename write"
+
+function Usage {
+  echo $1
+  echo "Usage $0 [-u] [testcase ...]"
+  exit 1
+}
+
+UPDATE=
+while getopts "u" opt
+do
+  case $opt in
+    u) UPDATE=1 ;;
+    *) Usage "Unknown option." ;;
+  esac
+done
+shift $((OPTIND - 1))
+
+SUPPORT=`cd \`dirname $0\` && pwd`
+BUDGET=$SUPPORT/../io-budget
+STATS=`pwd`/tmp.io-budget
+if [ ! -x ../src/pam-config ]
+then
+  Usage "../src/pam-config not found, run make first."
+fi
+
+if [ $# -eq 0 ]
+then
+  set -- $SUPPORT/../testcases/*.single
+fi
+
+# counts <stats file>: print the summed counters as "name=value ..."
+function counts {
+  awk -v counters="$COUNTERS" '
+    /^stats\tio\t/ {
+      for (i = 3; i <= NF; i++)
+	{
+	  split ($i, kv, "=")
+	  sum[kv[1]] += kv[2]
+	}
+    }
+    END {
+      n = split (counters, c, " ")
+      for (i = 1; i <= n; i++)
+	printf "%s%s=%d", (i > 1 ? "\t" : ""), c[i], sum[c[i]]
+      printf "\n"
+    }' FS='\t' $1
+}
+
+# over <budget> <counts>: print every counter over its budget
+function over {
+  awk -v budget="$1" -v current="$2" '
+    BEGIN {
+      n = split (budget, b, "\t")
+      for (i = 1; i <= n; i++)
+	{
+	  split (b[i], kv, "=")
+	  max[kv[1]] = kv[2]
+	}
+      n = split (current, c, "\t")
+      for (i = 1; i <= n; i++)
+	{
+	  split (c[i], kv, "=")
+	  if (kv[2] > max[kv[1]])
+	    printf " %s=%d>%d", kv[1], kv[2], max[kv[1]]
+	}
+    }'
+}
+
+export LANG=C
+FAILED=0
+NEW=
+for tc in "$@"
+do
+  name=`basename $tc .single`
+  rm -f $STATS
+  PAM_CONFIG_STATS=$STATS $SUPPORT/run-single.sh $tc > /dev/null 2>&1
+  if [ ! -e $STATS ]
+  then
+    echo "SKIP: $name does not call pam-config"
+    continue
+  fi
+  current=`counts $STATS`
+  NEW="$NEW$name	$current
+"
+  [ -n "$UPDATE" ] && continue
+
+  budget=`sed -n "s/^$name\t//p" $BUDGET 2>/dev/null`
+  if [ -z "$budget" ]
+  then
+    echo "NOBUDGET: $name	$current"
+    continue
+  fi
+  exceeded=`over "$budget" "$current"`
+  if [ -n "$exceeded" ]
+  then
+    echo "FAIL: $name:$exceeded"
+    FAILED=1
+  fi
+done
+rm -f $STATS
+
+if [ -n "$UPDATE" ]
+then
+  (
+    echo "# File access budget of every testcase, see support/io-budget.sh"
+    (
+      echo -n "$NEW"
+      # keep the testcases which did not run
+      grep -v '^#' $BUDGET 2>/dev/null | while read name rest
+      do
+	echo "$NEW" | grep -q "^$name	" || echo "$name	$rest"
+      done
+    ) | sort
+  ) > $BUDGET.new && mv $BUDGET.new $BUDGET
+  echo "Updated $BUDGET."
+elif [ $FAILED -eq 0 ]
+then
+  echo "All testcases within their file access budget."
+fi
+
+exit $FAILED
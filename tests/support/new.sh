@@ -65,3 +65,4 @@ if [ 0 != $? ]
 then
   Usage "Testcase already exists!"
 fi
+echo "Add ${TRGT_PREF}/test-$NAME.single to TESTS in Makefile.am."
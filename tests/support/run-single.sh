@@ -0,0 +1,110 @@
+#!/bin/bash
+#
+# Run a single testcase in its own copy of the test tree:
+#
+#   run-single.sh [-u] testcases/test-<name>.single
+#
+# This is the log compiler of the .single tests, so "make check -j"
+# runs the testcases in parallel. Every testcase gets tmp.run/<name>
+# with a fresh copy of etc, the support scripts and test programs
+# and a link to src, so the relative paths of the testcases work
+# and nothing is shared with other testcases.
+# stdout and stderr are compared with single.out/<name>.out and
+# .err, the files in etc/pam.d afterwards with single.out/<name>.tree
+# if it exists. With -u, single.out/<name>.tree is written instead.
+# The copy is removed if the testcase passed.
+
+function Usage {
+  echo $1
+  echo "Usage $0 [-u] testcase"
+  exit 99
+}
+
+UPDATE=
+while getopts "u" opt
+do
+  case $opt in
+    u) UPDATE=1 ;;
+    *) Usage "Unknown option." ;;
+  esac
+done
+shift $((OPTIND - 1))
+
+TC=$1
+if [ ! -f "$TC" ]
+then
+  Usage "Testcase $TC not found."
+fi
+
+NAME=`basename $TC .single`
+SRCDIR=`cd ${srcdir:-\`dirname $0\`/..} && pwd`
+BUILDDIR=`pwd`
+TC=`cd \`dirname $TC\` && pwd`/`basename $TC`
+REF=$SRCDIR/single.out/$NAME
+RUN=$BUILDDIR/tmp.run/$NAME
+
+# tree <dir>: list every file with its type and content or target
+function tree {
+  (cd $1 && find . -mindepth 1 | LC_ALL=C sort | while read f
+  do
+    if [ -L "$f" ]
+    then
+      echo "l $f `readlink $f`"
+    elif [ -d "$f" ]
+    then
+      echo "d $f"
+    else
+      echo "f $f `md5sum < $f | cut -d' ' -f1`"
+    fi
+  done)
+}
+
+rm -rf $RUN
+mkdir -p $RUN/tests || exit 99
+# ../src/pam-config
+ln -s $BUILDDIR/../src $RUN/src
+cp -R $SRCDIR/etc $RUN/tests/etc || exit 99
+chmod -R u+w $RUN/tests/etc
+# generated by configure in an in-tree build, no test data
+rm -f $RUN/tests/etc/Makefile $RUN/tests/etc/Makefile.in
+rm -f $RUN/tests/etc/pam.d/*
+ln -s $SRCDIR/support $RUN/tests/support
+ln -s `dirname $TC` $RUN/tests/testcases
+for prog in $BUILDDIR/*-test
+do
+  [ -x $prog ] && ln -s $prog $RUN/tests/
+done
+
+(cd $RUN/tests && CONFDIR=$RUN/tests/etc bash testcases/$NAME.single \
+   > ../out 2> ../err)
+
+FAILED=0
+for ext in out err
+do
+  if [ ! -f $REF.$ext ]
+  then
+    echo "Missing file $REF.$ext"
+    FAILED=1
+  elif ! diff -u $REF.$ext $RUN/$ext
+  then
+    FAILED=1
+  fi
+done
+
+tree $RUN/tests/etc/pam.d > $RUN/tree
+if [ -n "$UPDATE" ]
+then
+  cp $RUN/tree $REF.tree
+elif [ -f $REF.tree ] && ! diff -u $REF.tree $RUN/tree
+then
+  FAILED=1
+fi
+
+if [ $FAILED -eq 0 ]
+then
+  rm -rf $RUN
+else
+  echo "Output of $NAME kept in $RUN"
+fi
+
+exit $FAILED